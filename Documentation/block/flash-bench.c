@@ -0,0 +1,270 @@
+/*
+ * flash-bench - read latency under a background writer, per io scheduler
+ *
+ * For each scheduler, one process reads random 4 KiB blocks of a file
+ * with O_DIRECT, one at a time, while another writes a second file
+ * sequentially through the page cache and starts async writeback of each
+ * MiB with sync_file_range(), so that the reads compete with a steady
+ * stream of background writes.  The program prints the reads per
+ * second, the read latency percentiles and the write throughput.  This
+ * is the case the flash scheduler is for: reads should not wait behind
+ * a burst of writes.
+ *
+ *	gcc -O2 -o flash-bench flash-bench.c
+ *	./flash-bench [-t secs] [-s file_mb] [-S "sched ..."] <dir> <queue dir>
+ *
+ * <dir> must be on the device whose /sys/block/<dev>/queue is given as
+ * <queue dir>.  The default schedulers are noop, deadline, cfq and
+ * flash; those the device does not offer are skipped.  The scheduler in
+ * use before the run is restored afterwards.  Needs root.
+ *
+ * The brd and loop drivers have no io scheduler here, see
+ * Documentation/block/flash-iosched.txt for a scsi_debug setup.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE	4096
+#define MAX_SAMPLES	(1 << 20)
+
+struct result {
+	long reads;
+	double p50, p90, p99, max;	/* ms */
+};
+
+static int secs = 10, file_mb = 256;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int read_file(const char *dir, const char *name, char *buf, int len)
+{
+	char path[4200];
+	FILE *f;
+	int ret = -1;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fgets(buf, len, f))
+		ret = 0;
+	fclose(f);
+	return ret;
+}
+
+static int write_file(const char *dir, const char *name, const char *val)
+{
+	char path[4200];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f)
+		return -1;
+	ret = fprintf(f, "%s\n", val) < 0;
+	return fclose(f) || ret ? -1 : 0;
+}
+
+static int make_file(const char *path, long mb)
+{
+	static char buf[1 << 20];
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	long i;
+
+	if (fd < 0)
+		return -1;
+	memset(buf, 0xa5, sizeof(buf));
+	for (i = 0; i < mb; i++)
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+			return -1;
+	fsync(fd);
+	return close(fd);
+}
+
+/* sequential async writes, starting over at the end of the file */
+static void writer(const char *path, int out)
+{
+	static char buf[1 << 20];
+	long written = 0;
+	double start = now();
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0)
+		exit(1);
+	memset(buf, 0x5a, sizeof(buf));
+	while (now() - start < secs) {
+		off_t off = written % ((long)file_mb << 20);
+
+		if (pwrite(fd, buf, sizeof(buf), off) != sizeof(buf) ||
+		    sync_file_range(fd, off, sizeof(buf),
+				    SYNC_FILE_RANGE_WRITE))
+			exit(1);
+		written += sizeof(buf);
+	}
+	written = written / (now() - start);
+	if (write(out, &written, sizeof(written)) != sizeof(written))
+		exit(1);
+	close(fd);
+	exit(0);
+}
+
+static int reader(const char *path, struct result *res)
+{
+	static double lat[MAX_SAMPLES];
+	long blocks = ((long)file_mb << 20) / BLOCK_SIZE, n = 0;
+	unsigned int seed = 1;
+	double start, t;
+	void *buf;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_DIRECT);
+	if (fd < 0 || posix_memalign(&buf, BLOCK_SIZE, BLOCK_SIZE)) {
+		perror(path);
+		return -1;
+	}
+	start = now();
+	while ((t = now()) - start < secs && n < MAX_SAMPLES) {
+		off_t off = (off_t)(rand_r(&seed) % blocks) * BLOCK_SIZE;
+
+		if (pread(fd, buf, BLOCK_SIZE, off) != BLOCK_SIZE) {
+			perror("pread");
+			return -1;
+		}
+		lat[n++] = (now() - t) * 1e3;
+	}
+	close(fd);
+	free(buf);
+	if (!n)
+		return -1;
+
+	qsort(lat, n, sizeof(double), cmp_double);
+	res->reads = n;
+	res->p50 = lat[n / 2];
+	res->p90 = lat[n * 90 / 100];
+	res->p99 = lat[n * 99 / 100];
+	res->max = lat[n - 1];
+	return 0;
+}
+
+static int run(const char *dir, const char *queue, const char *sched)
+{
+	char rpath[4200], wpath[4200];
+	struct result res;
+	long rate;
+	int pfd[2], status;
+	pid_t pid;
+
+	if (write_file(queue, "scheduler", sched)) {
+		printf("%-12s not available\n", sched);
+		return 0;
+	}
+	snprintf(rpath, sizeof(rpath), "%s/flash-bench.read", dir);
+	snprintf(wpath, sizeof(wpath), "%s/flash-bench.write", dir);
+
+	sync();
+	write_file("/proc/sys/vm", "drop_caches", "3");
+	if (pipe(pfd))
+		return -1;
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		return -1;
+	if (!pid)
+		writer(wpath, pfd[1]);
+
+	if (reader(rpath, &res)) {
+		kill(pid, SIGKILL);
+		waitpid(pid, NULL, 0);
+		return -1;
+	}
+	if (read(pfd[0], &rate, sizeof(rate)) != sizeof(rate) ||
+	    waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return -1;
+	close(pfd[0]);
+	close(pfd[1]);
+	unlink(wpath);
+
+	printf("%-12s %8.0f %8.2f %8.2f %8.2f %8.2f %10.1f\n", sched,
+	       res.reads / (double)secs, res.p50, res.p90, res.p99, res.max,
+	       rate / (double)(1 << 20));
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t secs] [-s file_mb] [-S \"sched ...\"] "
+		"<dir> <queue dir>\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char scheds[256] = "noop deadline cfq flash";
+	char old[256], path[4200], *sched, *p;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "t:s:S:")) != -1) {
+		switch (opt) {
+		case 't': secs = atoi(optarg); break;
+		case 's': file_mb = atoi(optarg); break;
+		case 'S':
+			snprintf(scheds, sizeof(scheds), "%s", optarg);
+			break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc - 2 || secs <= 0 || file_mb <= 0)
+		usage(argv[0]);
+
+	/* "noop [deadline] cfq": remember the one in brackets */
+	if (read_file(argv[optind + 1], "scheduler", old, sizeof(old)) ||
+	    !(p = strchr(old, '['))) {
+		fprintf(stderr, "%s/scheduler: no io scheduler\n",
+			argv[optind + 1]);
+		return 1;
+	}
+	memmove(old, p + 1, strlen(p));
+	*strchr(old, ']') = '\0';
+
+	snprintf(path, sizeof(path), "%s/flash-bench.read", argv[optind]);
+	if (make_file(path, file_mb)) {
+		perror(path);
+		return 1;
+	}
+
+	printf("%d s per scheduler, %d MiB files\n", secs, file_mb);
+	printf("%-12s %8s %8s %8s %8s %8s %10s\n", "scheduler", "reads/s",
+	       "p50 ms", "p90 ms", "p99 ms", "max ms", "write MB/s");
+	for (sched = strtok(scheds, " "); sched; sched = strtok(NULL, " ")) {
+		if (run(argv[optind], argv[optind + 1], sched)) {
+			ret = 1;
+			break;
+		}
+	}
+
+	unlink(path);
+	write_file(argv[optind + 1], "scheduler", old);
+	return ret;
+}
@@ -0,0 +1,209 @@
+/*
+ * stage-bench - buffered write throughput with and without bio staging
+ *
+ * One writer per job, each bound to its own cpu, writes size MiB to its
+ * own file in 4 KiB writes and fsyncs it.  Writers running past the
+ * dirty limit do writeback themselves, so the async writes reach the
+ * queue from several cpus at once, which is where staging matters.  The
+ * run is repeated with queue/stage_batch set to 0 and to the batch
+ * given, and the wall clock and system time of the writers are printed,
+ * along with how many bios queue/stage_stats counted as staged and in
+ * how many lists they reached the elevator.  Writeback started by fsync
+ * is sync and never staged, so not every write shows up there.
+ *
+ *	gcc -O2 -o stage-bench stage-bench.c
+ *	./stage-bench [-j jobs] [-s size_mb] [-b batch] <dir> <queue dir>
+ *
+ * <dir> must be on the device whose /sys/block/<dev>/queue is given as
+ * <queue dir>, and the device should use the deadline or noop
+ * scheduler, as nothing is staged under cfq.  Needs root.  On a kernel
+ * without CONFIG_BLK_PERCPU_STAGE only the unstaged run is made.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BLOCK_SIZE	4096
+
+static int jobs = 4, size_mb = 256, batch = 16;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double tv_secs(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static int write_file(const char *dir, const char *name, const char *val)
+{
+	char path[4200];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	ret = fprintf(f, "%s\n", val) < 0;
+	if (fclose(f) || ret) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+/* queue/stage_stats: bios staged and lists flushed, 0 0 if absent */
+static void read_stats(const char *dir, unsigned long *staged,
+		       unsigned long *flushes)
+{
+	char path[4200];
+	FILE *f;
+
+	*staged = *flushes = 0;
+	snprintf(path, sizeof(path), "%s/stage_stats", dir);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	if (fscanf(f, "%lu %lu", staged, flushes) != 2)
+		*staged = *flushes = 0;
+	fclose(f);
+}
+
+static void writer(const char *dir, int job)
+{
+	static char buf[BLOCK_SIZE];
+	long i, blocks = (long)size_mb * (1 << 20) / BLOCK_SIZE;
+	char path[4200];
+	cpu_set_t cpus;
+	int fd;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(job % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+
+	snprintf(path, sizeof(path), "%s/stage-bench.%d", dir, job);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	memset(buf, job, sizeof(buf));
+	for (i = 0; i < blocks; i++) {
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+			perror("write");
+			exit(1);
+		}
+	}
+	if (fsync(fd)) {
+		perror("fsync");
+		exit(1);
+	}
+	close(fd);
+	unlink(path);
+	exit(0);
+}
+
+static int run(const char *dir, const char *queue, int stage_batch)
+{
+	struct rusage before, after;
+	unsigned long staged0, flushes0, staged, flushes;
+	char val[16];
+	double start, secs;
+	int i, status, failed = 0;
+
+	snprintf(val, sizeof(val), "%d", stage_batch);
+	if (stage_batch >= 0 && write_file(queue, "stage_batch", val))
+		return -1;
+
+	sync();
+	write_file("/proc/sys/vm", "drop_caches", "3");
+	read_stats(queue, &staged0, &flushes0);
+	getrusage(RUSAGE_CHILDREN, &before);
+
+	fflush(stdout);
+	start = now();
+	for (i = 0; i < jobs; i++) {
+		switch (fork()) {
+		case -1:
+			perror("fork");
+			return -1;
+		case 0:
+			writer(dir, i);
+		}
+	}
+	for (i = 0; i < jobs; i++) {
+		if (wait(&status) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status))
+			failed = 1;
+	}
+	secs = now() - start;
+	getrusage(RUSAGE_CHILDREN, &after);
+	sync();
+	read_stats(queue, &staged, &flushes);
+	staged -= staged0;
+	flushes -= flushes0;
+
+	if (failed)
+		return -1;
+
+	printf("stage_batch %2s: %7.2f s  %8.1f MiB/s  sys %7.2f s  "
+	       "staged %8lu in %7lu lists\n",
+	       stage_batch >= 0 ? val : "-", secs, jobs * size_mb / secs,
+	       tv_secs(&after.ru_stime) - tv_secs(&before.ru_stime),
+	       staged, flushes);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-j jobs] [-s size_mb] [-b batch] "
+		"<dir> <queue dir>\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	char path[4200];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "j:s:b:")) != -1) {
+		switch (opt) {
+		case 'j': jobs = atoi(optarg); break;
+		case 's': size_mb = atoi(optarg); break;
+		case 'b': batch = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc - 2 || jobs <= 0 || size_mb <= 0 || batch <= 0)
+		usage(argv[0]);
+
+	snprintf(path, sizeof(path), "%s/stage_batch", argv[optind + 1]);
+	printf("%d jobs, %d MiB each, %ld cpus\n", jobs, size_mb,
+	       sysconf(_SC_NPROCESSORS_ONLN));
+	if (access(path, W_OK)) {
+		printf("no writable %s, measuring without staging only\n",
+		       path);
+		return run(argv[optind], argv[optind + 1], -1) ? 1 : 0;
+	}
+	if (run(argv[optind], argv[optind + 1], 0) ||
+	    run(argv[optind], argv[optind + 1], batch))
+		return 1;
+
+	write_file(argv[optind + 1], "stage_batch", "0");
+	return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * epoll_bench - events/sec delivered by epoll_wait() with concurrent
+ * producers.
+ *
+ * Each producer thread owns a set of eventfds and keeps signalling them,
+ * the main thread waits on all of them with a single epoll instance and
+ * drains what it gets. Compare runs with fs.epoll.percpu_ready and
+ * fs.epoll.wakeup_batch_us set and unset, for 1, 2, 4... producers:
+ *
+ *	gcc -O2 -o epoll_bench epoll_bench.c -lpthread
+ *	echo 1 > /proc/sys/fs/epoll/percpu_ready
+ *	./epoll_bench 4 64 5
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define MAX_EVENTS	256
+
+static int nr_fds;
+static int *fds;
+static volatile int stop;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void *producer(void *arg)
+{
+	int *own = arg;
+	uint64_t one = 1;
+	int i = 0;
+
+	while (!stop) {
+		if (write(own[i], &one, sizeof(one)) != sizeof(one))
+			break;
+		if (++i == nr_fds)
+			i = 0;
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_event ev, events[MAX_EVENTS];
+	unsigned long long nr_events = 0, nr_waits = 0;
+	int nr_producers = argc > 1 ? atoi(argv[1]) : 1;
+	double secs, start, end;
+	pthread_t *threads;
+	uint64_t val;
+	int epfd, i, n;
+
+	nr_fds = argc > 2 ? atoi(argv[2]) : 64;
+	secs = argc > 3 ? atof(argv[3]) : 5;
+	if (nr_producers <= 0 || nr_fds <= 0 || secs <= 0) {
+		fprintf(stderr, "usage: %s [producers] [fds per producer] "
+			"[seconds]\n", argv[0]);
+		return 1;
+	}
+
+	epfd = epoll_create1(0);
+	fds = calloc(nr_producers * nr_fds, sizeof(*fds));
+	threads = calloc(nr_producers, sizeof(*threads));
+	if (epfd < 0 || !fds || !threads) {
+		perror("setup");
+		return 1;
+	}
+
+	for (i = 0; i < nr_producers * nr_fds; i++) {
+		fds[i] = eventfd(0, EFD_NONBLOCK);
+		if (fds[i] < 0) {
+			perror("eventfd");
+			return 1;
+		}
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[i];
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev) < 0) {
+			perror("epoll_ctl");
+			return 1;
+		}
+	}
+
+	for (i = 0; i < nr_producers; i++)
+		pthread_create(&threads[i], NULL, producer, fds + i * nr_fds);
+
+	start = now();
+	end = start + secs;
+	while (now() < end) {
+		n = epoll_wait(epfd, events, MAX_EVENTS, 100);
+		if (n < 0) {
+			perror("epoll_wait");
+			break;
+		}
+		nr_waits++;
+		nr_events += n;
+		for (i = 0; i < n; i++)
+			if (read(events[i].data.fd, &val, sizeof(val)) < 0)
+				perror("read");
+	}
+	secs = now() - start;
+	stop = 1;
+
+	for (i = 0; i < nr_producers; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("%d producers, %d fds: %.0f events/sec, %.1f events per "
+	       "epoll_wait\n", nr_producers, nr_producers * nr_fds,
+	       nr_events / secs, nr_waits ? (double)nr_events / nr_waits : 0);
+	return 0;
+}
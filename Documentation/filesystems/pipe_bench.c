@@ -0,0 +1,173 @@
+/*
+ * pipe_bench - pipe throughput for several pipe sizes.
+ *
+ * A child writes the data into the pipe with write(2), the parent takes
+ * it out either with read(2) into a buffer, or with splice(2) into a
+ * file, with SPLICE_F_MOVE so that full pages are moved into the page
+ * cache instead of being copied. The gift column has the child hand
+ * freshly mapped pages to the pipe with vmsplice(2) and SPLICE_F_GIFT
+ * and unmap them, so that they can be moved into the file as well.
+ * Only filesystems that opt in take moved pages: ramfs, ext2, ext3,
+ * ext4 and yaffs2; elsewhere the splice numbers are for copying. The
+ * pipe size in bytes is set with F_SETPIPE_SZ;
+ * sizes above /proc/sys/fs/pipe-max-size need CAP_SYS_RESOURCE.
+ *
+ *	gcc -O2 -o pipe_bench pipe_bench.c
+ *	./pipe_bench [file] [megabytes]
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ	(1024 + 7)
+#endif
+
+#define CHUNK	(64 * 1024)
+
+enum { MODE_READ, MODE_SPLICE, MODE_GIFT };
+
+static const int sizes[] = { 4096, 65536, 262144, 1048576 };
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void writer(int fd, long long total)
+{
+	static char buf[CHUNK];
+	ssize_t n;
+
+	memset(buf, 'x', sizeof(buf));
+	while (total > 0) {
+		n = write(fd, buf, total < CHUNK ? total : CHUNK);
+		if (n <= 0)
+			break;
+		total -= n;
+	}
+}
+
+/* gift each chunk to the pipe, then give up our mapping of it */
+static void gift_writer(int fd, long long total)
+{
+	struct iovec iov;
+	size_t len;
+	ssize_t n;
+	char *buf;
+
+	while (total > 0) {
+		len = total < CHUNK ? total : CHUNK;
+		buf = mmap(NULL, CHUNK, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED) {
+			perror("mmap");
+			break;
+		}
+		memset(buf, 'x', len);
+		iov.iov_base = buf;
+		iov.iov_len = len;
+		while (iov.iov_len) {
+			n = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+			if (n <= 0) {
+				perror("vmsplice");
+				return;
+			}
+			iov.iov_base = (char *)iov.iov_base + n;
+			iov.iov_len -= n;
+		}
+		munmap(buf, CHUNK);
+		total -= len;
+	}
+}
+
+static double run(int size, long long total, int out, int mode)
+{
+	static char buf[CHUNK];
+	long long left = total;
+	double start;
+	int fds[2];
+	ssize_t n;
+	pid_t pid;
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		exit(1);
+	}
+	if (fcntl(fds[1], F_SETPIPE_SZ, size) < 0) {
+		perror("F_SETPIPE_SZ");
+		exit(1);
+	}
+	if (mode != MODE_READ &&
+	    (ftruncate(out, 0) < 0 || lseek(out, 0, SEEK_SET))) {
+		perror("truncate");
+		exit(1);
+	}
+
+	start = now();
+	pid = fork();
+	if (!pid) {
+		close(fds[0]);
+		if (mode == MODE_GIFT)
+			gift_writer(fds[1], total);
+		else
+			writer(fds[1], total);
+		_exit(0);
+	}
+	close(fds[1]);
+
+	while (left > 0) {
+		if (mode == MODE_READ)
+			n = read(fds[0], buf, sizeof(buf));
+		else
+			n = splice(fds[0], NULL, out, NULL, size,
+				   SPLICE_F_MOVE);
+		if (n <= 0) {
+			perror(mode == MODE_READ ? "read" : "splice");
+			break;
+		}
+		left -= n;
+	}
+	waitpid(pid, NULL, 0);
+	close(fds[0]);
+
+	return (total - left) / (now() - start) / (1024 * 1024);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = argc > 1 ? argv[1] : "pipe_bench.out";
+	long long total = (argc > 2 ? atoll(argv[2]) : 256) << 20;
+	unsigned int i;
+	int out;
+
+	out = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (out < 0) {
+		perror(path);
+		return 1;
+	}
+
+	printf("%10s %14s %14s %14s\n", "pipe size", "read MB/s",
+	       "splice MB/s", "gift MB/s");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		printf("%10d", sizes[i]);
+		fflush(stdout);
+		printf(" %14.1f", run(sizes[i], total, out, MODE_READ));
+		printf(" %14.1f", run(sizes[i], total, out, MODE_SPLICE));
+		printf(" %14.1f\n", run(sizes[i], total, out, MODE_GIFT));
+	}
+
+	close(out);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * af_unix_dgram_test - check that every blocked datagram reader is woken
+ *
+ * Two children block in recv() on the same AF_UNIX datagram socket and
+ * the parent then sends two datagrams back to back.  Readers sleep as
+ * exclusive waiters, so each datagram has to wake one of them: if the
+ * second send did not issue a wakeup, one child would stay asleep with
+ * a datagram sitting in the queue.
+ *
+ *	gcc -O2 -o af_unix_dgram_test af_unix_dgram_test.c
+ *	./af_unix_dgram_test
+ *
+ * Exits with 0 when both readers got a datagram within the timeout.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NR_READERS	2
+#define TIMEOUT		5
+
+static void reader(int fd)
+{
+	char buf[16];
+
+	alarm(TIMEOUT);
+	if (recv(fd, buf, sizeof(buf), 0) <= 0) {
+		perror("recv");
+		exit(1);
+	}
+	exit(0);
+}
+
+int main(void)
+{
+	pid_t pids[NR_READERS];
+	int sv[2], i, status, failed = 0;
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv)) {
+		perror("socketpair");
+		return 1;
+	}
+
+	for (i = 0; i < NR_READERS; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (!pids[i])
+			reader(sv[1]);
+	}
+
+	/* give both readers time to go to sleep in recv() */
+	sleep(1);
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (send(sv[0], "x", 1, 0) != 1) {
+			perror("send");
+			return 1;
+		}
+	}
+
+	for (i = 0; i < NR_READERS; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			perror("waitpid");
+			return 1;
+		}
+		if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) {
+			fprintf(stderr, "reader %d was not woken up\n", i);
+			failed = 1;
+		} else if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			failed = 1;
+		}
+	}
+
+	printf("%s\n", failed ? "FAIL" : "PASS");
+	return failed;
+}
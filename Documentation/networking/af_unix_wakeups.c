@@ -0,0 +1,250 @@
+/*
+ * af_unix_wakeups - count receiver wakeups of an AF_UNIX datagram stream
+ *
+ * The parent sends bursts of datagrams to a child that waits in
+ * epoll_wait() with EPOLLET and drains the socket with recvmmsg() until
+ * EAGAIN, as event loops do.  For each setting of
+ * /proc/sys/net/unix/dgram_wake_coalesce the program reports how often
+ * the child was woken, how many of those wakeups found nothing to read
+ * because an earlier wakeup had already drained the data, and the
+ * voluntary context switches and system time of both sides.
+ *
+ *	gcc -O2 -o af_unix_wakeups af_unix_wakeups.c
+ *	./af_unix_wakeups [-n bursts] [-b burst] [-u gap_us]
+ *
+ * Sender and receiver are put on different cpus when there are two, as
+ * wakeups that find an empty queue happen while the receiver is busy
+ * draining on another cpu.  Switching the sysctl needs root; without it
+ * only the current setting is measured.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define COALESCE	"/proc/sys/net/unix/dgram_wake_coalesce"
+#define VLEN		16
+#define MSG_SIZE	64
+
+struct result {
+	long wakeups;
+	long empty;
+	long msgs;
+	long nvcsw;
+	double sys;
+};
+
+static int bursts = 10000, burst = 8, gap_us = 100;
+
+static void set_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+static double tv_secs(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void receiver(int fd, int out)
+{
+	struct mmsghdr msgs[VLEN];
+	struct iovec iov[VLEN];
+	char bufs[VLEN][MSG_SIZE];
+	struct epoll_event ev;
+	struct result res;
+	struct rusage ru;
+	long total = (long)bursts * burst;
+	int ep, i, n;
+
+	set_cpu(0);
+	memset(&res, 0, sizeof(res));
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < VLEN; i++) {
+		iov[i].iov_base = bufs[i];
+		iov[i].iov_len = MSG_SIZE;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ep = epoll_create(1);
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.fd = fd;
+	if (ep < 0 || epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev)) {
+		perror("epoll");
+		exit(1);
+	}
+
+	while (res.msgs < total) {
+		if (epoll_wait(ep, &ev, 1, 5000) != 1) {
+			fprintf(stderr, "receiver timed out\n");
+			exit(1);
+		}
+		res.wakeups++;
+		for (i = 0; ; i++) {
+			n = recvmmsg(fd, msgs, VLEN, MSG_DONTWAIT, NULL);
+			if (n < 0) {
+				if (errno != EAGAIN) {
+					perror("recvmmsg");
+					exit(1);
+				}
+				break;
+			}
+			res.msgs += n;
+		}
+		if (!i)
+			res.empty++;
+	}
+
+	getrusage(RUSAGE_SELF, &ru);
+	res.nvcsw = ru.ru_nvcsw;
+	res.sys = tv_secs(&ru.ru_stime);
+	if (write(out, &res, sizeof(res)) != sizeof(res))
+		exit(1);
+	exit(0);
+}
+
+static int measure(int coalesce, struct result *rx, struct rusage *tx)
+{
+	char msg[MSG_SIZE];
+	struct rusage before;
+	int sv[2], pfd[2], i, j, status;
+	pid_t pid;
+
+	if (coalesce >= 0) {
+		FILE *f = fopen(COALESCE, "w");
+
+		if (!f || fprintf(f, "%d\n", coalesce) < 0 || fclose(f)) {
+			perror(COALESCE);
+			return -1;
+		}
+	}
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) || pipe(pfd)) {
+		perror("socketpair");
+		return -1;
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (!pid) {
+		close(sv[0]);
+		receiver(sv[1], pfd[1]);
+	}
+	close(sv[1]);
+
+	set_cpu(1);
+	getrusage(RUSAGE_SELF, &before);
+	memset(msg, 'x', sizeof(msg));
+	for (i = 0; i < bursts; i++) {
+		for (j = 0; j < burst; j++) {
+			if (send(sv[0], msg, sizeof(msg), 0) != sizeof(msg)) {
+				perror("send");
+				return -1;
+			}
+		}
+		if (gap_us)
+			usleep(gap_us);
+	}
+	getrusage(RUSAGE_SELF, tx);
+	tx->ru_nvcsw -= before.ru_nvcsw;
+	tx->ru_stime.tv_sec -= before.ru_stime.tv_sec;
+	tx->ru_stime.tv_usec -= before.ru_stime.tv_usec;
+
+	if (read(pfd[0], rx, sizeof(*rx)) != sizeof(*rx) ||
+	    waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return -1;
+
+	close(sv[0]);
+	close(pfd[0]);
+	close(pfd[1]);
+	return 0;
+}
+
+static void report(const char *name, const struct result *rx,
+		   const struct rusage *tx)
+{
+	printf("%-9s %8ld %8ld %8.2f %8ld %8ld %7.2f %7.2f\n", name,
+	       rx->wakeups, rx->empty, (double)rx->msgs / rx->wakeups,
+	       rx->nvcsw, tx->ru_nvcsw, rx->sys, tv_secs(&tx->ru_stime));
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n bursts] [-b burst] [-u gap_us]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct result rx;
+	struct rusage tx;
+	int opt, old = -1, i;
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "n:b:u:")) != -1) {
+		switch (opt) {
+		case 'n': bursts = atoi(optarg); break;
+		case 'b': burst = atoi(optarg); break;
+		case 'u': gap_us = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	/* the receive queue holds max_dgram_qlen (10) datagrams */
+	if (optind != argc || bursts <= 0 || burst <= 0 || burst > 10 ||
+	    gap_us < 0)
+		usage(argv[0]);
+
+	f = fopen(COALESCE, "r");
+	if (f) {
+		if (fscanf(f, "%d", &old) != 1)
+			old = -1;
+		fclose(f);
+	}
+
+	printf("%d bursts of %d datagrams, %d us apart\n", bursts, burst,
+	       gap_us);
+	printf("%-9s %8s %8s %8s %8s %8s %7s %7s\n", "coalesce", "wakeups",
+	       "empty", "msgs/wu", "rx csw", "tx csw", "rx sys", "tx sys");
+
+	if (old < 0 || access(COALESCE, W_OK)) {
+		if (measure(-1, &rx, &tx))
+			return 1;
+		report(old < 0 ? "n/a" : old ? "on" : "off", &rx, &tx);
+		return 0;
+	}
+
+	for (i = 0; i <= 1; i++) {
+		if (measure(i, &rx, &tx))
+			break;
+		report(i ? "on" : "off", &rx, &tx);
+	}
+
+	f = fopen(COALESCE, "w");
+	if (f) {
+		fprintf(f, "%d\n", old);
+		fclose(f);
+	}
+	return 0;
+}
@@ -0,0 +1,259 @@
+/*
+ * tcp_rampup - how fast a TCP transfer reaches its steady throughput
+ *
+ * Sends a fixed amount of data over a loopback TCP connection, once with
+ * net.ipv4.tcp_rtt_autotune off and once on, and reports for each: the
+ * total time and throughput, the time until throughput first reached
+ * 90% of its steady rate (the median of the second half of the
+ * transfer), and the receive and send buffer sizes at the end.
+ *
+ * Loopback has no delay of its own.  -n applies a netem qdisc to lo for
+ * the run and removes it afterwards, for example
+ *
+ *	./tcp_rampup -n "delay 50ms rate 2mbit" -s 4
+ *	./tcp_rampup -n "delay 100ms rate 20mbit" -s 32
+ *	./tcp_rampup -n "delay 300ms rate 5mbit loss 0.5%" -s 8
+ *
+ *	gcc -O2 -o tcp_rampup tcp_rampup.c
+ *	./tcp_rampup [-n netem args] [-s MB] [-i bin_ms]
+ *
+ * Needs root for -n and for switching the sysctl; without it only the
+ * current setting is measured.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define AUTOTUNE	"/proc/sys/net/ipv4/tcp_rtt_autotune"
+#define MAX_BINS	100000
+#define BUF_SIZE	65536
+
+struct result {
+	double secs;
+	double steady_secs;
+	int rcvbuf;
+	int sndbuf;
+};
+
+static long total_bytes = 16 << 20;
+static int bin_ms = 50;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void receiver(int lfd, int out)
+{
+	static char buf[BUF_SIZE];
+	static long bins[MAX_BINS], sorted[MAX_BINS];
+	struct result res;
+	socklen_t len = sizeof(res.rcvbuf);
+	long got = 0, steady;
+	double start;
+	int fd, n, nbins = 0, bin, i;
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0) {
+		perror("accept");
+		exit(1);
+	}
+	start = now();
+	while (got < total_bytes) {
+		n = read(fd, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		got += n;
+		bin = (now() - start) * 1000 / bin_ms;
+		if (bin >= MAX_BINS)
+			bin = MAX_BINS - 1;
+		bins[bin] += n;
+		if (bin >= nbins)
+			nbins = bin + 1;
+	}
+	res.secs = now() - start;
+	getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &res.rcvbuf, &len);
+
+	/* steady rate: median bin of the second half, last bin is partial */
+	n = nbins > 2 ? nbins - 1 : nbins;
+	memcpy(sorted, bins + n / 2, (n - n / 2) * sizeof(long));
+	qsort(sorted, n - n / 2, sizeof(long), cmp_long);
+	steady = sorted[(n - n / 2) / 2];
+	res.steady_secs = res.secs;
+	for (i = 0; i < n; i++) {
+		if (bins[i] * 10 >= steady * 9) {
+			res.steady_secs = (i + 1) * bin_ms / 1000.0;
+			break;
+		}
+	}
+
+	if (write(out, &res, sizeof(res)) != sizeof(res))
+		exit(1);
+	exit(0);
+}
+
+static int measure(int autotune, struct result *res)
+{
+	static char buf[BUF_SIZE];
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	long sent = 0;
+	int lfd, fd, pfd[2], n, status, sndbuf;
+	pid_t pid;
+
+	if (autotune >= 0) {
+		FILE *f = fopen(AUTOTUNE, "w");
+
+		if (!f || fprintf(f, "%d\n", autotune) < 0 || fclose(f)) {
+			perror(AUTOTUNE);
+			return -1;
+		}
+	}
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &len) ||
+	    listen(lfd, 1) || pipe(pfd)) {
+		perror("listen");
+		return -1;
+	}
+
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (!pid)
+		receiver(lfd, pfd[1]);
+	close(lfd);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("connect");
+		return -1;
+	}
+	memset(buf, 'x', sizeof(buf));
+	while (sent < total_bytes) {
+		n = write(fd, buf, sizeof(buf));
+		if (n <= 0) {
+			perror("write");
+			return -1;
+		}
+		sent += n;
+	}
+	len = sizeof(sndbuf);
+	getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len);
+	close(fd);
+
+	if (read(pfd[0], res, sizeof(*res)) != sizeof(*res) ||
+	    waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return -1;
+	res->sndbuf = sndbuf;
+	close(pfd[0]);
+	close(pfd[1]);
+	return 0;
+}
+
+static void report(const char *name, const struct result *res)
+{
+	printf("%-9s %8.2f %10.2f %10.2f %10d %10d\n", name, res->secs,
+	       total_bytes * 8 / res->secs / 1e6, res->steady_secs,
+	       res->rcvbuf, res->sndbuf);
+}
+
+static int netem(const char *args)
+{
+	char cmd[512];
+
+	if (args)
+		snprintf(cmd, sizeof(cmd),
+			 "tc qdisc replace dev lo root netem %s", args);
+	else
+		snprintf(cmd, sizeof(cmd), "tc qdisc del dev lo root");
+	return system(cmd);
+}
+
+int main(int argc, char **argv)
+{
+	struct result res;
+	const char *shape = NULL;
+	int opt, old = -1, i, ret = 0;
+	FILE *f;
+
+	while ((opt = getopt(argc, argv, "n:s:i:")) != -1) {
+		switch (opt) {
+		case 'n': shape = optarg; break;
+		case 's': total_bytes = atol(optarg) << 20; break;
+		case 'i': bin_ms = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n netem args] [-s MB] "
+				"[-i bin_ms]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (total_bytes <= 0 || bin_ms <= 0)
+		return 1;
+
+	f = fopen(AUTOTUNE, "r");
+	if (f) {
+		if (fscanf(f, "%d", &old) != 1)
+			old = -1;
+		fclose(f);
+	}
+
+	if (shape && netem(shape)) {
+		fprintf(stderr, "could not set up netem on lo\n");
+		return 1;
+	}
+
+	printf("%ld MB%s%s, %d ms bins\n", total_bytes >> 20,
+	       shape ? " over " : "", shape ? shape : "", bin_ms);
+	printf("%-9s %8s %10s %10s %10s %10s\n", "autotune", "secs",
+	       "Mbit/s", "steady at", "rcvbuf", "sndbuf");
+
+	if (old < 0 || access(AUTOTUNE, W_OK)) {
+		if (measure(-1, &res))
+			ret = 1;
+		else
+			report(old < 0 ? "n/a" : old ? "on" : "off", &res);
+	} else {
+		for (i = 0; i <= 1; i++) {
+			if (measure(i, &res)) {
+				ret = 1;
+				break;
+			}
+			report(i ? "on" : "off", &res);
+		}
+		f = fopen(AUTOTUNE, "w");
+		if (f) {
+			fprintf(f, "%d\n", old);
+			fclose(f);
+		}
+	}
+
+	if (shape)
+		netem(NULL);
+	return ret;
+}
@@ -0,0 +1,214 @@
+/*
+ * sched-bwc-bench - wakeup latency of a periodic task next to a CPU hog
+ * running in a bandwidth limited group.
+ *
+ * Everything is bound to one CPU.  A child spins in a "bwc_bench" group
+ * created under the cpu cgroup mount, while the parent stays in the
+ * group it was started in and acts as a UI thread: it wakes up every
+ * frame, does a little work and goes back to sleep.  The delay between
+ * the programmed and the actual wakeup is reported, followed by the
+ * group's cpu.stat.
+ *
+ *	gcc -O2 -o sched-bwc-bench sched-bwc-bench.c -lrt
+ *	mount -t cgroup -o cpu none /dev/cpuctl
+ *	./sched-bwc-bench [-q quota_us] [-p period_us] [-s shares]
+ *			  [-f frame_us] [-w work_us] [-t seconds] /dev/cpuctl
+ *
+ * A quota of -1 (the default) leaves the group unconstrained, to compare
+ * against the same run with a limit.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NSEC_PER_SEC	1000000000LL
+#define NR_BUCKETS	64
+
+static char group[4096];
+
+static long long ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_ns(&ts);
+}
+
+static int write_file(const char *dir, const char *name, const char *val)
+{
+	char path[4200];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	ret = fprintf(f, "%s\n", val) < 0;
+	if (fclose(f) || ret) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+static int write_long(const char *dir, const char *name, long val)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%ld", val);
+	return write_file(dir, name, buf);
+}
+
+static void show_stat(const char *dir)
+{
+	char path[4200], line[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/cpu.stat", dir);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	while (fgets(line, sizeof(line), f))
+		printf("  %s", line);
+	fclose(f);
+}
+
+static void spin(long long ns)
+{
+	long long end = now_ns() + ns;
+
+	while (now_ns() < end)
+		;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-q quota_us] [-p period_us] [-s shares] "
+		"[-f frame_us] [-w work_us] [-t seconds] <cpu cgroup mount>\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	long quota = -1, period = 100000, shares = 0;
+	long frame = 16000, work = 2000, seconds = 10;
+	unsigned long hist[NR_BUCKETS];
+	long long sum = 0, max = 0, next, end, lat;
+	unsigned long n = 0, acc;
+	cpu_set_t cpus;
+	struct timespec ts;
+	pid_t hog;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "q:p:s:f:w:t:")) != -1) {
+		switch (opt) {
+		case 'q': quota = atol(optarg); break;
+		case 'p': period = atol(optarg); break;
+		case 's': shares = atol(optarg); break;
+		case 'f': frame = atol(optarg); break;
+		case 'w': work = atol(optarg); break;
+		case 't': seconds = atol(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || frame <= 0 || work >= frame)
+		usage(argv[0]);
+
+	snprintf(group, sizeof(group), "%s/bwc_bench", argv[optind]);
+	if (mkdir(group, 0755) && errno != EEXIST) {
+		perror(group);
+		return 1;
+	}
+	if (write_long(group, "cpu.cfs_period_us", period) ||
+	    write_long(group, "cpu.cfs_quota_us", quota))
+		return 1;
+	if (shares && write_long(group, "cpu.shares", shares))
+		return 1;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(0, &cpus);
+	if (sched_setaffinity(0, sizeof(cpus), &cpus))
+		perror("sched_setaffinity");
+
+	hog = fork();
+	if (hog < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!hog) {
+		if (write_long(group, "tasks", getpid()))
+			_exit(1);
+		for (;;)
+			;
+	}
+
+	/* let the hog settle in its group */
+	sleep(1);
+
+	memset(hist, 0, sizeof(hist));
+	next = now_ns();
+	end = next + seconds * NSEC_PER_SEC;
+	while (next < end) {
+		next += frame * 1000LL;
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				       &ts, NULL) == EINTR)
+			;
+		lat = now_ns() - next;
+		if (lat < 0)
+			lat = 0;
+
+		sum += lat;
+		if (lat > max)
+			max = lat;
+		/* bucket i holds latencies below 2^i usecs */
+		for (i = 0; i < NR_BUCKETS - 1 && (lat / 1000) >> i; i++)
+			;
+		hist[i]++;
+		n++;
+
+		spin(work * 1000LL);
+		/* don't try to catch up on missed frames */
+		if (now_ns() > next + frame * 1000LL)
+			next = now_ns();
+	}
+
+	kill(hog, SIGKILL);
+	waitpid(hog, NULL, 0);
+
+	printf("quota %ld us, period %ld us, frame %ld us, work %ld us\n",
+	       quota, period, frame, work);
+	printf("wakeups %lu, avg %lld us, max %lld us\n",
+	       n, n ? sum / n / 1000 : 0, max / 1000);
+	for (i = 0, acc = 0; i < NR_BUCKETS; i++) {
+		if (!hist[i])
+			continue;
+		acc += hist[i];
+		printf("  < %8llu us: %8lu (%5.1f%%)\n",
+		       1ULL << i, hist[i], 100.0 * acc / n);
+	}
+	printf("%s/cpu.stat:\n", group);
+	show_stat(group);
+
+	rmdir(group);
+	return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * sched-wakeup-bench - hackbench-style scheduler benchmark.
+ *
+ * Each group has a number of sender and receiver processes connected by
+ * socketpairs; every sender writes loops messages of 100 bytes to every
+ * receiver of its group.  This does little more than wake up and switch
+ * between tasks, so comparing the run time of kernels with and without
+ * CONFIG_SCHED_WAKEUP_STATS shows what the accounting costs.  When
+ * /proc/self/wakeup_latency exists, the wakeup latencies of all children
+ * are summed up and reported too.
+ *
+ *	gcc -O2 -o sched-wakeup-bench sched-wakeup-bench.c
+ *	./sched-wakeup-bench [groups] [loops] [fds]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DATASIZE	100
+
+struct result {
+	unsigned long		wakeups;
+	unsigned long long	total_us;
+	unsigned long long	max_us;
+};
+
+static int groups = 10, loops = 100, nr_fds = 20;
+static int ready[2], go[2], results[2];
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(void)
+{
+	struct result r = { 0, 0, 0 };
+	char key[32];
+	unsigned long long val;
+	FILE *f;
+
+	f = fopen("/proc/self/wakeup_latency", "r");
+	if (f) {
+		while (fscanf(f, "%31s %llu", key, &val) == 2) {
+			if (!strcmp(key, "wakeups"))
+				r.wakeups = val;
+			else if (!strcmp(key, "total_us"))
+				r.total_us = val;
+			else if (!strcmp(key, "max_us"))
+				r.max_us = val;
+		}
+		fclose(f);
+	}
+	if (write(results[1], &r, sizeof(r)) != sizeof(r))
+		barf("write results");
+}
+
+/* wait until all the children are there, then start them together */
+static void start_barrier(void)
+{
+	char c = 0;
+
+	if (write(ready[1], &c, 1) != 1)
+		barf("write ready");
+	if (read(go[0], &c, 1) != 1)
+		barf("read go");
+}
+
+static void sender(int *out)
+{
+	char data[DATASIZE];
+	int i, j;
+	ssize_t n;
+
+	memset(data, 'x', sizeof(data));
+	start_barrier();
+	for (i = 0; i < loops; i++) {
+		for (j = 0; j < nr_fds; j++) {
+			size_t done = 0;
+
+			while (done < sizeof(data)) {
+				n = write(out[j], data + done,
+					  sizeof(data) - done);
+				if (n < 0)
+					barf("sender write");
+				done += n;
+			}
+		}
+	}
+	report();
+	exit(0);
+}
+
+static void receiver(int in, unsigned int bytes)
+{
+	char data[DATASIZE];
+	ssize_t n;
+
+	start_barrier();
+	while (bytes > 0) {
+		n = read(in, data, bytes < sizeof(data) ? bytes : sizeof(data));
+		if (n <= 0)
+			barf("receiver read");
+		bytes -= n;
+	}
+	report();
+	exit(0);
+}
+
+static void group(void)
+{
+	int out[nr_fds];
+	int i, fds[2];
+
+	for (i = 0; i < nr_fds; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+			barf("socketpair");
+		switch (fork()) {
+		case -1:
+			barf("fork");
+		case 0:
+			close(fds[1]);
+			receiver(fds[0], DATASIZE * nr_fds * loops);
+		}
+		out[i] = fds[1];
+		close(fds[0]);
+	}
+
+	for (i = 0; i < nr_fds; i++) {
+		switch (fork()) {
+		case -1:
+			barf("fork");
+		case 0:
+			sender(out);
+		}
+	}
+
+	for (i = 0; i < nr_fds; i++)
+		close(out[i]);
+}
+
+int main(int argc, char **argv)
+{
+	struct result r, sum = { 0, 0, 0 };
+	int i, nr_children;
+	double start, end;
+	char c;
+
+	if (argc > 1)
+		groups = atoi(argv[1]);
+	if (argc > 2)
+		loops = atoi(argv[2]);
+	if (argc > 3)
+		nr_fds = atoi(argv[3]);
+	if (groups <= 0 || loops <= 0 || nr_fds <= 0) {
+		fprintf(stderr, "usage: %s [groups] [loops] [fds]\n", argv[0]);
+		return 1;
+	}
+	nr_children = groups * nr_fds * 2;
+
+	if (pipe(ready) || pipe(go) || pipe(results))
+		barf("pipe");
+
+	for (i = 0; i < groups; i++)
+		group();
+
+	for (i = 0; i < nr_children; i++)
+		if (read(ready[0], &c, 1) != 1)
+			barf("read ready");
+
+	start = now();
+	for (i = 0; i < nr_children; i++)
+		if (write(go[1], &c, 1) != 1)
+			barf("write go");
+
+	for (i = 0; i < nr_children; i++) {
+		if (read(results[0], &r, sizeof(r)) != sizeof(r))
+			barf("read results");
+		sum.wakeups += r.wakeups;
+		sum.total_us += r.total_us;
+		if (r.max_us > sum.max_us)
+			sum.max_us = r.max_us;
+	}
+	end = now();
+
+	while (wait(NULL) > 0)
+		;
+
+	printf("%d groups, %d tasks, %d loops: %.3f s\n",
+	       groups, nr_children, loops, end - start);
+	if (sum.wakeups)
+		printf("wakeups %lu, avg %llu us, max %llu us\n", sum.wakeups,
+		       sum.total_us / sum.wakeups, sum.max_us);
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * timer_idle - count idle wakeups with and without timer coalescing
+ *
+ * Meant to be run on an otherwise idle system, for example from the
+ * init script of a QEMU guest booted with the kernel under test, or
+ * over adb on a device with the screen off.  For each setting of
+ * /proc/sys/kernel/timer_coalescing the program waits for the already
+ * armed timers to be re-armed, then sleeps for the sample period and
+ * reports the interrupts taken (from /proc/stat) and the timer expiries
+ * and saved wakeups seen by /proc/timer_stats.
+ *
+ *	gcc -O2 -o timer_idle timer_idle.c
+ *	./timer_idle [-t seconds] [-s settle_seconds] [-c 0|1]
+ *
+ * Without -c both settings are measured, coalescing off first.  Needs
+ * root and CONFIG_TIMER_STATS for the timer_stats columns.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define COALESCING	"/proc/sys/kernel/timer_coalescing"
+#define TIMER_STATS	"/proc/timer_stats"
+
+struct sample {
+	double		secs;
+	unsigned long long irqs;
+	unsigned long	events;
+	unsigned long	coalesced;
+};
+
+static int write_file(const char *path, const char *val)
+{
+	FILE *f;
+	int ret;
+
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	ret = fprintf(f, "%s\n", val) < 0;
+	if (fclose(f) || ret) {
+		perror(path);
+		return -1;
+	}
+	return 0;
+}
+
+static int read_int(const char *path)
+{
+	FILE *f;
+	int val = -1;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	if (fscanf(f, "%d", &val) != 1)
+		val = -1;
+	fclose(f);
+	return val;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* the first number of the "intr" line is the total over all irqs */
+static unsigned long long total_irqs(void)
+{
+	unsigned long long val = 0;
+	char line[256];
+	FILE *f;
+
+	f = fopen("/proc/stat", "r");
+	if (!f) {
+		perror("/proc/stat");
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "intr %llu", &val) == 1)
+			break;
+	fclose(f);
+	return val;
+}
+
+static void read_timer_stats(struct sample *s)
+{
+	char line[256];
+	unsigned long val;
+	FILE *f;
+
+	f = fopen(TIMER_STATS, "r");
+	if (!f)
+		return;
+	/* the per timer lines are "count, pid comm ..." */
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%lu total events", &val) == 1 &&
+		    strstr(line, "total events"))
+			s->events = val;
+		else if (sscanf(line, "%lu coalesced events", &val) == 1 &&
+			 strstr(line, "coalesced events"))
+			s->coalesced = val;
+	}
+	fclose(f);
+}
+
+static int measure(int coalescing, int seconds, int settle, struct sample *s)
+{
+	unsigned long long irqs;
+	int stats;
+	double start;
+
+	if (write_file(COALESCING, coalescing ? "1" : "0"))
+		return -1;
+	/* timers armed before the switch keep their old expiry */
+	sleep(settle);
+
+	memset(s, 0, sizeof(*s));
+	stats = !access(TIMER_STATS, W_OK) && !write_file(TIMER_STATS, "1");
+	irqs = total_irqs();
+	start = now();
+	sleep(seconds);
+	s->irqs = total_irqs() - irqs;
+	s->secs = now() - start;
+	if (stats) {
+		write_file(TIMER_STATS, "0");
+		read_timer_stats(s);
+	}
+	return 0;
+}
+
+static void report(int coalescing, const struct sample *s)
+{
+	printf("coalescing %-3s  %8.1f irqs/s  %8.1f timers/s  %8.1f saved/s\n",
+	       coalescing ? "on" : "off", s->irqs / s->secs,
+	       s->events / s->secs, s->coalesced / s->secs);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-t seconds] [-s settle_seconds] [-c 0|1]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int seconds = 10, settle = 2, only = -1;
+	struct sample s;
+	int opt, old, i;
+
+	while ((opt = getopt(argc, argv, "t:s:c:")) != -1) {
+		switch (opt) {
+		case 't': seconds = atoi(optarg); break;
+		case 's': settle = atoi(optarg); break;
+		case 'c': only = !!atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || seconds <= 0 || settle < 0)
+		usage(argv[0]);
+
+	old = read_int(COALESCING);
+	if (old < 0)
+		return 1;
+
+	for (i = 0; i <= 1; i++) {
+		if (only >= 0 && i != only)
+			continue;
+		if (measure(i, seconds, settle, &s))
+			break;
+		report(i, &s);
+	}
+
+	write_file(COALESCING, old ? "1" : "0");
+	return 0;
+}
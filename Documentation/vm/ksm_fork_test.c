@@ -0,0 +1,230 @@
+/*
+ * ksm_fork_test - KSM savings and cost for children of a merge-any parent
+ *
+ * The parent turns on PR_SET_MEMORY_MERGE and forks children which each
+ * map and fill a private heap.  Most pages hold the same data in every
+ * child, a given share is different in each.  While ksmd merges them,
+ * the program prints pages_shared, pages_sharing, the memory saved and
+ * the cpu time ksmd has used, once a second until pages_sharing stops
+ * growing.
+ *
+ * Before that it checks that the setting is inherited by fork and
+ * cleared by exec.
+ *
+ *	gcc -O2 -o ksm_fork_test ksm_fork_test.c
+ *	./ksm_fork_test [-c children] [-m MB] [-d distinct%] [-t seconds]
+ *
+ * Needs root to start ksmd through /sys/kernel/mm/ksm/run, which is
+ * restored afterwards.  Try a few pages_to_scan settings to see how the
+ * savings grow against ksmd's cpu time.
+ */
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef PR_SET_MEMORY_MERGE
+#define PR_SET_MEMORY_MERGE	67
+#define PR_GET_MEMORY_MERGE	68
+#endif
+
+#define KSM_DIR		"/sys/kernel/mm/ksm/"
+#define MAX_CHILDREN	1024
+
+static int nr_children = 16, heap_mb = 16, distinct = 10, timeout = 60;
+static pid_t children[MAX_CHILDREN];
+
+static long read_long(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	long val = -1;
+
+	if (f) {
+		if (fscanf(f, "%ld", &val) != 1)
+			val = -1;
+		fclose(f);
+	}
+	return val;
+}
+
+static int write_long(const char *path, long val)
+{
+	FILE *f = fopen(path, "w");
+
+	if (!f)
+		return -1;
+	fprintf(f, "%ld\n", val);
+	return fclose(f);
+}
+
+/* ksmd's utime + stime in clock ticks, -1 if it cannot be found */
+static long ksmd_ticks(void)
+{
+	static char path[300];
+	char buf[512], *p;
+	unsigned long utime, stime;
+	struct dirent *d;
+	DIR *dir;
+	FILE *f;
+
+	if (!path[0]) {
+		dir = opendir("/proc");
+		if (!dir)
+			return -1;
+		while ((d = readdir(dir))) {
+			snprintf(buf, sizeof(buf), "/proc/%s/comm", d->d_name);
+			f = fopen(buf, "r");
+			if (!f)
+				continue;
+			if (fgets(buf, sizeof(buf), f) &&
+			    !strcmp(buf, "ksmd\n"))
+				snprintf(path, sizeof(path), "/proc/%s/stat",
+					 d->d_name);
+			fclose(f);
+			if (path[0])
+				break;
+		}
+		closedir(dir);
+		if (!path[0])
+			return -1;
+	}
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (!p || !(p = strrchr(buf, ')')) ||
+	    sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		   &utime, &stime) != 2)
+		return -1;
+	return utime + stime;
+}
+
+static void child(int id)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	long pages = ((long)heap_mb << 20) / page, i;
+	char *heap;
+
+	heap = mmap(NULL, pages * page, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (heap == MAP_FAILED)
+		exit(1);
+	for (i = 0; i < pages; i++) {
+		memset(heap + i * page, (int)(i & 0xff), page);
+		*(long *)(heap + i * page) = i;
+		if (i % 100 < distinct)
+			*(int *)(heap + i * page + sizeof(long)) = id + 1;
+	}
+	pause();
+	exit(0);
+}
+
+/* fork inherits the setting, exec drops it */
+static int check_inheritance(const char *self)
+{
+	int status, ret = 0;
+	pid_t pid;
+
+	pid = fork();
+	if (!pid)
+		exit(prctl(PR_GET_MEMORY_MERGE, 0, 0, 0, 0) == 1 ? 0 : 1);
+	waitpid(pid, &status, 0);
+	printf("inherited by fork:  %s\n",
+	       WIFEXITED(status) && !WEXITSTATUS(status) ? "yes" : "NO");
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		ret = 1;
+
+	fflush(stdout);
+	pid = fork();
+	if (!pid) {
+		execl(self, self, "--get", (char *)NULL);
+		exit(2);
+	}
+	waitpid(pid, &status, 0);
+	printf("cleared by exec:    %s\n",
+	       WIFEXITED(status) && !WEXITSTATUS(status) ? "yes" : "NO");
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		ret = 1;
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	long shared, sharing, last = -1, ticks0, ticks, hz;
+	long page = sysconf(_SC_PAGESIZE);
+	int opt, i, t, still = 0, old_run, ret = 0;
+
+	if (argc == 2 && !strcmp(argv[1], "--get"))
+		return prctl(PR_GET_MEMORY_MERGE, 0, 0, 0, 0) == 0 ? 0 : 1;
+
+	while ((opt = getopt(argc, argv, "c:m:d:t:")) != -1) {
+		switch (opt) {
+		case 'c': nr_children = atoi(optarg); break;
+		case 'm': heap_mb = atoi(optarg); break;
+		case 'd': distinct = atoi(optarg); break;
+		case 't': timeout = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-c children] [-m MB] "
+				"[-d distinct%%] [-t seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (nr_children < 1 || nr_children > MAX_CHILDREN || heap_mb < 1 ||
+	    distinct < 0 || distinct > 100)
+		return 1;
+
+	if (prctl(PR_SET_MEMORY_MERGE, 1, 0, 0, 0)) {
+		perror("PR_SET_MEMORY_MERGE");
+		return 1;
+	}
+	if (check_inheritance("/proc/self/exe"))
+		ret = 1;
+
+	old_run = read_long(KSM_DIR "run");
+	if (old_run != 1 && write_long(KSM_DIR "run", 1)) {
+		perror(KSM_DIR "run");
+		return 1;
+	}
+
+	hz = sysconf(_SC_CLK_TCK);
+	ticks0 = ksmd_ticks();
+	for (i = 0; i < nr_children; i++) {
+		children[i] = fork();
+		if (!children[i])
+			child(i);
+	}
+
+	printf("%d children, %d MB each, %d%% distinct, pages_to_scan %ld\n",
+	       nr_children, heap_mb, distinct,
+	       read_long(KSM_DIR "pages_to_scan"));
+	printf("%4s %12s %13s %9s %9s\n", "secs", "pages_shared",
+	       "pages_sharing", "saved MB", "ksmd cpu");
+	for (t = 1; t <= timeout && still < 3; t++) {
+		sleep(1);
+		shared = read_long(KSM_DIR "pages_shared");
+		sharing = read_long(KSM_DIR "pages_sharing");
+		ticks = ksmd_ticks();
+		printf("%4d %12ld %13ld %9.1f %8.2fs\n", t, shared, sharing,
+		       (double)sharing * page / (1 << 20),
+		       ticks >= 0 && ticks0 >= 0 ?
+		       (double)(ticks - ticks0) / hz : -1.0);
+		fflush(stdout);
+		still = sharing == last ? still + 1 : 0;
+		last = sharing;
+	}
+
+	for (i = 0; i < nr_children; i++)
+		kill(children[i], SIGKILL);
+	while (wait(NULL) > 0)
+		;
+	if (old_run >= 0 && old_run != 1)
+		write_long(KSM_DIR "run", old_run);
+	return ret;
+}
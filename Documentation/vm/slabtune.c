@@ -0,0 +1,135 @@
+/*
+ * slabtune - per-cpu array refill and flush rates of SLAB caches
+ *
+ * Samples /proc/slabinfo twice and prints, for each cache, the array
+ * refills (allocmiss) and flushes (freemiss) per cpu and second over the
+ * interval, next to the current limit and the auto-tune grow and shrink
+ * counts.  Caches at or above the busy rate (slabtune_busy=, 1000 by
+ * default) are the ones cache_reap() grows.  Running it under a workload
+ * shows how the caches spread around the threshold.
+ *
+ * Needs CONFIG_DEBUG_SLAB for the statistics columns and root to read
+ * /proc/slabinfo.
+ *
+ *	gcc -O2 -o slabtune slabtune.c
+ *	./slabtune [-i seconds] [-b busy_rate] [-a]
+ *
+ * -a lists idle caches too.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_CACHES	512
+
+struct cache {
+	char name[64];
+	unsigned long limit;
+	unsigned long allocmiss;
+	unsigned long freemiss;
+	unsigned long grown;
+	unsigned long shrunk;
+	double rate;
+};
+
+static struct cache before[MAX_CACHES], after[MAX_CACHES];
+
+static int read_slabinfo(struct cache *caches)
+{
+	char line[1024];
+	char *p;
+	FILE *f;
+	int n = 0;
+
+	f = fopen("/proc/slabinfo", "r");
+	if (!f) {
+		perror("/proc/slabinfo");
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), f) && n < MAX_CACHES) {
+		struct cache *c = &caches[n];
+
+		if (line[0] == '#' || !strncmp(line, "slabinfo", 8))
+			continue;
+		if (sscanf(line, "%63s", c->name) != 1)
+			continue;
+		p = strstr(line, ": tunables");
+		if (!p || sscanf(p, ": tunables %lu", &c->limit) != 1)
+			continue;
+		p = strstr(line, ": cpustat");
+		if (!p || sscanf(p, ": cpustat %*u %lu %*u %lu",
+				 &c->allocmiss, &c->freemiss) != 2) {
+			fprintf(stderr, "no cpustat in /proc/slabinfo, "
+				"CONFIG_DEBUG_SLAB is needed\n");
+			exit(1);
+		}
+		p = strstr(line, ": autotune");
+		c->grown = c->shrunk = 0;
+		if (p)
+			sscanf(p, ": autotune %lu %lu", &c->grown, &c->shrunk);
+		n++;
+	}
+	fclose(f);
+	return n;
+}
+
+static int by_rate(const void *a, const void *b)
+{
+	const struct cache *x = a, *y = b;
+
+	return (y->rate > x->rate) - (y->rate < x->rate);
+}
+
+int main(int argc, char **argv)
+{
+	int interval = 10, all = 0, nb, na, i, j, opt;
+	double busy = 1000;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((opt = getopt(argc, argv, "i:b:a")) != -1) {
+		switch (opt) {
+		case 'i': interval = atoi(optarg); break;
+		case 'b': busy = atof(optarg); break;
+		case 'a': all = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-i seconds] [-b busy_rate] "
+				"[-a]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (interval <= 0 || cpus <= 0)
+		return 1;
+
+	nb = read_slabinfo(before);
+	sleep(interval);
+	na = read_slabinfo(after);
+
+	for (i = 0; i < na; i++) {
+		after[i].rate = 0;
+		for (j = 0; j < nb; j++) {
+			if (strcmp(after[i].name, before[j].name))
+				continue;
+			after[i].rate = (double)(after[i].allocmiss -
+						 before[j].allocmiss +
+						 after[i].freemiss -
+						 before[j].freemiss) /
+					interval / cpus;
+			break;
+		}
+	}
+	qsort(after, na, sizeof(after[0]), by_rate);
+
+	printf("%ld cpus, %d s, busy at %.0f refills+flushes per cpu and s\n",
+	       cpus, interval, busy);
+	printf("%-24s %10s %6s %7s %7s\n", "cache", "rate/cpu/s", "limit",
+	       "grown", "shrunk");
+	for (i = 0; i < na; i++) {
+		if (!all && after[i].rate < 1)
+			break;
+		printf("%-24s %10.1f %6lu %7lu %7lu%s\n", after[i].name,
+		       after[i].rate, after[i].limit, after[i].grown,
+		       after[i].shrunk, after[i].rate >= busy ? "  busy" : "");
+	}
+	return 0;
+}
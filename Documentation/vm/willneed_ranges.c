@@ -0,0 +1,262 @@
+/*
+ * willneed_ranges - major faults of a launch-like access pattern, with and
+ * without replaying the recorded ranges through FS_IOC_WILLNEED_RANGES
+ *
+ * The program maps a file read-only and touches clusters of pages at
+ * pseudo-random offsets, the way an app launch touches an APK or dex
+ * file.  A first cold run records the pages that ended up in the page
+ * cache, using mincore(), as a list of ranges.  Then, each time after
+ * dropping caches, it repeats the same accesses:
+ *
+ *	none	without any hint
+ *	fadvise	after one POSIX_FADV_WILLNEED per recorded range
+ *	ioctl	after one FS_IOC_WILLNEED_RANGES call with all of them
+ *
+ * For each it prints the major faults taken while touching the pages, the
+ * time taken by the hint and by the accesses, and the pages read in from
+ * /proc/vmstat pgpgin.
+ *
+ * To measure a file on a loop-mounted image, as on a device:
+ *
+ *	mount -o loop,ro system.img /mnt
+ *	./willneed_ranges -c 200 /mnt/app/Browser.apk
+ *
+ *	gcc -O2 -o willneed_ranges willneed_ranges.c
+ *	./willneed_ranges [-c clusters] [-n pages_per_cluster] [-r runs] file
+ *
+ * Needs root to drop caches.  The ioctl row shows n/a on kernels without
+ * FS_IOC_WILLNEED_RANGES.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+struct fadvise_range {
+	uint64_t offset;
+	uint64_t len;
+};
+
+struct fadvise_ranges {
+	uint64_t ranges;
+	uint32_t count;
+	uint32_t flags;
+};
+
+#ifndef FS_IOC_WILLNEED_RANGES
+#define FS_IOC_WILLNEED_RANGES	_IOW('f', 12, struct fadvise_ranges)
+#endif
+#define FADV_MAX_RANGES		1024
+
+enum { HINT_NONE, HINT_FADVISE, HINT_IOCTL };
+static const char *hint_names[] = { "none", "fadvise", "ioctl" };
+
+static int clusters = 100, cluster_pages = 4, runs = 3;
+static long page_size;
+static struct fadvise_range ranges[FADV_MAX_RANGES];
+static unsigned int nr_ranges;
+static volatile unsigned long sink;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static long majflt(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+static long pgpgin(void)
+{
+	char name[64];
+	long val;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	if (!f)
+		return -1;
+	while (fscanf(f, "%63s %ld", name, &val) == 2) {
+		if (!strcmp(name, "pgpgin")) {
+			fclose(f);
+			return val;
+		}
+	}
+	fclose(f);
+	return -1;
+}
+
+static int drop_caches(void)
+{
+	int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	int ret;
+
+	sync();
+	if (fd < 0)
+		return -1;
+	ret = write(fd, "3\n", 2) == 2 ? 0 : -1;
+	close(fd);
+	return ret;
+}
+
+static char *map_file(int fd, unsigned long pages)
+{
+	char *map = mmap(NULL, pages * page_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	return map;
+}
+
+/* the same clusters every run */
+static unsigned long touch(const char *map, unsigned long pages)
+{
+	unsigned long sum = 0, page;
+	unsigned int seed = 1;
+	int i, j;
+
+	for (i = 0; i < clusters; i++) {
+		page = rand_r(&seed) % pages;
+		for (j = 0; j < cluster_pages && page + j < pages; j++)
+			sum += map[(page + j) * page_size];
+	}
+	return sum;
+}
+
+/* turn what the page cache holds now into ranges */
+static void record(char *map, unsigned long pages)
+{
+	unsigned char *vec = malloc(pages);
+	unsigned long i, start;
+
+	if (!vec || mincore(map, pages * page_size, vec)) {
+		perror("mincore");
+		exit(1);
+	}
+	nr_ranges = 0;
+	for (i = 0; i < pages && nr_ranges < FADV_MAX_RANGES; i++) {
+		if (!(vec[i] & 1))
+			continue;
+		for (start = i; i < pages && (vec[i] & 1); i++)
+			;
+		ranges[nr_ranges].offset = start * page_size;
+		ranges[nr_ranges].len = (i - start) * page_size;
+		nr_ranges++;
+	}
+	free(vec);
+}
+
+static int hint(int fd, int how)
+{
+	struct fadvise_ranges arg;
+	unsigned int i;
+
+	switch (how) {
+	case HINT_FADVISE:
+		for (i = 0; i < nr_ranges; i++)
+			if (posix_fadvise(fd, ranges[i].offset, ranges[i].len,
+					  POSIX_FADV_WILLNEED))
+				return -1;
+		break;
+	case HINT_IOCTL:
+		arg.ranges = (uintptr_t)ranges;
+		arg.count = nr_ranges;
+		arg.flags = 0;
+		return ioctl(fd, FS_IOC_WILLNEED_RANGES, &arg);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long pages;
+	long faults, pgin;
+	double t0, t1, t2;
+	struct stat st;
+	char *map;
+	int fd, opt, how, run;
+
+	while ((opt = getopt(argc, argv, "c:n:r:")) != -1) {
+		switch (opt) {
+		case 'c': clusters = atoi(optarg); break;
+		case 'n': cluster_pages = atoi(optarg); break;
+		case 'r': runs = atoi(optarg); break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || clusters <= 0 || cluster_pages <= 0 ||
+	    runs <= 0)
+		goto usage;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	pages = st.st_size / page_size;
+	if (!pages) {
+		fprintf(stderr, "%s: smaller than a page\n", argv[optind]);
+		return 1;
+	}
+
+	/* mapped pages would survive drop_caches, so map only while in use */
+	if (drop_caches()) {
+		perror("drop_caches");
+		return 1;
+	}
+	map = map_file(fd, pages);
+	sink += touch(map, pages);
+	record(map, pages);
+	munmap(map, pages * page_size);
+
+	printf("%s: %lu pages, %d clusters of %d, %u ranges recorded\n",
+	       argv[optind], pages, clusters, cluster_pages, nr_ranges);
+	printf("%-8s %4s %8s %9s %9s %8s\n", "hint", "run", "majflt",
+	       "hint ms", "touch ms", "pgpgin");
+	for (how = HINT_NONE; how <= HINT_IOCTL; how++) {
+		for (run = 1; run <= runs; run++) {
+			drop_caches();
+			pgin = pgpgin();
+			t0 = now();
+			if (hint(fd, how)) {
+				printf("%-8s %4d %8s (%s)\n", hint_names[how],
+				       run, "n/a", strerror(errno));
+				break;
+			}
+			t1 = now();
+			map = map_file(fd, pages);
+			faults = majflt();
+			sink += touch(map, pages);
+			faults = majflt() - faults;
+			t2 = now();
+			munmap(map, pages * page_size);
+			printf("%-8s %4d %8ld %9.2f %9.2f %8ld\n",
+			       hint_names[how], run, faults, (t1 - t0) * 1e3,
+			       (t2 - t1) * 1e3, pgpgin() - pgin);
+		}
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-c clusters] [-n pages_per_cluster] "
+		"[-r runs] file\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,224 @@
+/*
+ * workingset_test - file working set transition under refault detection
+ *
+ * The program first makes file A the working set by reading it three
+ * times, so that it ends up on the active list.  It then reads a second
+ * file, B, in passes.  B is larger than the inactive list but, together
+ * with what is left of A, does not fit in memory.
+ *
+ * Without refault detection, each pass of B evicts the pages of the pass
+ * before it from the inactive list before they are used again, so every
+ * pass reads all of B from disk while A stays resident.  With detection,
+ * pages of B that come back within the size of the active list are
+ * activated on refault.  B then displaces A, and later passes are served
+ * from the page cache.
+ *
+ * Each pass prints how much of B was resident before it, the MB read in
+ * (pgpgin), the workingset_refault and workingset_activate events, and
+ * the time taken.
+ *
+ *	gcc -O2 -o workingset_test workingset_test.c
+ *	./workingset_test [-d dir] [-l lock_MB] [-a A_MB] [-b B_MB] [-p passes]
+ *
+ * A and B default to 50% and 60% of the memory left after -l MB of
+ * anonymous memory has been mlocked, which keeps the files small on
+ * machines with a lot of RAM.  Needs root for -l and to drop caches.
+ * Boot with workingset_entries=1 to see the behaviour without
+ * refault detection.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define BUF_SIZE	(1 << 20)
+
+struct stats {
+	long pgpgin;
+	long refault;
+	long activate;
+};
+
+static char buf[BUF_SIZE];
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* newer kernels split the events into _anon and _file, add them up */
+static void read_stats(struct stats *s)
+{
+	char name[64];
+	long val;
+	FILE *f = fopen("/proc/vmstat", "r");
+
+	memset(s, 0, sizeof(*s));
+	if (!f)
+		return;
+	while (fscanf(f, "%63s %ld", name, &val) == 2) {
+		if (!strcmp(name, "pgpgin"))
+			s->pgpgin = val;
+		else if (!strncmp(name, "workingset_refault", 18))
+			s->refault += val;
+		else if (!strncmp(name, "workingset_activate", 19))
+			s->activate += val;
+	}
+	fclose(f);
+}
+
+static long mem_kb(const char *field)
+{
+	char line[128];
+	long val = -1;
+	FILE *f = fopen("/proc/meminfo", "r");
+
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+		if (!strncmp(line, field, strlen(field)) &&
+		    sscanf(line + strlen(field), ": %ld", &val) == 1)
+			break;
+	fclose(f);
+	return val;
+}
+
+static void drop_caches(void)
+{
+	int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+
+	sync();
+	if (fd < 0 || write(fd, "3\n", 2) != 2)
+		fprintf(stderr, "could not drop caches, results may be off\n");
+	if (fd >= 0)
+		close(fd);
+}
+
+static int make_file(const char *path, long mb)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	long i;
+
+	if (fd < 0) {
+		perror(path);
+		exit(1);
+	}
+	memset(buf, 0x5a, sizeof(buf));
+	for (i = 0; i < mb; i++) {
+		if (write(fd, buf, BUF_SIZE) != BUF_SIZE) {
+			perror(path);
+			exit(1);
+		}
+	}
+	fsync(fd);
+	return fd;
+}
+
+static void read_file(int fd)
+{
+	lseek(fd, 0, SEEK_SET);
+	while (read(fd, buf, BUF_SIZE) > 0)
+		;
+}
+
+/* percentage of the file's pages in the page cache */
+static double resident(int fd, long mb)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	long pages = (mb << 20) / page, i, in = 0;
+	unsigned char *vec = malloc(pages);
+	void *map;
+
+	map = mmap(NULL, pages * page, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED || !vec || mincore(map, pages * page, vec))
+		return -1;
+	for (i = 0; i < pages; i++)
+		in += vec[i] & 1;
+	munmap(map, pages * page);
+	free(vec);
+	return 100.0 * in / pages;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = ".";
+	char path_a[4096], path_b[4096];
+	long lock_mb = 0, a_mb = 0, b_mb = 0, avail_mb;
+	int passes = 8, opt, fa, fb, i;
+	struct stats s0, s1;
+	double t, res;
+
+	while ((opt = getopt(argc, argv, "d:l:a:b:p:")) != -1) {
+		switch (opt) {
+		case 'd': dir = optarg; break;
+		case 'l': lock_mb = atol(optarg); break;
+		case 'a': a_mb = atol(optarg); break;
+		case 'b': b_mb = atol(optarg); break;
+		case 'p': passes = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-d dir] [-l lock_MB] "
+				"[-a A_MB] [-b B_MB] [-p passes]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (lock_mb < 0 || a_mb < 0 || b_mb < 0 || passes <= 0)
+		return 1;
+
+	if (lock_mb) {
+		void *p = mmap(NULL, lock_mb << 20, PROT_READ | PROT_WRITE,
+			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (p == MAP_FAILED || mlock(p, lock_mb << 20)) {
+			perror("mlock");
+			return 1;
+		}
+	}
+
+	drop_caches();
+	avail_mb = (mem_kb("MemFree") + mem_kb("Cached")) >> 10;
+	if (!a_mb)
+		a_mb = avail_mb * 5 / 10;
+	if (!b_mb)
+		b_mb = avail_mb * 6 / 10;
+	if (a_mb <= 0 || b_mb <= 0)
+		return 1;
+
+	snprintf(path_a, sizeof(path_a), "%s/workingset_test.A", dir);
+	snprintf(path_b, sizeof(path_b), "%s/workingset_test.B", dir);
+	fa = make_file(path_a, a_mb);
+	fb = make_file(path_b, b_mb);
+	drop_caches();
+
+	printf("%ld MB available, A %ld MB, B %ld MB\n", avail_mb, a_mb, b_mb);
+	for (i = 0; i < 3; i++)
+		read_file(fa);
+	printf("A resident after 3 reads: %.0f%%\n", resident(fa, a_mb));
+
+	printf("%4s %10s %8s %10s %10s %8s\n", "pass", "B resident",
+	       "MB in", "refaults", "activates", "secs");
+	for (i = 1; i <= passes; i++) {
+		res = resident(fb, b_mb);
+		read_stats(&s0);
+		t = now();
+		read_file(fb);
+		t = now() - t;
+		read_stats(&s1);
+		printf("%4d %9.0f%% %8ld %10ld %10ld %8.2f\n", i, res,
+		       (s1.pgpgin - s0.pgpgin) >> 10, s1.refault - s0.refault,
+		       s1.activate - s0.activate, t);
+		fflush(stdout);
+	}
+	printf("A resident at the end: %.0f%%\n", resident(fa, a_mb));
+
+	close(fa);
+	close(fb);
+	unlink(path_a);
+	unlink(path_b);
+	return 0;
+}
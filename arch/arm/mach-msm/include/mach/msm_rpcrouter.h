@@ -18,6 +18,8 @@
 #ifndef __ASM__ARCH_MSM_RPCROUTER_H
 #define __ASM__ARCH_MSM_RPCROUTER_H
 
+#include <linux/kernel.h>
+#include <linux/stddef.h>
 #include <linux/types.h>
 #include <linux/list.h>
 #include <linux/platform_device.h>
@@ -193,6 +195,65 @@ int xdr_recv_int32(struct msm_rpc_xdr *xdr, int32_t *value);
 int xdr_recv_uint32(struct msm_rpc_xdr *xdr, uint32_t *value);
 int xdr_recv_bytes(struct msm_rpc_xdr *xdr, void **data, uint32_t *size);
 
+/*
+ * Table driven marshalling for structs made of 32 bit words.  Each
+ * field is a run of @count words at @offset in the C struct and the
+ * fields go on the wire in table order.  The encoded size is checked
+ * against the buffer once per struct, after which the words are
+ * byte swapped without further checks.
+ *
+ * XDR_FIELD() only takes uint32_t or int32_t members and arrays of
+ * them, anything else fails to build:
+ *
+ *	DEFINE_XDR_DESC(foo_desc,
+ *		XDR_FIELD(struct foo, handle),
+ *		XDR_FIELD(struct foo, words));
+ *
+ *	rc = xdr_recv_struct(xdr, &foo_desc, &foo);
+ */
+struct xdr_field {
+	uint16_t offset;
+	uint16_t count;
+};
+
+struct xdr_desc {
+	const struct xdr_field *fields;
+	uint32_t nr_fields;
+};
+
+#define __XDR_MEMBER(type, member)	(((type *)0)->member)
+#define __XDR_WORDS(type, member)					\
+	(sizeof(__XDR_MEMBER(type, member)) / sizeof(uint32_t))
+#define __XDR_IS_WORDS(type, member)					\
+	(__same_type(__XDR_MEMBER(type, member), uint32_t) ||		\
+	 __same_type(__XDR_MEMBER(type, member), int32_t) ||		\
+	 __same_type(__XDR_MEMBER(type, member),			\
+		     uint32_t[__XDR_WORDS(type, member)]) ||		\
+	 __same_type(__XDR_MEMBER(type, member),			\
+		     int32_t[__XDR_WORDS(type, member)]))
+
+#define XDR_FIELD(type, member) {					\
+	.offset = offsetof(type, member),				\
+	.count = __XDR_WORDS(type, member) +				\
+		 BUILD_BUG_ON_ZERO(!__XDR_IS_WORDS(type, member)),	\
+}
+
+#define DEFINE_XDR_DESC(name, ...)					\
+	static const struct xdr_field name##_fields[] = { __VA_ARGS__ };	\
+	static const struct xdr_desc name = {				\
+		.fields = name##_fields,				\
+		.nr_fields = ARRAY_SIZE(name##_fields),			\
+	}
+
+int xdr_send_uint32_array(struct msm_rpc_xdr *xdr, const uint32_t *values,
+			  uint32_t count);
+int xdr_recv_uint32_array(struct msm_rpc_xdr *xdr, uint32_t *values,
+			  uint32_t count);
+int xdr_send_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    const void *obj);
+int xdr_recv_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    void *obj);
+
 struct msm_rpc_server
 {
 	struct list_head list;
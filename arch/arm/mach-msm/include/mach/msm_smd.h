@@ -155,4 +155,83 @@ int smd_write_segment(smd_channel_t *ch, void *data, int len, int user_buf);
  */
 int smd_write_end(smd_channel_t *ch);
 
+/* A contiguous piece of a channel fifo.  The readable or writable part
+ * of a fifo wraps around its end at most once, so it is described by
+ * at most two segments.
+ */
+struct smd_fifo_seg {
+	void *data;
+	int len;
+};
+
+/* Exposes the data that can be read from the channel without copying
+ * it out of the fifo.  On packet channels only the rest of the current
+ * packet is exposed.  The data stays valid until smd_read_fifo_done().
+ *
+ * @ch: channel to read from
+ * @seg: array of two segments, filled in order
+ *
+ * Returns:
+ *      number of segments filled (0 - 2)
+ */
+int smd_read_fifo_segs(smd_channel_t *ch, struct smd_fifo_seg *seg);
+
+/* Consumes data exposed by smd_read_fifo_segs() and tells the other
+ * side about the room made.  Takes smd_lock on packet channels, so do
+ * not call from the notify callback.
+ *
+ * Returns:
+ *      number of bytes consumed
+ *      -EINVAL - more than was readable
+ */
+int smd_read_fifo_done(smd_channel_t *ch, int len);
+
+/* Exposes free fifo space to be filled in place.  On packet channels a
+ * transaction must have been started with smd_write_start() and only
+ * the rest of the packet is exposed.
+ *
+ * @ch: channel to write to
+ * @seg: array of two segments, filled in order
+ *
+ * Returns:
+ *      number of segments filled (0 - 2)
+ *      -ENOEXEC - transaction not started on a packet channel
+ */
+int smd_write_fifo_segs(smd_channel_t *ch, struct smd_fifo_seg *seg);
+
+/* Publishes @len bytes filled in through smd_write_fifo_segs() and
+ * tells the other side about them.  On packet channels this counts
+ * towards the transaction, which smd_write_end() still completes.
+ *
+ * Returns:
+ *      number of bytes written
+ *      -EINVAL - more than was writable
+ */
+int smd_write_fifo_done(smd_channel_t *ch, int len);
+
+/* Exposes fifo space for a whole @len byte packet, behind the room its
+ * header will take, without starting a transaction.  Nothing is visible
+ * to the other side until smd_write_pkt_done(); a packet that could not
+ * be filled is dropped by simply not calling it.
+ *
+ * @ch: packet channel to write to
+ * @len: payload length of the packet
+ * @seg: array of two segments, filled in order
+ *
+ * Returns:
+ *      number of segments filled (1 - 2)
+ *      -EACCES - non-packet channel
+ *      -EBUSY - a transaction is in progress
+ *      -EAGAIN - not enough space for the packet
+ */
+int smd_write_pkt_segs(smd_channel_t *ch, int len, struct smd_fifo_seg *seg);
+
+/* Writes the header of a packet filled in through smd_write_pkt_segs()
+ * and publishes header and payload together.
+ *
+ * Returns:
+ *      @len on success, or the errors of smd_write_pkt_segs()
+ */
+int smd_write_pkt_done(smd_channel_t *ch, int len);
+
 #endif
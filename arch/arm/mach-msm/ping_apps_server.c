@@ -27,6 +27,9 @@
 #include <linux/err.h>
 #include <linux/kthread.h>
 #include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
 #include <mach/msm_rpcrouter.h>
 
 /* ping server definitions */
@@ -44,6 +47,8 @@
 #define PING_APPS_REG_CB  2
 #define PING_APPS_DATA_CB 1
 
+#define PING_APPS_LATENCY_CALLS	1000
+
 static LIST_HEAD(cb_entry_list);
 static DEFINE_MUTEX(cb_entry_list_lock);
 
@@ -79,6 +84,13 @@ struct ping_apps_data_cb_reg_arg {
 	uint32_t num_tasks;
 };
 
+DEFINE_XDR_DESC(ping_apps_data_cb_reg_arg_desc,
+	XDR_FIELD(struct ping_apps_data_cb_reg_arg, cb_id),
+	XDR_FIELD(struct ping_apps_data_cb_reg_arg, num),
+	XDR_FIELD(struct ping_apps_data_cb_reg_arg, size),
+	XDR_FIELD(struct ping_apps_data_cb_reg_arg, interval_ms),
+	XDR_FIELD(struct ping_apps_data_cb_reg_arg, num_tasks));
+
 struct ping_apps_data_cb_unreg_arg {
 	uint32_t cb_id;
 };
@@ -471,11 +483,8 @@ static int handle_ping_apps_data_cb_reg(struct msm_rpc_server *server,
 
 	pr_info("%s: request received\n", __func__);
 
-	xdr_recv_uint32(xdr, &arg.cb_id);
-	xdr_recv_uint32(xdr, &arg.num);
-	xdr_recv_uint32(xdr, &arg.size);
-	xdr_recv_uint32(xdr, &arg.interval_ms);
-	xdr_recv_uint32(xdr, &arg.num_tasks);
+	if (xdr_recv_struct(xdr, &ping_apps_data_cb_reg_arg_desc, &arg))
+		return -EINVAL;
 
 	rc = ping_apps_data_cb_reg(&arg, &ret);
 	if (rc < 0)
@@ -580,7 +589,7 @@ static int handle_rpc_call(struct msm_rpc_server *server,
 {
 	switch (req->procedure) {
 	case PING_APPS_NULL:
-		pr_info("%s: null procedure request received\n", __func__);
+		pr_debug("%s: null procedure request received\n", __func__);
 		return 0;
 	case PING_APPS_DATA:
 		return handle_ping_apps_data_register(server, req, xdr);
@@ -597,10 +606,63 @@ static int handle_rpc_call(struct msm_rpc_server *server,
 	}
 }
 
+/*
+ * Round trip latency of null calls from an in-kernel client to this
+ * server.  With MSM_RPC_LOOPBACK_XPRT the calls stay on the apps side
+ * and go through the router like any remote call, without a modem.
+ */
+static ssize_t ping_apps_latency_read(struct file *fp, char __user *buf,
+				      size_t count, loff_t *pos)
+{
+	struct msm_rpc_client *client;
+	s64 lat, lat_min = LLONG_MAX, lat_max = 0, total = 0;
+	ktime_t start;
+	char _buf[96];
+	int i, len, rc = 0;
+
+	if (*pos)
+		return 0;
+
+	client = msm_rpc_register_client2("pingapps", PING_APPS_PROG,
+					  PING_APPS_VERS, 0, NULL);
+	if (IS_ERR(client))
+		return PTR_ERR(client);
+
+	for (i = 0; i < PING_APPS_LATENCY_CALLS; i++) {
+		start = ktime_get();
+		rc = msm_rpc_client_req2(client, PING_APPS_NULL,
+					 NULL, NULL, NULL, NULL, -1);
+		if (rc)
+			break;
+		lat = ktime_to_ns(ktime_sub(ktime_get(), start));
+		total += lat;
+		if (lat < lat_min)
+			lat_min = lat;
+		if (lat > lat_max)
+			lat_max = lat;
+	}
+	msm_rpc_unregister_client(client);
+	if (rc)
+		return rc;
+
+	len = scnprintf(_buf, sizeof(_buf),
+			"%d null calls: min %lld avg %lld max %lld ns\n",
+			PING_APPS_LATENCY_CALLS, lat_min,
+			div64_s64(total, PING_APPS_LATENCY_CALLS), lat_max);
+	return simple_read_from_buffer(buf, count, pos, _buf, len);
+}
+
+static const struct file_operations ping_apps_latency_ops = {
+	.owner = THIS_MODULE,
+	.read = ping_apps_latency_read,
+};
+
 static int __init ping_apps_server_init(void)
 {
 	INIT_LIST_HEAD(&cb_entry_list);
 	server_thread = ERR_PTR(-1);
+	debugfs_create_file("ping_apps_latency", 0400, 0, NULL,
+			    &ping_apps_latency_ops);
 	return msm_rpc_create_server2(&rpc_server);
 }
 
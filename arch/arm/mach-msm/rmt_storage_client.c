@@ -250,15 +250,15 @@ static int rmt_storage_validate_iovec(uint32_t handle,
 	return 0;
 }
 
+DEFINE_XDR_DESC(rmt_storage_send_sts_desc,
+	XDR_FIELD(struct rmt_storage_send_sts, handle),
+	XDR_FIELD(struct rmt_storage_send_sts, err_code),
+	XDR_FIELD(struct rmt_storage_send_sts, data));
+
 static int rmt_storage_send_sts_arg(struct msm_rpc_client *client,
 				struct msm_rpc_xdr *xdr, void *data)
 {
-	struct rmt_storage_send_sts *args = data;
-
-	xdr_send_uint32(xdr, &args->handle);
-	xdr_send_uint32(xdr, &args->err_code);
-	xdr_send_uint32(xdr, &args->data);
-	return 0;
+	return xdr_send_struct(xdr, &rmt_storage_send_sts_desc, data);
 }
 
 static void put_event(struct rmt_storage_client_info *rmc,
@@ -396,6 +396,12 @@ struct rmt_storage_event_params {
 	} params;
 };
 
+DEFINE_XDR_DESC(rmt_storage_rw_block_desc,
+	XDR_FIELD(struct rmt_storage_rw_block_args, handle),
+	XDR_FIELD(struct rmt_storage_rw_block_args, data_phy_addr),
+	XDR_FIELD(struct rmt_storage_rw_block_args, sector_addr),
+	XDR_FIELD(struct rmt_storage_rw_block_args, num_sector));
+
 static int rmt_storage_parse_params(struct msm_rpc_xdr *xdr,
 		struct rmt_storage_event_params *event)
 {
@@ -414,10 +420,8 @@ static int rmt_storage_parse_params(struct msm_rpc_xdr *xdr,
 		struct rmt_storage_rw_block_args *args;
 		args = &event->params.block;
 
-		xdr_recv_uint32(xdr, &args->handle);
-		xdr_recv_uint32(xdr, &args->data_phy_addr);
-		xdr_recv_uint32(xdr, &args->sector_addr);
-		xdr_recv_uint32(xdr, &args->num_sector);
+		if (xdr_recv_struct(xdr, &rmt_storage_rw_block_desc, args))
+			return -1;
 		break;
 	}
 
@@ -582,6 +586,28 @@ static int rmt_storage_event_user_data_cb(struct rmt_storage_event *event_args,
 	return RMT_STORAGE_NO_ERROR;
 }
 
+/*
+ * The iovec descriptors are plain runs of words in wire order, so the
+ * whole table is received and swapped in one go.
+ */
+static int rmt_storage_recv_iovecs(struct msm_rpc_xdr *xdr,
+				   struct rmt_storage_event *event_args,
+				   uint32_t ent)
+{
+	BUILD_BUG_ON(sizeof(struct rmt_storage_iovec_desc) !=
+		     3 * sizeof(uint32_t));
+
+	if (ent > RMT_STORAGE_MAX_IOVEC_XFR_CNT) {
+		pr_err("%s: too many iovecs %u\n", __func__, ent);
+		return -EINVAL;
+	}
+
+	return xdr_recv_uint32_array(xdr,
+			(uint32_t *)event_args->xfer_desc,
+			ent * sizeof(struct rmt_storage_iovec_desc) /
+			sizeof(uint32_t));
+}
+
 static int rmt_storage_event_write_iovec_cb(
 		struct rmt_storage_event *event_args,
 		struct msm_rpc_xdr *xdr)
@@ -605,12 +631,11 @@ static int rmt_storage_event_write_iovec_cb(
 	stats = &client_stats[event_args->handle - 1];
 	stats->wr_stats.start = ktime_get();
 #endif
+	if (rmt_storage_recv_iovecs(xdr, event_args, ent))
+		return -EINVAL;
+
 	for (i = 0; i < ent; i++) {
 		xfer = &event_args->xfer_desc[i];
-		xdr_recv_uint32(xdr, &xfer->sector_addr);
-		xdr_recv_uint32(xdr, &xfer->data_phy_addr);
-		xdr_recv_uint32(xdr, &xfer->num_sector);
-
 		if (rmt_storage_validate_iovec(event_args->handle, xfer))
 			return -EINVAL;
 
@@ -650,12 +675,11 @@ static int rmt_storage_event_read_iovec_cb(
 	stats = &client_stats[event_args->handle - 1];
 	stats->rd_stats.start = ktime_get();
 #endif
+	if (rmt_storage_recv_iovecs(xdr, event_args, ent))
+		return -EINVAL;
+
 	for (i = 0; i < ent; i++) {
 		xfer = &event_args->xfer_desc[i];
-		xdr_recv_uint32(xdr, &xfer->sector_addr);
-		xdr_recv_uint32(xdr, &xfer->data_phy_addr);
-		xdr_recv_uint32(xdr, &xfer->num_sector);
-
 		if (rmt_storage_validate_iovec(event_args->handle, xfer))
 			return -EINVAL;
 
@@ -31,6 +31,7 @@
 #include <linux/ctype.h>
 #include <linux/remote_spinlock.h>
 #include <linux/uaccess.h>
+#include <linux/hrtimer.h>
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
@@ -96,6 +97,11 @@ static int msm_smd_debug_mask;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* window in which fifo notifications of a busy channel are coalesced */
+static unsigned smd_coalesce_us = 100;
+module_param_named(coalesce_us, smd_coalesce_us,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
 #if defined(CONFIG_MSM_SMD_DEBUG)
 #define SMD_DBG(x...) do {				\
 		if (msm_smd_debug_mask & MSM_SMD_DEBUG) \
@@ -334,6 +340,17 @@ struct smd_channel {
 	int pending_pkt_sz;
 
 	char is_pkt_ch;
+
+	/* interrupt coalescing, see ch_notify_other_cpu() */
+	struct hrtimer notify_timer;
+	ktime_t last_notify;
+
+	/* statistics, exported through smd_get_ch_stats() */
+	unsigned long intr_in;
+	unsigned long intr_out;
+	unsigned long intr_coalesced;
+	unsigned long bytes_in;
+	unsigned long bytes_out;
 };
 
 static struct platform_device loopback_tty_pdev = {.name = "LOOPBACK_TTY"};
@@ -546,6 +563,7 @@ static void ch_read_done(struct smd_channel *ch, unsigned count)
 	BUG_ON(count > smd_stream_read_avail(ch));
 	ch->recv->tail = (ch->recv->tail + count) & ch->fifo_mask;
 	ch->send->fTAIL = 1;
+	ch->bytes_in += count;
 }
 
 /* basic read interface to ch_read_{buffer,done} used
@@ -639,6 +657,69 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	BUG_ON(count > smd_stream_write_avail(ch));
 	ch->send->head = (ch->send->head + count) & ch->fifo_mask;
 	ch->send->fHEAD = 1;
+	ch->bytes_out += count;
+}
+
+static enum hrtimer_restart ch_notify_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch =
+		container_of(timer, struct smd_channel, notify_timer);
+
+	ch->last_notify = ktime_get();
+	ch->intr_out++;
+	ch->notify_other_cpu();
+	return HRTIMER_NORESTART;
+}
+
+/* tell the other side about fifo updates, coalescing while busy
+ *
+ * An idle channel notifies right away, so request/response traffic
+ * keeps its latency.  Once a channel has sent an interrupt less than
+ * smd_coalesce_us ago, further notifications are folded into a single
+ * one sent when the coalescing timer expires.  Callers pass @urgent
+ * when the fifo fill level means the other side should not wait.
+ */
+static void ch_notify_other_cpu(struct smd_channel *ch, int urgent)
+{
+	unsigned delay = smd_coalesce_us;
+	ktime_t now = ktime_get();
+
+	if (!urgent && delay &&
+	    ktime_us_delta(now, ch->last_notify) < delay) {
+		ch->intr_coalesced++;
+		/* a running callback may already be past its notify */
+		if (!hrtimer_is_queued(&ch->notify_timer))
+			hrtimer_start(&ch->notify_timer,
+				      ktime_set(0, delay * NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		return;
+	}
+
+	hrtimer_try_to_cancel(&ch->notify_timer);
+	ch->last_notify = now;
+	ch->intr_out++;
+	ch->notify_other_cpu();
+}
+
+/* the fifo we write to is a quarter full, get the remote draining it */
+static int ch_write_urgent(struct smd_channel *ch)
+{
+	return smd_stream_write_avail(ch) < ch->fifo_size - ch->fifo_size / 4;
+}
+
+/* the fifo we read from is half full, the remote writer may be stalled */
+static int ch_read_urgent(struct smd_channel *ch)
+{
+	return smd_stream_read_avail(ch) >= ch->fifo_size / 2;
+}
+
+static void ch_init_coalescing(struct smd_channel *ch)
+{
+	hrtimer_init(&ch->notify_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->notify_timer.function = ch_notify_timer_fn;
+	/* a delayed notify may piggyback on a nearby wakeup */
+	hrtimer_set_slack(&ch->notify_timer,
+			  smd_coalesce_us * NSEC_PER_USEC / 2);
 }
 
 static void ch_set_state(struct smd_channel *ch, unsigned n)
@@ -760,6 +841,7 @@ static void handle_smd_irq(struct list_head *list, void (*notify)(void))
 			state_change = 1;
 		}
 		if (ch_flags) {
+			ch->intr_in++;
 			ch->update_state(ch);
 			ch->notify(ch->priv, SMD_EVENT_DATA);
 		}
@@ -883,8 +965,9 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 		return 0;
 }
 
-static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
-				int user_buf)
+/* basic write interface to ch_write_{buffer,done}, the caller notifies */
+static int ch_write(struct smd_channel *ch, const void *_data, int len,
+		    int user_buf)
 {
 	void *ptr;
 	const unsigned char *buf = _data;
@@ -892,12 +975,6 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	int orig_len = len;
 	int r = 0;
 
-	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
-	if (len < 0)
-		return -EINVAL;
-	else if (len == 0)
-		return 0;
-
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch))
 			break;
@@ -921,12 +998,27 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 			break;
 	}
 
-	if (orig_len - len)
-		ch->notify_other_cpu();
-
 	return orig_len - len;
 }
 
+static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
+				int user_buf)
+{
+	int r;
+
+	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
+	if (len < 0)
+		return -EINVAL;
+	else if (len == 0)
+		return 0;
+
+	r = ch_write(ch, _data, len, user_buf);
+	if (r)
+		ch_notify_other_cpu(ch, ch_write_urgent(ch));
+
+	return r;
+}
+
 static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 				int user_buf)
 {
@@ -945,16 +1037,18 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
-
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* header and payload go out with a single notification */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
+		if (ret)
+			ch_notify_other_cpu(ch, 1);
 		return -1;
 	}
 
-
-	ret = smd_stream_write(ch, _data, len, user_buf);
+	ret = ch_write(ch, _data, len, user_buf);
+	ch_notify_other_cpu(ch, ch_write_urgent(ch));
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
@@ -967,14 +1061,16 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 static int smd_stream_read(smd_channel_t *ch, void *data, int len, int user_buf)
 {
 	int r;
+	int urgent;
 
 	if (len < 0)
 		return -EINVAL;
 
+	urgent = ch_read_urgent(ch);
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+			ch_notify_other_cpu(ch, urgent);
 
 	return r;
 }
@@ -983,6 +1079,7 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 {
 	unsigned long flags;
 	int r;
+	int urgent;
 
 	if (len < 0)
 		return -EINVAL;
@@ -990,10 +1087,11 @@ static int smd_packet_read(smd_channel_t *ch, void *data, int len, int user_buf)
 	if (len > ch->current_packet)
 		len = ch->current_packet;
 
+	urgent = ch_read_urgent(ch);
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+			ch_notify_other_cpu(ch, urgent);
 
 	spin_lock_irqsave(&smd_lock, flags);
 	ch->current_packet -= r;
@@ -1007,6 +1105,7 @@ static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len,
 					int user_buf)
 {
 	int r;
+	int urgent;
 
 	if (len < 0)
 		return -EINVAL;
@@ -1014,10 +1113,11 @@ static int smd_packet_read_from_cb(smd_channel_t *ch, void *data, int len,
 	if (len > ch->current_packet)
 		len = ch->current_packet;
 
+	urgent = ch_read_urgent(ch);
 	r = ch_read(ch, data, len, user_buf);
 	if (r > 0)
 		if (!read_intr_blocked(ch))
-			ch->notify_other_cpu();
+			ch_notify_other_cpu(ch, urgent);
 
 	ch->current_packet -= r;
 	update_packet_state(ch);
@@ -1089,6 +1189,7 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm)
 
 	ch->fifo_mask = ch->fifo_size - 1;
 	ch->type = SMD_CHANNEL_TYPE(alloc_elm->type);
+	ch_init_coalescing(ch);
 
 	if (ch->type == SMD_APPS_MODEM)
 		ch->notify_other_cpu = notify_modem_smd;
@@ -1174,6 +1275,7 @@ static int smd_alloc_loopback_channel(void)
 	ch->fifo_mask = ch->fifo_size - 1;
 	ch->type = SMD_LOOPBACK_TYPE;
 	ch->notify_other_cpu = notify_loopback_smd;
+	ch_init_coalescing(ch);
 
 	ch->read = smd_stream_read;
 	ch->write = smd_stream_write;
@@ -1198,6 +1300,51 @@ static int smd_alloc_loopback_channel(void)
 	return 0;
 }
 
+/* nothing interrupts the loopback, pick up a new header on the way in */
+static int smd_loopback_packet_read_avail(struct smd_channel *ch)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	update_packet_state(ch);
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return smd_packet_read_avail(ch);
+}
+
+/*
+ * Switch the local loopback between stream and packet framing, so that
+ * the packet paths used by smd_pkt can be exercised without a remote
+ * processor.  Only for a client that holds the channel open, with an
+ * empty fifo, and whose notify callback does not read from it.
+ */
+int smd_loopback_set_packet(smd_channel_t *ch, int packet)
+{
+	if (ch->n != SMD_LOOPBACK_CID)
+		return -EINVAL;
+	if (smd_stream_read_avail(ch) || ch->pending_pkt_sz)
+		return -EBUSY;
+
+	ch->current_packet = 0;
+	ch->is_pkt_ch = packet;
+	if (packet) {
+		ch->read = smd_packet_read;
+		ch->write = smd_packet_write;
+		ch->read_avail = smd_loopback_packet_read_avail;
+		ch->write_avail = smd_packet_write_avail;
+		ch->update_state = update_packet_state;
+		ch->read_from_cb = smd_packet_read_from_cb;
+	} else {
+		ch->read = smd_stream_read;
+		ch->write = smd_stream_write;
+		ch->read_avail = smd_stream_read_avail;
+		ch->write_avail = smd_stream_write_avail;
+		ch->update_state = update_stream_state;
+		ch->read_from_cb = smd_stream_read;
+	}
+	return 0;
+}
+
 static void do_nothing_notify(void *priv, unsigned flags)
 {
 }
@@ -1319,6 +1466,9 @@ int smd_close(smd_channel_t *ch)
 
 	SMD_INFO("smd_close(%s)\n", ch->name);
 
+	/* the timer callback takes smd_lock for loopback channels */
+	hrtimer_cancel(&ch->notify_timer);
+
 	spin_lock_irqsave(&smd_lock, flags);
 	list_del(&ch->ch_list);
 	if (ch->n == SMD_LOOPBACK_CID) {
@@ -1379,7 +1529,8 @@ int smd_write_start(smd_channel_t *ch, int len)
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
 
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	/* the first segment notifies the other side */
+	ret = ch_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		ch->pending_pkt_sz = 0;
 		pr_err("%s: packet header failed to write\n", __func__);
@@ -1436,6 +1587,151 @@ int smd_write_end(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_write_end);
 
+/* split @avail bytes of a fifo starting at @start at the wrap point */
+static int ch_fifo_segs(unsigned char *fifo, unsigned fifo_size,
+			unsigned start, unsigned avail,
+			struct smd_fifo_seg *seg)
+{
+	if (avail == 0)
+		return 0;
+
+	seg[0].data = fifo + start;
+	seg[0].len = min(avail, fifo_size - start);
+	if (seg[0].len == avail)
+		return 1;
+
+	seg[1].data = fifo;
+	seg[1].len = avail - seg[0].len;
+	return 2;
+}
+
+int smd_read_fifo_segs(smd_channel_t *ch, struct smd_fifo_seg *seg)
+{
+	return ch_fifo_segs(ch->recv_data, ch->fifo_size, ch->recv->tail,
+			    ch->read_avail(ch), seg);
+}
+EXPORT_SYMBOL(smd_read_fifo_segs);
+
+int smd_read_fifo_done(smd_channel_t *ch, int len)
+{
+	unsigned long flags;
+	int urgent;
+
+	if (len < 0 || len > ch->read_avail(ch))
+		return -EINVAL;
+	if (len == 0)
+		return 0;
+
+	urgent = ch_read_urgent(ch);
+	ch_read_done(ch, len);
+	if (!read_intr_blocked(ch))
+		ch_notify_other_cpu(ch, urgent);
+
+	if (ch->is_pkt_ch) {
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->current_packet -= len;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+
+	return len;
+}
+EXPORT_SYMBOL(smd_read_fifo_done);
+
+/* how much of the free fifo space smd_write_fifo_segs() exposes */
+static int ch_fifo_write_avail(struct smd_channel *ch)
+{
+	int n;
+
+	if (!ch_is_open(ch))
+		return 0;
+
+	n = smd_stream_write_avail(ch);
+	if (ch->is_pkt_ch && n > ch->pending_pkt_sz)
+		n = ch->pending_pkt_sz;
+	return n;
+}
+
+int smd_write_fifo_segs(smd_channel_t *ch, struct smd_fifo_seg *seg)
+{
+	if (ch->is_pkt_ch && !ch->pending_pkt_sz)
+		return -ENOEXEC;
+
+	return ch_fifo_segs(ch->send_data, ch->fifo_size, ch->send->head,
+			    ch_fifo_write_avail(ch), seg);
+}
+EXPORT_SYMBOL(smd_write_fifo_segs);
+
+int smd_write_fifo_done(smd_channel_t *ch, int len)
+{
+	if (len < 0 || len > ch_fifo_write_avail(ch))
+		return -EINVAL;
+	if (len == 0)
+		return 0;
+
+	ch_write_done(ch, len);
+	if (ch->is_pkt_ch)
+		ch->pending_pkt_sz -= len;
+	ch_notify_other_cpu(ch, ch_write_urgent(ch));
+
+	return len;
+}
+EXPORT_SYMBOL(smd_write_fifo_done);
+
+static int ch_pkt_write_check(struct smd_channel *ch, int len)
+{
+	if (!ch->is_pkt_ch)
+		return -EACCES;
+	if (ch->pending_pkt_sz)
+		return -EBUSY;
+	if (len < 1 || !ch_is_open(ch) ||
+	    smd_stream_write_avail(ch) < SMD_HEADER_SIZE + len)
+		return -EAGAIN;
+	return 0;
+}
+
+int smd_write_pkt_segs(smd_channel_t *ch, int len, struct smd_fifo_seg *seg)
+{
+	int r;
+
+	r = ch_pkt_write_check(ch, len);
+	if (r)
+		return r;
+
+	return ch_fifo_segs(ch->send_data, ch->fifo_size,
+			    (ch->send->head + SMD_HEADER_SIZE) & ch->fifo_mask,
+			    len, seg);
+}
+EXPORT_SYMBOL(smd_write_pkt_segs);
+
+int smd_write_pkt_done(smd_channel_t *ch, int len)
+{
+	struct smd_fifo_seg seg[2];
+	unsigned hdr[5];
+	int r, n, i, done = 0;
+
+	r = ch_pkt_write_check(ch, len);
+	if (r)
+		return r;
+
+	hdr[0] = len;
+	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
+
+	/* the header may wrap around the end of the fifo as well */
+	n = ch_fifo_segs(ch->send_data, ch->fifo_size, ch->send->head,
+			 SMD_HEADER_SIZE, seg);
+	for (i = 0; i < n; i++) {
+		memcpy(seg[i].data, (char *)hdr + done, seg[i].len);
+		done += seg[i].len;
+	}
+
+	ch_write_done(ch, SMD_HEADER_SIZE + len);
+	ch_notify_other_cpu(ch, ch_write_urgent(ch));
+
+	return len;
+}
+EXPORT_SYMBOL(smd_write_pkt_done);
+
 int smd_read(smd_channel_t *ch, void *data, int len)
 {
 	return ch->read(ch, data, len, 0);
@@ -1545,6 +1841,46 @@ int smd_tiocmset(smd_channel_t *ch, unsigned int set, unsigned int clear)
 }
 EXPORT_SYMBOL(smd_tiocmset);
 
+static int smd_copy_ch_stats(struct list_head *list,
+			     struct smd_ch_stats *stats, int max)
+{
+	struct smd_channel *ch;
+	int n = 0;
+
+	list_for_each_entry(ch, list, ch_list) {
+		if (n == max)
+			break;
+		memcpy(stats[n].name, ch->name, sizeof(stats[n].name));
+		stats[n].n = ch->n;
+		stats[n].type = ch->type;
+		stats[n].intr_in = ch->intr_in;
+		stats[n].intr_out = ch->intr_out;
+		stats[n].intr_coalesced = ch->intr_coalesced;
+		stats[n].bytes_in = ch->bytes_in;
+		stats[n].bytes_out = ch->bytes_out;
+		n++;
+	}
+	return n;
+}
+
+/* snapshot the counters of up to @max open channels */
+int smd_get_ch_stats(struct smd_ch_stats *stats, int max)
+{
+	struct list_head *lists[] = {
+		&smd_ch_list_modem, &smd_ch_list_dsp, &smd_ch_list_dsps,
+		&smd_ch_list_wcnss, &smd_ch_list_loopback,
+	};
+	unsigned long flags;
+	int i, n = 0;
+
+	spin_lock_irqsave(&smd_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(lists); i++)
+		n += smd_copy_ch_stats(lists[i], stats + n, max - n);
+	spin_unlock_irqrestore(&smd_lock, flags);
+
+	return n;
+}
+
 
 /* -------------------------------------------------------------------------- */
 
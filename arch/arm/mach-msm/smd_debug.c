@@ -18,8 +18,11 @@
 #include <linux/debugfs.h>
 #include <linux/list.h>
 #include <linux/ctype.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
 
 #include <mach/msm_iomap.h>
+#include <mach/msm_smd.h>
 
 #include "smd_private.h"
 
@@ -321,6 +324,242 @@ static int debug_read_ch(char *buf, int max)
 		return debug_read_ch_v1(buf, max);
 }
 
+static int debug_read_ch_stats(char *buf, int max)
+{
+	struct smd_ch_stats *stats;
+	int n, count, i = 0;
+
+	stats = kmalloc(SMD_CHANNELS * sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return 0;
+
+	count = smd_get_ch_stats(stats, SMD_CHANNELS);
+	i += scnprintf(buf + i, max - i,
+		       "ch   name                 intr_in   intr_out"
+		       "  coalesced   bytes_in  bytes_out\n");
+	for (n = 0; n < count; n++)
+		i += scnprintf(buf + i, max - i,
+			       "%3d  %-19s %9lu %10lu %10lu %10lu %10lu\n",
+			       stats[n].n, stats[n].name,
+			       stats[n].intr_in, stats[n].intr_out,
+			       stats[n].intr_coalesced,
+			       stats[n].bytes_in, stats[n].bytes_out);
+
+	kfree(stats);
+	return i;
+}
+
+/* move the loopback channel counters to the front of a fresh snapshot */
+static int loopback_ch_stats(struct smd_ch_stats *stats)
+{
+	int count = smd_get_ch_stats(stats, SMD_CHANNELS);
+
+	while (count--)
+		if (stats[count].type == SMD_LOOPBACK_TYPE) {
+			stats[0] = stats[count];
+			return 0;
+		}
+	return -ENODEV;
+}
+
+#define LOOPBACK_BENCH_BYTES	(1024 * 1024)
+
+/*
+ * How a block goes through the loopback: copied or in place, on the
+ * stream channel, then with packet framing the way smd_pkt moves it
+ * before and after its conversion to the fifo segments.
+ */
+enum {
+	LOOPBACK_COPY,
+	LOOPBACK_SEGS,
+	LOOPBACK_PKT_COPY,
+	LOOPBACK_PKT_SEGS,
+	LOOPBACK_MODES,
+};
+
+static const char *loopback_mode_names[] = {
+	"copy", "segs", "pkt copy", "pkt segs",
+};
+
+/* the consumer reads every byte it gets, in place or from its copy */
+static u32 loopback_sum(const u8 *p, int len, u32 sum)
+{
+	while (len--)
+		sum += *p++;
+	return sum;
+}
+
+static u32 loopback_segs_sum(struct smd_fifo_seg *seg, int n, int len)
+{
+	u32 sum = 0;
+	int k, xfer;
+
+	for (k = 0; k < n && len; k++) {
+		xfer = min(seg[k].len, len);
+		sum = loopback_sum(seg[k].data, xfer, sum);
+		len -= xfer;
+	}
+	return sum;
+}
+
+/* fill the segments from @data, as smd_pkt does from the user buffer */
+static int loopback_segs_fill(struct smd_fifo_seg *seg, int n,
+			      const u8 *data, int len)
+{
+	int k, xfer, done = 0;
+
+	for (k = 0; k < n && done < len; k++) {
+		xfer = min(seg[k].len, len - done);
+		memcpy(seg[k].data, data + done, xfer);
+		done += xfer;
+	}
+	return done;
+}
+
+/* one block through the loopback fifo, @sum is what the reader saw */
+static int loopback_xfer(smd_channel_t *ch, u8 *data, int len, int mode,
+			 u32 *sum)
+{
+	struct smd_fifo_seg seg[2];
+	int n, k, done = 0;
+
+	switch (mode) {
+	case LOOPBACK_COPY:
+		if (smd_write(ch, data, len) != len ||
+		    smd_read(ch, data + len, len) != len)
+			return 0;
+		*sum = loopback_sum(data + len, len, 0);
+		return 1;
+
+	case LOOPBACK_SEGS:
+		n = smd_write_fifo_segs(ch, seg);
+		if (loopback_segs_fill(seg, n, data, len) != len ||
+		    smd_write_fifo_done(ch, len) != len)
+			return 0;
+		/* a zero-copy consumer works on the segments themselves */
+		n = smd_read_fifo_segs(ch, seg);
+		*sum = loopback_segs_sum(seg, n, len);
+		return smd_read_fifo_done(ch, len) == len;
+
+	case LOOPBACK_PKT_COPY:
+		if (smd_write(ch, data, len) != len ||
+		    smd_read_avail(ch) != len || smd_cur_packet_size(ch) != len ||
+		    smd_read(ch, data + len, len) != len)
+			return 0;
+		*sum = loopback_sum(data + len, len, 0);
+		return 1;
+
+	case LOOPBACK_PKT_SEGS:
+		n = smd_write_pkt_segs(ch, len, seg);
+		if (n < 0 || loopback_segs_fill(seg, n, data, len) != len ||
+		    smd_write_pkt_done(ch, len) != len ||
+		    smd_read_avail(ch) != len || smd_cur_packet_size(ch) != len)
+			return 0;
+		/* smd_pkt copies the packet out of the segments to the reader */
+		n = smd_read_fifo_segs(ch, seg);
+		for (k = 0; k < n && done < len; k++) {
+			int xfer = min(seg[k].len, len - done);
+
+			memcpy(data + len + done, seg[k].data, xfer);
+			done += xfer;
+		}
+		if (done != len || smd_read_fifo_done(ch, len) != len)
+			return 0;
+		*sum = loopback_sum(data + len, len, 0);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Throughput, latency and cpu cost of the local loopback channel, which
+ * needs no remote processor.  Each iteration writes a block and reads
+ * it back, and the reader checksums every byte it gets: copied with
+ * smd_write()/smd_read() or in place through the fifo segments on the
+ * stream channel, then with packet framing through the copying calls
+ * and through the calls smd_pkt uses.  Latency is measured from the
+ * write to the end of the checksum, and as the loop never sleeps the
+ * total time is the cpu time spent per megabyte.
+ */
+static int debug_loopback_bench(char *buf, int max)
+{
+	static const int sizes[] = { 64, 512, 2048 };
+	struct smd_ch_stats *stats, before;
+	smd_channel_t *ch;
+	u8 *data;
+	int s, n, i = 0;
+
+	stats = kmalloc(SMD_CHANNELS * sizeof(*stats), GFP_KERNEL);
+	data = kmalloc(2 * sizes[ARRAY_SIZE(sizes) - 1], GFP_KERNEL);
+	if (!stats || !data)
+		goto out;
+	for (s = 0; s < sizes[ARRAY_SIZE(sizes) - 1]; s++)
+		data[s] = s * 7;
+
+	if (smd_named_open_on_edge("local_loopback", SMD_LOOPBACK_TYPE,
+				   &ch, NULL, NULL)) {
+		i += scnprintf(buf + i, max - i, "local_loopback busy\n");
+		goto out;
+	}
+
+	for (s = 0; s < LOOPBACK_MODES * ARRAY_SIZE(sizes); s++) {
+		int len = sizes[s % ARRAY_SIZE(sizes)];
+		int mode = s / ARRAY_SIZE(sizes);
+		int iter = LOOPBACK_BENCH_BYTES / len;
+		u32 sum = 0, expect = loopback_sum(data, len, 0);
+		s64 lat, lat_max = 0, total = 0;
+		ktime_t start;
+		int k;
+
+		if (smd_loopback_set_packet(ch, mode >= LOOPBACK_PKT_COPY) ||
+		    loopback_ch_stats(stats))
+			break;
+		before = stats[0];
+
+		for (k = 0; k < iter; k++) {
+			start = ktime_get();
+			if (!loopback_xfer(ch, data, len, mode, &sum))
+				break;
+			lat = ktime_to_ns(ktime_sub(ktime_get(), start));
+			if (sum != expect)
+				break;
+			total += lat;
+			if (lat > lat_max)
+				lat_max = lat;
+		}
+		if (k != iter) {
+			i += scnprintf(buf + i, max - i,
+				       "%5d bytes %-8s: transfer failed\n", len,
+				       loopback_mode_names[mode]);
+			break;
+		}
+
+		loopback_ch_stats(stats);
+		i += scnprintf(buf + i, max - i,
+			       "%5d bytes %-8s: %7lld KB/s cpu %6lld us/MB"
+			       " lat avg %6lld ns max %7lld ns"
+			       " intr %lu coalesced %lu\n",
+			       len, loopback_mode_names[mode],
+			       div64_s64((s64)iter * len * 1000000,
+					 total ? total : 1) * 1000 / 1024,
+			       div64_s64(total, 1000),
+			       div64_s64(total, iter), lat_max,
+			       stats[0].intr_out - before.intr_out,
+			       stats[0].intr_coalesced -
+			       before.intr_coalesced);
+	}
+
+	/* leave the loopback empty and as a stream for smd_tty */
+	while ((n = smd_read_avail(ch)) > 0)
+		smd_read(ch, NULL, n);
+	smd_loopback_set_packet(ch, 0);
+	smd_close(ch);
+out:
+	kfree(data);
+	kfree(stats);
+	return i;
+}
+
 static int debug_read_smem_version(char *buf, int max)
 {
 	struct smem_shared *shared = (void *) MSM_SHARED_RAM_BASE;
@@ -472,6 +711,8 @@ static int __init smd_debugfs_init(void)
 		return PTR_ERR(dent);
 
 	debug_create("ch", 0444, dent, debug_read_ch);
+	debug_create("ch_stats", 0444, dent, debug_read_ch_stats);
+	debug_create("loopback_bench", 0400, dent, debug_loopback_bench);
 	debug_create("diag", 0444, dent, debug_read_diag_msg);
 	debug_create("mem", 0444, dent, debug_read_mem);
 	debug_create("version", 0444, dent, debug_read_smd_version);
@@ -205,6 +205,46 @@ int smd_pkt_ioctl(struct inode *inode,
 	return ret;
 }
 
+/* copy the current packet straight out of the fifo segments */
+static int smd_pkt_copy_to_user(struct smd_channel *ch,
+				char __user *buf, int len)
+{
+	struct smd_fifo_seg seg[2];
+	int n, i, copied = 0;
+
+	n = smd_read_fifo_segs(ch, seg);
+	for (i = 0; i < n && copied < len; i++) {
+		int xfer = min(seg[i].len, len - copied);
+
+		if (copy_to_user(buf + copied, seg[i].data, xfer))
+			return -EFAULT;
+		copied += xfer;
+	}
+
+	return smd_read_fifo_done(ch, copied);
+}
+
+/* fill a packet in place from the user buffer, then send it whole */
+static int smd_pkt_copy_from_user(struct smd_channel *ch,
+				  const char __user *buf, int len)
+{
+	struct smd_fifo_seg seg[2];
+	int n, i, copied = 0;
+
+	n = smd_write_pkt_segs(ch, len, seg);
+	if (n < 0)
+		return n;
+
+	/* nothing is published yet, a faulting packet is just dropped */
+	for (i = 0; i < n; i++) {
+		if (copy_from_user(seg[i].data, buf + copied, seg[i].len))
+			return -EFAULT;
+		copied += seg[i].len;
+	}
+
+	return smd_write_pkt_done(ch, len);
+}
+
 ssize_t smd_pkt_read(struct file *file,
 		       char __user *buf,
 		       size_t count,
@@ -277,7 +317,7 @@ wait_for_packet:
 		return -EINVAL;
 	}
 
-	if (smd_read_user_buffer(smd_pkt_devp->ch, buf, bytes_read)
+	if (smd_pkt_copy_to_user(smd_pkt_devp->ch, buf, bytes_read)
 	    != bytes_read) {
 		mutex_unlock(&smd_pkt_devp->rx_lock);
 		if (smd_pkt_devp->has_reset)
@@ -378,8 +418,8 @@ ssize_t smd_pkt_write(struct file *file,
 
 	smd_pkt_devp->needed_space = 0;
 
-	r = smd_write_user_buffer(smd_pkt_devp->ch, buf, count);
-	if (r != count) {
+	r = smd_pkt_copy_from_user(smd_pkt_devp->ch, buf, count);
+	if (r < 0) {
 		mutex_unlock(&smd_pkt_devp->tx_lock);
 		if (smd_pkt_devp->has_reset)
 			return notify_reset(smd_pkt_devp);
@@ -172,6 +172,22 @@ void smsm_reset_modem(unsigned mode);
 void smsm_reset_modem_cont(void);
 void smd_sleep_exit(void);
 
+struct smd_ch_stats {
+	char name[20];
+	unsigned n;
+	unsigned type;
+	unsigned long intr_in;
+	unsigned long intr_out;
+	unsigned long intr_coalesced;
+	unsigned long bytes_in;
+	unsigned long bytes_out;
+};
+
+int smd_get_ch_stats(struct smd_ch_stats *stats, int max);
+
+struct smd_channel;
+int smd_loopback_set_packet(struct smd_channel *ch, int packet);
+
 #define SMEM_NUM_SMD_STREAM_CHANNELS        64
 #define SMEM_NUM_SMD_BLOCK_CHANNELS         64
 
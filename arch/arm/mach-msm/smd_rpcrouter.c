@@ -18,7 +18,6 @@
 /* TODO: handle cases where smd_write() will tempfail due to full fifo */
 /* TODO: thread priority? schedule a work to bump it? */
 /* TODO: maybe make server_list_lock a mutex */
-/* TODO: pool fragments to avoid kmalloc/kfree churn */
 
 #include <linux/slab.h>
 #include <linux/module.h>
@@ -40,6 +39,10 @@
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/rculist.h>
+#include <linux/ktime.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
 
 #include <asm/byteorder.h>
 
@@ -146,6 +149,63 @@ static DEFINE_SPINLOCK(local_endpoints_lock);
 static DEFINE_SPINLOCK(remote_endpoints_lock);
 static DEFINE_SPINLOCK(server_list_lock);
 
+/*
+ * Endpoints and servers are also hashed for the lookups done on every
+ * packet.  The tables are changed under the lock of the matching list
+ * and read under RCU, so routing does not contend with endpoints being
+ * created; objects are freed from RCU callbacks once unhashed.
+ * Servers hash on the program alone, so that version compatible
+ * lookups hit a single bucket too.
+ *
+ * Local endpoints and servers found by a lookup may only be used until
+ * the caller's rcu_read_unlock().  Remote endpoints are also used by
+ * writers sleeping for tx quota, so their lookup takes a reference.
+ */
+#define RR_HASH_BITS	7
+#define RR_HASH_SIZE	(1 << RR_HASH_BITS)
+
+static struct hlist_head local_endpoints_hash[RR_HASH_SIZE];
+static struct hlist_head remote_endpoints_hash[RR_HASH_SIZE];
+static struct hlist_head server_hash[RR_HASH_SIZE];
+
+static inline struct hlist_head *local_endpoint_bucket(uint32_t cid)
+{
+	return &local_endpoints_hash[hash_32(cid, RR_HASH_BITS)];
+}
+
+static inline struct hlist_head *remote_endpoint_bucket(uint32_t pid,
+							 uint32_t cid)
+{
+	return &remote_endpoints_hash[jhash_2words(pid, cid, 0) &
+				      (RR_HASH_SIZE - 1)];
+}
+
+static inline struct hlist_head *server_bucket(uint32_t prog)
+{
+	return &server_hash[hash_32(prog, RR_HASH_BITS)];
+}
+
+static void rr_free_server_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct rr_server, rcu));
+}
+
+static void rr_free_local_endpoint_rcu(struct rcu_head *head)
+{
+	struct msm_rpc_endpoint *ept =
+		container_of(head, struct msm_rpc_endpoint, rcu);
+
+	/* do_read_data() may take the read wakelock until now */
+	wake_lock_destroy(&ept->read_q_wake_lock);
+	wake_lock_destroy(&ept->reply_q_wake_lock);
+	kfree(ept);
+}
+
+static void rr_free_remote_endpoint_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct rr_remote_endpoint, rcu));
+}
+
 static LIST_HEAD(rpc_board_dev_list);
 static DEFINE_SPINLOCK(rpc_board_dev_list_lock);
 
@@ -157,6 +217,7 @@ static atomic_t pm_mid = ATOMIC_INIT(1);
 static void do_read_data(struct work_struct *work);
 static void do_create_pdevs(struct work_struct *work);
 static void do_create_rpcrouter_pdev(struct work_struct *work);
+static void rr_free_packet(struct rr_packet *pkt);
 
 static DECLARE_WORK(work_create_pdevs, do_create_pdevs);
 static DECLARE_WORK(work_create_rpcrouter_pdev, do_create_rpcrouter_pdev);
@@ -340,10 +401,10 @@ static void modem_reset_cleanup(void)
 				frag = pkt->first;
 				while (frag != NULL) {
 					next = frag->next;
-					kfree(frag);
+					msm_rpcrouter_free_fragment(frag);
 					frag = next;
 				}
-			kfree(pkt);
+				rr_free_packet(pkt);
 			}
 			spin_unlock(&ept->incomplete_lock);
 			/* remove all completed packets waiting to be read*/
@@ -354,10 +415,10 @@ static void modem_reset_cleanup(void)
 				frag = pkt->first;
 				while (frag != NULL) {
 					next = frag->next;
-					kfree(frag);
+					msm_rpcrouter_free_fragment(frag);
 					frag = next;
 				}
-				kfree(pkt);
+				rr_free_packet(pkt);
 			}
 			spin_unlock(&ept->read_q_lock);
 
@@ -421,6 +482,7 @@ static struct rr_server *rpcrouter_create_server(uint32_t pid,
 
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_add_tail(&server->list, &server_list);
+	hlist_add_head_rcu(&server->hash, server_bucket(prog));
 	spin_unlock_irqrestore(&server_list_lock, flags);
 
 	rc = msm_rpcrouter_create_server_cdev(server);
@@ -431,22 +493,12 @@ static struct rr_server *rpcrouter_create_server(uint32_t pid,
 out_fail:
 	spin_lock_irqsave(&server_list_lock, flags);
 	list_del(&server->list);
+	hlist_del_rcu(&server->hash);
 	spin_unlock_irqrestore(&server_list_lock, flags);
-	kfree(server);
+	call_rcu(&server->rcu, rr_free_server_rcu);
 	return ERR_PTR(rc);
 }
 
-static void rpcrouter_destroy_server(struct rr_server *server)
-{
-	unsigned long flags;
-
-	spin_lock_irqsave(&server_list_lock, flags);
-	list_del(&server->list);
-	spin_unlock_irqrestore(&server_list_lock, flags);
-	device_destroy(msm_rpcrouter_class, server->device_number);
-	kfree(server);
-}
-
 int msm_rpc_add_board_dev(struct rpc_board_dev *devices, int num)
 {
 	unsigned long flags;
@@ -493,23 +545,44 @@ static void rpcrouter_register_board_dev(struct rr_server *server)
 	spin_unlock_irqrestore(&rpc_board_dev_list_lock, flags);
 }
 
+/* Called under rcu_read_lock() */
 static struct rr_server *rpcrouter_lookup_server(uint32_t prog, uint32_t ver)
 {
 	struct rr_server *server;
-	unsigned long flags;
+	struct hlist_node *n;
 
-	spin_lock_irqsave(&server_list_lock, flags);
-	list_for_each_entry(server, &server_list, list) {
+	hlist_for_each_entry_rcu(server, n, server_bucket(prog), hash) {
 		if (server->prog == prog
-		 && server->vers == ver) {
-			spin_unlock_irqrestore(&server_list_lock, flags);
+		 && server->vers == ver)
 			return server;
-		}
 	}
-	spin_unlock_irqrestore(&server_list_lock, flags);
 	return NULL;
 }
 
+static int rpcrouter_remove_server(uint32_t prog, uint32_t ver)
+{
+	struct rr_server *server;
+	unsigned long flags;
+
+	/* the list lock keeps anybody else from freeing it */
+	spin_lock_irqsave(&server_list_lock, flags);
+	rcu_read_lock();
+	server = rpcrouter_lookup_server(prog, ver);
+	rcu_read_unlock();
+	if (server) {
+		list_del(&server->list);
+		hlist_del_rcu(&server->hash);
+	}
+	spin_unlock_irqrestore(&server_list_lock, flags);
+
+	if (!server)
+		return -ENOENT;
+
+	device_destroy(msm_rpcrouter_class, server->device_number);
+	call_rcu(&server->rcu, rr_free_server_rcu);
+	return 0;
+}
+
 static struct rr_server *rpcrouter_lookup_server_by_dev(dev_t dev)
 {
 	struct rr_server *server;
@@ -575,6 +648,7 @@ struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev)
 
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_add_tail(&ept->list, &local_endpoints);
+	hlist_add_head_rcu(&ept->hash, local_endpoint_bucket(ept->cid));
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	return ept;
 }
@@ -619,12 +693,11 @@ int msm_rpcrouter_destroy_local_endpoint(struct msm_rpc_endpoint *ept)
 	}
 	spin_unlock_irqrestore(&ept->reply_q_lock, flags);
 
-	wake_lock_destroy(&ept->read_q_wake_lock);
-	wake_lock_destroy(&ept->reply_q_wake_lock);
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_del(&ept->list);
+	hlist_del_rcu(&ept->hash);
 	spin_unlock_irqrestore(&local_endpoints_lock, flags);
-	kfree(ept);
+	call_rcu(&ept->rcu, rr_free_local_endpoint_rcu);
 	return 0;
 }
 
@@ -643,44 +716,82 @@ static int rpcrouter_create_remote_endpoint(uint32_t pid, uint32_t cid)
 	init_waitqueue_head(&new_c->quota_wait);
 	spin_lock_init(&new_c->quota_lock);
 
+	new_c->quota_restart_state = RESTART_NORMAL;
+	atomic_set(&new_c->refcount, 1);
+
 	spin_lock_irqsave(&remote_endpoints_lock, flags);
 	list_add_tail(&new_c->list, &remote_endpoints);
-	new_c->quota_restart_state = RESTART_NORMAL;
+	hlist_add_head_rcu(&new_c->hash, remote_endpoint_bucket(pid, cid));
 	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
 	return 0;
 }
 
+/* Called under rcu_read_lock() */
 static struct msm_rpc_endpoint *rpcrouter_lookup_local_endpoint(uint32_t cid)
 {
 	struct msm_rpc_endpoint *ept;
-	unsigned long flags;
+	struct hlist_node *n;
 
-	spin_lock_irqsave(&local_endpoints_lock, flags);
-	list_for_each_entry(ept, &local_endpoints, list) {
-		if (ept->cid == cid) {
-			spin_unlock_irqrestore(&local_endpoints_lock, flags);
+	hlist_for_each_entry_rcu(ept, n, local_endpoint_bucket(cid), hash) {
+		if (ept->cid == cid)
 			return ept;
-		}
 	}
-	spin_unlock_irqrestore(&local_endpoints_lock, flags);
 	return NULL;
 }
 
-static struct rr_remote_endpoint *rpcrouter_lookup_remote_endpoint(uint32_t pid,
-								   uint32_t cid)
+/* Called under rcu_read_lock() */
+static struct rr_remote_endpoint *
+__rpcrouter_lookup_remote_endpoint(uint32_t pid, uint32_t cid)
+{
+	struct rr_remote_endpoint *ept;
+	struct hlist_node *n;
+
+	hlist_for_each_entry_rcu(ept, n, remote_endpoint_bucket(pid, cid),
+				 hash) {
+		if ((ept->pid == pid) && (ept->cid == cid))
+			return ept;
+	}
+	return NULL;
+}
+
+/* Returns the endpoint with a reference held, drop it with put */
+static struct rr_remote_endpoint *rpcrouter_get_remote_endpoint(uint32_t pid,
+								uint32_t cid)
+{
+	struct rr_remote_endpoint *ept;
+
+	rcu_read_lock();
+	ept = __rpcrouter_lookup_remote_endpoint(pid, cid);
+	if (ept && !atomic_inc_not_zero(&ept->refcount))
+		ept = NULL;
+	rcu_read_unlock();
+	return ept;
+}
+
+static void rpcrouter_put_remote_endpoint(struct rr_remote_endpoint *ept)
+{
+	if (atomic_dec_and_test(&ept->refcount))
+		call_rcu(&ept->rcu, rr_free_remote_endpoint_rcu);
+}
+
+static void rpcrouter_destroy_remote_endpoint(uint32_t pid, uint32_t cid)
 {
 	struct rr_remote_endpoint *ept;
 	unsigned long flags;
 
 	spin_lock_irqsave(&remote_endpoints_lock, flags);
-	list_for_each_entry(ept, &remote_endpoints, list) {
-		if ((ept->pid == pid) && (ept->cid == cid)) {
-			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
-			return ept;
-		}
+	rcu_read_lock();
+	ept = __rpcrouter_lookup_remote_endpoint(pid, cid);
+	rcu_read_unlock();
+	if (ept) {
+		list_del(&ept->list);
+		hlist_del_rcu(&ept->hash);
 	}
 	spin_unlock_irqrestore(&remote_endpoints_lock, flags);
-	return NULL;
+
+	/* writers waiting for quota keep it until they are done */
+	if (ept)
+		rpcrouter_put_remote_endpoint(ept);
 }
 
 static void handle_server_restart(struct rr_server *server,
@@ -690,7 +801,7 @@ static void handle_server_restart(struct rr_server *server,
 	struct rr_remote_endpoint *r_ept;
 	struct msm_rpc_endpoint *ept;
 	unsigned long flags;
-	r_ept = rpcrouter_lookup_remote_endpoint(pid, cid);
+	r_ept = rpcrouter_get_remote_endpoint(pid, cid);
 	if (r_ept && (r_ept->quota_restart_state !=
 		      RESTART_NORMAL)) {
 		spin_lock_irqsave(&r_ept->quota_lock, flags);
@@ -702,6 +813,8 @@ static void handle_server_restart(struct rr_server *server,
 			   (unsigned int)r_ept);
 		wake_up(&r_ept->quota_wait);
 	}
+	if (r_ept)
+		rpcrouter_put_remote_endpoint(r_ept);
 	spin_lock_irqsave(&local_endpoints_lock, flags);
 	list_for_each_entry(ept, &local_endpoints, list) {
 		if ((be32_to_cpu(ept->dst_prog) == prog) &&
@@ -775,8 +888,8 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 	case RPCROUTER_CTRL_CMD_RESUME_TX:
 		RR("o RESUME_TX id=%d:%08x\n", msg->cli.pid, msg->cli.cid);
 
-		r_ept = rpcrouter_lookup_remote_endpoint(msg->cli.pid,
-							 msg->cli.cid);
+		r_ept = rpcrouter_get_remote_endpoint(msg->cli.pid,
+						      msg->cli.cid);
 		if (!r_ept) {
 			printk(KERN_ERR
 			       "rpcrouter: Unable to resume client\n");
@@ -786,6 +899,7 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 		r_ept->tx_quota_cntr = 0;
 		spin_unlock_irqrestore(&r_ept->quota_lock, flags);
 		wake_up(&r_ept->quota_wait);
+		rpcrouter_put_remote_endpoint(r_ept);
 		break;
 
 	case RPCROUTER_CTRL_CMD_NEW_SERVER:
@@ -799,7 +913,22 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 		RR("o NEW_SERVER id=%d:%08x prog=%08x:%08x\n",
 		   msg->srv.pid, msg->srv.cid, msg->srv.prog, msg->srv.vers);
 
+		rcu_read_lock();
 		server = rpcrouter_lookup_server(msg->srv.prog, msg->srv.vers);
+		if (server) {
+			if ((server->pid == msg->srv.pid) &&
+			    (server->cid == msg->srv.cid)) {
+				handle_server_restart(server,
+						      msg->srv.pid,
+						      msg->srv.cid,
+						      msg->srv.prog,
+						      msg->srv.vers);
+			} else {
+				server->pid = msg->srv.pid;
+				server->cid = msg->srv.cid;
+			}
+		}
+		rcu_read_unlock();
 
 		if (!server) {
 			server = rpcrouter_create_server(
@@ -812,8 +941,11 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 			 * client to our remote client list
 			 * if we get a NEW_SERVER notification
 			 */
-			if (!rpcrouter_lookup_remote_endpoint(msg->srv.pid,
-							      msg->srv.cid)) {
+			r_ept = rpcrouter_get_remote_endpoint(msg->srv.pid,
+							      msg->srv.cid);
+			if (r_ept) {
+				rpcrouter_put_remote_endpoint(r_ept);
+			} else {
 				rc = rpcrouter_create_remote_endpoint(
 					msg->srv.pid, msg->srv.cid);
 				if (rc < 0)
@@ -824,27 +956,13 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 			rpcrouter_register_board_dev(server);
 			schedule_work(&work_create_pdevs);
 			wake_up(&newserver_wait);
-		} else {
-			if ((server->pid == msg->srv.pid) &&
-			    (server->cid == msg->srv.cid)) {
-				handle_server_restart(server,
-						      msg->srv.pid,
-						      msg->srv.cid,
-						      msg->srv.prog,
-						      msg->srv.vers);
-			} else {
-				server->pid = msg->srv.pid;
-				server->cid = msg->srv.cid;
-			}
 		}
 		break;
 
 	case RPCROUTER_CTRL_CMD_REMOVE_SERVER:
 		RR("o REMOVE_SERVER prog=%08x:%d\n",
 		   msg->srv.prog, msg->srv.vers);
-		server = rpcrouter_lookup_server(msg->srv.prog, msg->srv.vers);
-		if (server)
-			rpcrouter_destroy_server(server);
+		rpcrouter_remove_server(msg->srv.prog, msg->srv.vers);
 		break;
 
 	case RPCROUTER_CTRL_CMD_REMOVE_CLIENT:
@@ -855,14 +973,7 @@ static int process_control_msg(struct rpcrouter_xprt_info *xprt_info,
 			       "local client\n");
 			break;
 		}
-		r_ept = rpcrouter_lookup_remote_endpoint(msg->cli.pid,
-							 msg->cli.cid);
-		if (r_ept) {
-			spin_lock_irqsave(&remote_endpoints_lock, flags);
-			list_del(&r_ept->list);
-			spin_unlock_irqrestore(&remote_endpoints_lock, flags);
-			kfree(r_ept);
-		}
+		rpcrouter_destroy_remote_endpoint(msg->cli.pid, msg->cli.cid);
 
 		/* Notify local clients of this event */
 		printk(KERN_ERR "rpcrouter: LOCAL NOTIFICATION NOT IMP\n");
@@ -914,17 +1025,134 @@ static void do_create_pdevs(struct work_struct *work)
 static void *rr_malloc(unsigned sz)
 {
 	void *ptr = kmalloc(sz, GFP_KERNEL);
-	if (ptr)
-		return ptr;
-
-	printk(KERN_ERR "rpcrouter: kmalloc of %d failed, retrying...\n", sz);
-	do {
-		ptr = kmalloc(sz, GFP_KERNEL);
-	} while (!ptr);
+	if (!ptr)
+		printk(KERN_ERR "rpcrouter: kmalloc of %d failed\n", sz);
 
 	return ptr;
 }
 
+/* fragments and packets kept per transport for reuse across reads */
+#define RR_POOL_FRAGS	32
+#define RR_POOL_PKTS	16
+
+static void rr_pool_init(struct rr_pool *pool)
+{
+	struct rr_fragment *frag;
+	struct rr_packet *pkt;
+
+	if (pool->initialized)
+		return;
+
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->pkts);
+
+	while (pool->nr_frags < RR_POOL_FRAGS) {
+		frag = kmalloc(sizeof(*frag), GFP_KERNEL);
+		if (!frag)
+			break;
+		frag->pool = pool;
+		frag->next = pool->frags;
+		pool->frags = frag;
+		pool->nr_frags++;
+	}
+
+	while (pool->nr_pkts < RR_POOL_PKTS) {
+		pkt = kmalloc(sizeof(*pkt), GFP_KERNEL);
+		if (!pkt)
+			break;
+		pkt->pool = pool;
+		list_add(&pkt->list, &pool->pkts);
+		pool->nr_pkts++;
+	}
+
+	pool->initialized = 1;
+}
+
+static struct rr_fragment *rr_alloc_fragment(struct rr_pool *pool)
+{
+	struct rr_fragment *frag;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	frag = pool->frags;
+	if (frag) {
+		pool->frags = frag->next;
+		pool->nr_frags--;
+		pool->frag_hits++;
+	} else {
+		pool->frag_fallbacks++;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (!frag) {
+		frag = rr_malloc(sizeof(*frag));
+		if (!frag)
+			return NULL;
+		frag->pool = pool;
+	}
+	frag->next = NULL;
+	return frag;
+}
+
+/* Fragments never leave the router, readers get a copy of the data */
+void msm_rpcrouter_free_fragment(struct rr_fragment *frag)
+{
+	struct rr_pool *pool = frag->pool;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pool->nr_frags < RR_POOL_FRAGS) {
+		frag->next = pool->frags;
+		pool->frags = frag;
+		pool->nr_frags++;
+		frag = NULL;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	kfree(frag);
+}
+
+static struct rr_packet *rr_alloc_packet(struct rr_pool *pool)
+{
+	struct rr_packet *pkt = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (!list_empty(&pool->pkts)) {
+		pkt = list_first_entry(&pool->pkts, struct rr_packet, list);
+		list_del(&pkt->list);
+		pool->nr_pkts--;
+		pool->pkt_hits++;
+	} else {
+		pool->pkt_fallbacks++;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	if (!pkt) {
+		pkt = rr_malloc(sizeof(*pkt));
+		if (!pkt)
+			return NULL;
+		pkt->pool = pool;
+	}
+	return pkt;
+}
+
+static void rr_free_packet(struct rr_packet *pkt)
+{
+	struct rr_pool *pool = pkt->pool;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	if (pool->nr_pkts < RR_POOL_PKTS) {
+		list_add(&pkt->list, &pool->pkts);
+		pool->nr_pkts++;
+		pkt = NULL;
+	}
+	spin_unlock_irqrestore(&pool->lock, flags);
+
+	kfree(pkt);
+}
+
 static int rr_read(struct rpcrouter_xprt_info *xprt_info,
 		   void *data, uint32_t len)
 {
@@ -978,10 +1206,14 @@ static char *type_to_str(int i)
 }
 #endif
 
-static void do_read_data(struct work_struct *work)
+/*
+ * Read one message from the transport and route it to its endpoint.
+ * Returns -EIO once the transport is dead or the stream is corrupt.
+ */
+static int rr_read_packet(struct rpcrouter_xprt_info *xprt_info)
 {
 	struct rr_header hdr;
-	struct rr_packet *pkt;
+	struct rr_packet *pkt, *spare;
 	struct rr_fragment *frag;
 	struct msm_rpc_endpoint *ept;
 #if defined(CONFIG_MSM_ONCRPCROUTER_DEBUG)
@@ -990,11 +1222,6 @@ static void do_read_data(struct work_struct *work)
 	uint32_t pm, mid;
 	unsigned long flags;
 
-	struct rpcrouter_xprt_info *xprt_info =
-		container_of(work,
-			     struct rpcrouter_xprt_info,
-			     read_data);
-
 	if (rr_read(xprt_info, &hdr, sizeof(hdr)))
 		goto fail_io;
 
@@ -1036,11 +1263,16 @@ static void do_read_data(struct work_struct *work)
 
 	hdr.size -= sizeof(pm);
 
-	frag = rr_malloc(sizeof(*frag));
-	frag->next = NULL;
+	frag = rr_alloc_fragment(&xprt_info->xprt->pool);
+	if (!frag) {
+		/* drop the fragment but keep the stream in sync */
+		if (rr_read(xprt_info, xprt_info->r2r_buf, hdr.size))
+			goto fail_io;
+		goto done;
+	}
 	frag->length = hdr.size;
 	if (rr_read(xprt_info, frag->data, hdr.size)) {
-		kfree(frag);
+		msm_rpcrouter_free_fragment(frag);
 		goto fail_io;
 	}
 
@@ -1079,11 +1311,16 @@ static void do_read_data(struct work_struct *work)
 	}
 #endif
 
+	/* rr_alloc_packet() may sleep, so it can't be done under rcu */
+	spare = rr_alloc_packet(&xprt_info->xprt->pool);
+
+	/* the endpoint may be closed, it is only safe to use until unlock */
+	rcu_read_lock();
 	ept = rpcrouter_lookup_local_endpoint(hdr.dst_cid);
 	if (!ept) {
 		DIAG("no local ept for cid %08x\n", hdr.dst_cid);
-		kfree(frag);
-		goto done;
+		msm_rpcrouter_free_fragment(frag);
+		goto done_unlock;
 	}
 
 	/* See if there is already a partial packet that matches our mid
@@ -1103,7 +1340,7 @@ static void do_read_data(struct work_struct *work)
 				goto packet_complete;
 			}
 			spin_unlock_irqrestore(&ept->incomplete_lock, flags);
-			goto done;
+			goto done_unlock;
 		}
 	}
 	spin_unlock_irqrestore(&ept->incomplete_lock, flags);
@@ -1111,7 +1348,12 @@ static void do_read_data(struct work_struct *work)
 	 * the incomplete list if this fragment is not a last fragment,
 	 * otherwise put it on the read queue.
 	 */
-	pkt = rr_malloc(sizeof(struct rr_packet));
+	pkt = spare;
+	if (!pkt) {
+		msm_rpcrouter_free_fragment(frag);
+		goto done_unlock;
+	}
+	spare = NULL;
 	pkt->first = frag;
 	pkt->last = frag;
 	memcpy(&pkt->hdr, &hdr, sizeof(hdr));
@@ -1119,7 +1361,7 @@ static void do_read_data(struct work_struct *work)
 	pkt->length = frag->length;
 	if (!PACMARK_LAST(pm)) {
 		list_add_tail(&pkt->list, &ept->incomplete);
-		goto done;
+		goto done_unlock;
 	}
 
 packet_complete:
@@ -1129,6 +1371,10 @@ packet_complete:
 	list_add_tail(&pkt->list, &ept->read_q);
 	wake_up(&ept->wait_q);
 	spin_unlock_irqrestore(&ept->read_q_lock, flags);
+done_unlock:
+	rcu_read_unlock();
+	if (spare)
+		rr_free_packet(spare);
 done:
 
 	if (hdr.confirm_rx) {
@@ -1151,6 +1397,22 @@ done:
 #endif
 
 	}
+	return 0;
+
+fail_io:
+fail_data:
+	return -EIO;
+}
+
+static void do_read_data(struct work_struct *work)
+{
+	struct rpcrouter_xprt_info *xprt_info =
+		container_of(work,
+			     struct rpcrouter_xprt_info,
+			     read_data);
+
+	if (rr_read_packet(xprt_info))
+		goto fail;
 
 	/* don't requeue if we should be shutting down */
 	if (!xprt_info->abort_data_read) {
@@ -1161,8 +1423,7 @@ done:
 	D("rpc_router terminating for '%s'\n",
 		xprt_info->xprt->name);
 
-fail_io:
-fail_data:
+fail:
 	D(KERN_ERR "rpc_router has died for '%s'\n",
 			xprt_info->xprt->name);
 }
@@ -1563,7 +1824,8 @@ int msm_rpc_write(struct msm_rpc_endpoint *ept, void *buffer, int count)
 		   be32_to_cpu(rq->xid), hdr.dst_pid, hdr.dst_cid, count);
 	}
 
-	r_ept = rpcrouter_lookup_remote_endpoint(hdr.dst_pid, hdr.dst_cid);
+	/* held across the quota waits in msm_rpc_write_pkt() */
+	r_ept = rpcrouter_get_remote_endpoint(hdr.dst_pid, hdr.dst_cid);
 
 	if ((!r_ept) && (hdr.dst_pid != RPCROUTER_PID_LOCAL)) {
 		printk(KERN_ERR
@@ -1611,6 +1873,9 @@ int msm_rpc_write(struct msm_rpc_endpoint *ept, void *buffer, int count)
 	}
 
  write_release_lock:
+	if (r_ept)
+		rpcrouter_put_remote_endpoint(r_ept);
+
 	/* if reply, release wakelock after writing to the transport */
 	if (rq->type != 0) {
 		/* Upon failure, add reply tag to the pending list.
@@ -1646,25 +1911,25 @@ int msm_rpc_read(struct msm_rpc_endpoint *ept, void **buffer,
 	if (rc <= 0)
 		return rc;
 
-	/* single-fragment messages conveniently can be
-	 * returned as-is (the buffer is at the front)
-	 */
-	if (frag->next == 0) {
-		*buffer = (void*) frag;
-		return rc;
-	}
-
-	/* multi-fragment messages, we have to do it the
-	 * hard way, which is rather disgusting right now
+	/* fragments belong to the transport pool, so the
+	 * caller always gets a copy it can kfree()
 	 */
 	buf = rr_malloc(rc);
+	if (!buf) {
+		while (frag != NULL) {
+			next = frag->next;
+			msm_rpcrouter_free_fragment(frag);
+			frag = next;
+		}
+		return -ENOMEM;
+	}
 	*buffer = buf;
 
 	while (frag != NULL) {
 		memcpy(buf, frag->data, frag->length);
 		next = frag->next;
 		buf += frag->length;
-		kfree(frag);
+		msm_rpcrouter_free_fragment(frag);
 		frag = next;
 	}
 
@@ -1860,7 +2125,7 @@ int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 		set_pend_reply(ept, reply);
 	}
 
-	kfree(pkt);
+	rr_free_packet(pkt);
 
 	IO("READ on ept %p (%d bytes)\n", ept, rc);
 
@@ -1895,37 +2160,39 @@ int msm_rpc_is_compatible_version(uint32_t server_version,
 }
 EXPORT_SYMBOL(msm_rpc_is_compatible_version);
 
-static struct rr_server *msm_rpc_get_server(uint32_t prog, uint32_t vers,
-					    uint32_t accept_compatible,
-					    uint32_t *found_prog)
+/*
+ * Copies the address of a matching server to @found, as the server
+ * itself may go away as soon as the RCU read section ends.
+ */
+static int msm_rpc_get_server(uint32_t prog, uint32_t vers,
+			      uint32_t accept_compatible,
+			      uint32_t *found_prog, struct rr_server *found)
 {
 	struct rr_server *server;
-	unsigned long     flags;
+	struct hlist_node *n;
+	int rc = 0;
 
 	if (found_prog == NULL)
-		return NULL;
+		return 0;
 
 	*found_prog = 0;
-	spin_lock_irqsave(&server_list_lock, flags);
-	list_for_each_entry(server, &server_list, list) {
-		if (server->prog == prog) {
-			*found_prog = 1;
-			spin_unlock_irqrestore(&server_list_lock, flags);
-			if (accept_compatible) {
-				if (msm_rpc_is_compatible_version(server->vers,
-								  vers)) {
-					return server;
-				} else {
-					return NULL;
-				}
-			} else if (server->vers == vers) {
-				return server;
-			} else
-				return NULL;
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(server, n, server_bucket(prog), hash) {
+		if (server->prog != prog)
+			continue;
+		*found_prog = 1;
+		if (accept_compatible ?
+		    msm_rpc_is_compatible_version(server->vers, vers) :
+		    server->vers == vers) {
+			found->pid = server->pid;
+			found->cid = server->cid;
+			found->vers = server->vers;
+			rc = 1;
+			break;
 		}
 	}
-	spin_unlock_irqrestore(&server_list_lock, flags);
-	return NULL;
+	rcu_read_unlock();
+	return rc;
 }
 
 static struct msm_rpc_endpoint *__msm_rpc_connect(uint32_t prog, uint32_t vers,
@@ -1933,8 +2200,9 @@ static struct msm_rpc_endpoint *__msm_rpc_connect(uint32_t prog, uint32_t vers,
 						  unsigned flags)
 {
 	struct msm_rpc_endpoint *ept;
-	struct rr_server *server;
+	struct rr_server server;
 	uint32_t found_prog;
+	int found;
 	int rc = 0;
 
 	DEFINE_WAIT(__wait);
@@ -1943,9 +2211,9 @@ static struct msm_rpc_endpoint *__msm_rpc_connect(uint32_t prog, uint32_t vers,
 		prepare_to_wait(&newserver_wait, &__wait,
 				TASK_INTERRUPTIBLE);
 
-		server = msm_rpc_get_server(prog, vers, accept_compatible,
-					    &found_prog);
-		if (server)
+		found = msm_rpc_get_server(prog, vers, accept_compatible,
+					   &found_prog, &server);
+		if (found)
 			break;
 
 		if (found_prog) {
@@ -1974,12 +2242,12 @@ static struct msm_rpc_endpoint *__msm_rpc_connect(uint32_t prog, uint32_t vers,
 	}
 	finish_wait(&newserver_wait, &__wait);
 
-	if (!server)
+	if (!found)
 		return ERR_PTR(rc);
 
-	if (accept_compatible && (server->vers != vers)) {
+	if (accept_compatible && (server.vers != vers)) {
 		D("RPC Using new version 0x%08x(0x%08x) prog 0x%08x",
-			vers, server->vers, prog);
+			vers, server.vers, prog);
 		D(" ... Continuing\n");
 	}
 
@@ -1988,10 +2256,10 @@ static struct msm_rpc_endpoint *__msm_rpc_connect(uint32_t prog, uint32_t vers,
 		return ept;
 
 	ept->flags = flags;
-	ept->dst_pid = server->pid;
-	ept->dst_cid = server->cid;
+	ept->dst_pid = server.pid;
+	ept->dst_cid = server.cid;
 	ept->dst_prog = cpu_to_be32(prog);
-	ept->dst_vers = cpu_to_be32(server->vers);
+	ept->dst_vers = cpu_to_be32(server.vers);
 
 	return ept;
 }
@@ -2062,13 +2330,7 @@ int msm_rpc_clear_netreset(struct msm_rpc_endpoint *ept)
 int msm_rpc_unregister_server(struct msm_rpc_endpoint *ept,
 			      uint32_t prog, uint32_t vers)
 {
-	struct rr_server *server;
-	server = rpcrouter_lookup_server(prog, vers);
-
-	if (!server)
-		return -ENOENT;
-	rpcrouter_destroy_server(server);
-	return 0;
+	return rpcrouter_remove_server(prog, vers);
 }
 
 int msm_rpc_get_curr_pkt_size(struct msm_rpc_endpoint *ept)
@@ -2214,6 +2476,286 @@ static int dump_msm_rpc_endpoint(char *buf, int max)
 	return i;
 }
 
+static int dump_pools(char *buf, int max)
+{
+	struct rpcrouter_xprt_info *xprt_info;
+	struct rr_pool *pool;
+	int i = 0;
+
+	mutex_lock(&xprt_info_list_lock);
+	list_for_each_entry(xprt_info, &xprt_info_list, list) {
+		pool = &xprt_info->xprt->pool;
+		i += scnprintf(buf + i, max - i, "%s:\n",
+			       xprt_info->xprt->name);
+		i += scnprintf(buf + i, max - i,
+			       "  fragments: free %u hits %lu fallbacks %lu\n",
+			       pool->nr_frags, pool->frag_hits,
+			       pool->frag_fallbacks);
+		i += scnprintf(buf + i, max - i,
+			       "  packets:   free %u hits %lu fallbacks %lu\n",
+			       pool->nr_pkts, pool->pkt_hits,
+			       pool->pkt_fallbacks);
+	}
+	mutex_unlock(&xprt_info_list_lock);
+
+	return i;
+}
+
+#define RR_BENCH_EPTS		64
+#define RR_BENCH_PACKETS	20000
+#define RR_BENCH_PAYLOAD	64
+#define RR_BENCH_MSG	(sizeof(struct rr_header) + sizeof(uint32_t) + \
+			 RR_BENCH_PAYLOAD)
+
+/* a transport that reads back whatever rr_bench_write() put into it */
+static struct {
+	uint8_t data[RR_BENCH_EPTS * RR_BENCH_MSG];
+	unsigned head;
+	unsigned tail;
+} rr_bench_ring;
+static DEFINE_MUTEX(rr_bench_lock);
+
+static void rr_bench_write(const void *data, unsigned len)
+{
+	memcpy(rr_bench_ring.data + rr_bench_ring.tail, data, len);
+	rr_bench_ring.tail += len;
+}
+
+static int rr_bench_read_avail(void)
+{
+	return rr_bench_ring.tail - rr_bench_ring.head;
+}
+
+static int rr_bench_read(void *data, uint32_t len)
+{
+	memcpy(data, rr_bench_ring.data + rr_bench_ring.head, len);
+	rr_bench_ring.head += len;
+	return len;
+}
+
+static int rr_bench_write_avail(void)
+{
+	return 0;
+}
+
+static int rr_bench_xprt_write(void *data, uint32_t len,
+			       enum write_data_type type)
+{
+	return -EIO;
+}
+
+static int rr_bench_close(void)
+{
+	return 0;
+}
+
+static struct rpcrouter_xprt rr_bench_xprt = {
+	.name		= "rpcrouter_bench_xprt",
+	.read_avail	= rr_bench_read_avail,
+	.read		= rr_bench_read,
+	.write_avail	= rr_bench_write_avail,
+	.write		= rr_bench_xprt_write,
+	.close		= rr_bench_close,
+};
+
+/*
+ * Receive side cost per packet with RR_BENCH_EPTS local endpoints open:
+ * read from the transport, endpoint lookup and queueing in
+ * rr_read_packet(), then __msm_rpc_read() by the endpoint owner.
+ */
+static int rr_route_bench(char *buf, int max)
+{
+	struct rpcrouter_xprt_info *xprt_info;
+	struct msm_rpc_endpoint **epts;
+	struct rr_fragment *frag, *next;
+	struct rr_header hdr;
+	uint32_t pm, payload[RR_BENCH_PAYLOAD / sizeof(uint32_t)];
+	ktime_t start;
+	s64 ns_route = 0, ns_read = 0;
+	int n, j, rc, done = 0, i = 0;
+
+	xprt_info = kzalloc(sizeof(*xprt_info), GFP_KERNEL);
+	epts = kmalloc(RR_BENCH_EPTS * sizeof(*epts), GFP_KERNEL);
+	if (!xprt_info || !epts)
+		goto out_free;
+
+	/* private to this function, never on xprt_info_list */
+	xprt_info->xprt = &rr_bench_xprt;
+	xprt_info->remote_pid = -1;
+	spin_lock_init(&xprt_info->lock);
+	init_waitqueue_head(&xprt_info->read_wait);
+	wake_lock_init(&xprt_info->wakelock, WAKE_LOCK_SUSPEND,
+		       "rpcrouter_bench");
+
+	for (n = 0; n < RR_BENCH_EPTS; n++) {
+		epts[n] = msm_rpcrouter_create_local_endpoint(MKDEV(0, 0));
+		if (!epts[n])
+			break;
+	}
+	if (!n)
+		goto out;
+
+	mutex_lock(&rr_bench_lock);
+	rr_pool_init(&rr_bench_xprt.pool);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.version = RPCROUTER_VERSION;
+	hdr.type = RPCROUTER_CTRL_CMD_DATA;
+	hdr.src_pid = RPCROUTER_PID_REMOTE;
+	hdr.size = sizeof(pm) + RR_BENCH_PAYLOAD;
+	hdr.dst_pid = RPCROUTER_PID_LOCAL;
+	memset(payload, 0, sizeof(payload));
+	/* an rpc reply, so that reading it does not queue a pending reply */
+	payload[1] = cpu_to_be32(1);
+
+	while (done < RR_BENCH_PACKETS) {
+		rr_bench_ring.head = 0;
+		rr_bench_ring.tail = 0;
+		for (j = 0; j < n; j++) {
+			hdr.dst_cid = epts[j]->cid;
+			pm = PACMARK(RR_BENCH_PAYLOAD, done + j, 1, 1);
+			payload[0] = done + j;
+			rr_bench_write(&hdr, sizeof(hdr));
+			rr_bench_write(&pm, sizeof(pm));
+			rr_bench_write(payload, sizeof(payload));
+		}
+
+		start = ktime_get();
+		for (j = 0; j < n; j++)
+			if (rr_read_packet(xprt_info))
+				break;
+		ns_route += ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (j < n)
+			break;
+
+		start = ktime_get();
+		for (j = 0; j < n; j++) {
+			rc = __msm_rpc_read(epts[j], &frag, RR_BENCH_PAYLOAD,
+					    -1);
+			if (rc != RR_BENCH_PAYLOAD)
+				break;
+			for (; frag; frag = next) {
+				next = frag->next;
+				msm_rpcrouter_free_fragment(frag);
+			}
+		}
+		ns_read += ktime_to_ns(ktime_sub(ktime_get(), start));
+		done += j;
+		if (j < n)
+			break;
+	}
+	mutex_unlock(&rr_bench_lock);
+
+	i += scnprintf(buf + i, max - i,
+		       "%d endpoints, %d packets of %d bytes\n",
+		       n, done, RR_BENCH_PAYLOAD);
+	i += scnprintf(buf + i, max - i, "  route: %lld ns per packet\n",
+		       div64_s64(ns_route, done ? done : 1));
+	i += scnprintf(buf + i, max - i, "  read:  %lld ns per packet\n",
+		       div64_s64(ns_read, done ? done : 1));
+
+out:
+	while (n--)
+		msm_rpcrouter_destroy_local_endpoint(epts[n]);
+	wake_lock_destroy(&xprt_info->wakelock);
+out_free:
+	kfree(epts);
+	kfree(xprt_info);
+
+	return i;
+}
+
+#define RR_XDR_BENCH_LOOPS	10000
+
+/* shaped like an rmt_storage iovec event followed by a ping data block */
+struct rr_xdr_bench_msg {
+	uint32_t type;
+	uint32_t handle;
+	uint32_t ent;
+	uint32_t iovecs[15];
+	uint32_t xfer_cnt;
+	uint32_t data[64];
+};
+
+DEFINE_XDR_DESC(rr_xdr_bench_desc,
+	XDR_FIELD(struct rr_xdr_bench_msg, type),
+	XDR_FIELD(struct rr_xdr_bench_msg, handle),
+	XDR_FIELD(struct rr_xdr_bench_msg, ent),
+	XDR_FIELD(struct rr_xdr_bench_msg, iovecs),
+	XDR_FIELD(struct rr_xdr_bench_msg, xfer_cnt),
+	XDR_FIELD(struct rr_xdr_bench_msg, data));
+
+/* encode and decode round trips, one word at a time and table driven */
+static int rr_xdr_bench(char *buf, int max)
+{
+	struct rr_xdr_bench_msg *in, *out;
+	struct msm_rpc_xdr xdr;
+	uint32_t *src, *dst;
+	void *wire;
+	ktime_t start;
+	s64 ns_field, ns_table;
+	int n, k, words = sizeof(*in) / sizeof(uint32_t);
+	int rc = 0, i = 0;
+
+	in = kmalloc(2 * sizeof(*in), GFP_KERNEL);
+	wire = kmalloc(sizeof(*in), GFP_KERNEL);
+	if (!in || !wire)
+		goto out;
+	out = in + 1;
+	src = (uint32_t *)in;
+	dst = (uint32_t *)out;
+	for (k = 0; k < words; k++)
+		src[k] = k * 0x01010101;
+
+	memset(&xdr, 0, sizeof(xdr));
+	xdr.out_buf = wire;
+	xdr.out_size = sizeof(*in);
+	xdr.in_buf = wire;
+	xdr.in_size = sizeof(*in);
+
+	memset(out, 0, sizeof(*out));
+	start = ktime_get();
+	for (n = 0; n < RR_XDR_BENCH_LOOPS; n++) {
+		xdr.out_index = 0;
+		xdr.in_index = 0;
+		for (k = 0; k < words; k++)
+			rc |= xdr_send_uint32(&xdr, &src[k]);
+		for (k = 0; k < words; k++)
+			rc |= xdr_recv_uint32(&xdr, &dst[k]);
+	}
+	ns_field = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (rc || memcmp(in, out, sizeof(*in))) {
+		i += scnprintf(buf + i, max - i, "field round trip mismatch\n");
+		goto out;
+	}
+
+	memset(out, 0, sizeof(*out));
+	start = ktime_get();
+	for (n = 0; n < RR_XDR_BENCH_LOOPS; n++) {
+		xdr.out_index = 0;
+		xdr.in_index = 0;
+		rc |= xdr_send_struct(&xdr, &rr_xdr_bench_desc, in);
+		rc |= xdr_recv_struct(&xdr, &rr_xdr_bench_desc, out);
+	}
+	ns_table = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (rc || memcmp(in, out, sizeof(*in))) {
+		i += scnprintf(buf + i, max - i, "table round trip mismatch\n");
+		goto out;
+	}
+
+	i += scnprintf(buf + i, max - i,
+		       "%d byte message, %d round trips\n",
+		       (int)sizeof(*in), RR_XDR_BENCH_LOOPS);
+	i += scnprintf(buf + i, max - i, "  per field: %lld ns\n",
+		       div64_s64(ns_field, RR_XDR_BENCH_LOOPS));
+	i += scnprintf(buf + i, max - i, "  table:     %lld ns\n",
+		       div64_s64(ns_table, RR_XDR_BENCH_LOOPS));
+out:
+	kfree(wire);
+	kfree(in);
+	return i;
+}
+
 #define DEBUG_BUFMAX 4096
 static char debug_buffer[DEBUG_BUFMAX];
 
@@ -2257,6 +2799,12 @@ static void debugfs_init(void)
 		     dump_remote_endpoints);
 	debug_create("dump_servers", 0444, dent,
 		     dump_servers);
+	debug_create("dump_pools", 0444, dent,
+		     dump_pools);
+	debug_create("route_bench", 0400, dent,
+		     rr_route_bench);
+	debug_create("xdr_bench", 0400, dent,
+		     rr_xdr_bench);
 
 }
 
@@ -2285,6 +2833,7 @@ static int msm_rpcrouter_add_xprt(struct rpcrouter_xprt *xprt)
 	xprt_info->abort_data_read = 0;
 	INIT_WORK(&xprt_info->read_data, do_read_data);
 	INIT_LIST_HEAD(&xprt_info->list);
+	rr_pool_init(&xprt->pool);
 
 	xprt_info->workqueue = create_singlethread_workqueue(xprt->name);
 	if (!xprt_info->workqueue) {
@@ -20,6 +20,7 @@
 
 #include <linux/types.h>
 #include <linux/list.h>
+#include <linux/rcupdate.h>
 #include <linux/cdev.h>
 #include <linux/platform_device.h>
 #include <linux/msm_rpcrouter.h>
@@ -88,10 +89,13 @@ struct rr_header {
 
 #define RPCROUTER_MAX_REMOTE_SERVERS		100
 
+struct rr_pool;
+
 struct rr_fragment {
 	unsigned char data[RPCROUTER_MSGSIZE_MAX];
 	uint32_t length;
 	struct rr_fragment *next;
+	struct rr_pool *pool;
 };
 
 struct rr_packet {
@@ -101,6 +105,7 @@ struct rr_packet {
 	struct rr_header hdr;
 	uint32_t mid;
 	uint32_t length;
+	struct rr_pool *pool;
 };
 
 #define PACMARK_LAST(n) ((n) & 0x80000000)
@@ -118,6 +123,8 @@ static inline uint32_t PACMARK(uint32_t len, uint32_t mid, uint32_t first,
 
 struct rr_server {
 	struct list_head list;
+	struct hlist_node hash;
+	struct rcu_head rcu;
 
 	uint32_t pid;
 	uint32_t cid;
@@ -141,6 +148,9 @@ struct rr_remote_endpoint {
 	wait_queue_head_t quota_wait;
 
 	struct list_head list;
+	struct hlist_node hash;
+	struct rcu_head rcu;
+	atomic_t refcount;	/* one held by the hash */
 };
 
 struct msm_rpc_reply {
@@ -154,6 +164,8 @@ struct msm_rpc_reply {
 
 struct msm_rpc_endpoint {
 	struct list_head list;
+	struct hlist_node hash;
+	struct rcu_head rcu;
 
 	/* incomplete packets waiting for assembly */
 	struct list_head incomplete;
@@ -208,10 +220,30 @@ enum write_data_type {
 	PAYLOAD,
 };
 
+/* Per transport cache of received fragments and packets.  It lives in
+ * the transport, which outlasts the rpcrouter_xprt_info torn down on a
+ * modem restart, so buffers still queued on endpoints can go back.
+ */
+struct rr_pool {
+	spinlock_t lock;
+	int initialized;
+
+	struct rr_fragment *frags;
+	unsigned nr_frags;
+	struct list_head pkts;
+	unsigned nr_pkts;
+
+	unsigned long frag_hits;
+	unsigned long frag_fallbacks;
+	unsigned long pkt_hits;
+	unsigned long pkt_fallbacks;
+};
+
 struct rpcrouter_xprt {
 	char *name;
 	void *priv;
 	int closed_for_reset;
+	struct rr_pool pool;
 
 	int (*read_avail)(void);
 	int (*read)(void *data, uint32_t len);
@@ -225,6 +257,7 @@ void msm_rpcrouter_xprt_notify(struct rpcrouter_xprt *xprt, unsigned event);
 int __msm_rpc_read(struct msm_rpc_endpoint *ept,
 		   struct rr_fragment **frag,
 		   unsigned len, long timeout);
+void msm_rpcrouter_free_fragment(struct rr_fragment *frag);
 
 int msm_rpcrouter_close(void);
 struct msm_rpc_endpoint *msm_rpcrouter_create_local_endpoint(dev_t dev);
@@ -98,6 +98,64 @@ int xdr_send_bytes(struct msm_rpc_xdr *xdr, const void **data,
 	return 0;
 }
 
+static inline void xdr_copy_to_be32(uint32_t *dst, const uint32_t *src,
+				    uint32_t count)
+{
+	while (count--)
+		*dst++ = cpu_to_be32(*src++);
+}
+
+static inline void xdr_copy_from_be32(uint32_t *dst, const uint32_t *src,
+				      uint32_t count)
+{
+	while (count--)
+		*dst++ = be32_to_cpu(*src++);
+}
+
+static uint32_t xdr_desc_size(const struct xdr_desc *desc)
+{
+	uint32_t i, size = 0;
+
+	for (i = 0; i < desc->nr_fields; i++)
+		size += desc->fields[i].count * sizeof(uint32_t);
+	return size;
+}
+
+int xdr_send_uint32_array(struct msm_rpc_xdr *xdr, const uint32_t *values,
+			  uint32_t count)
+{
+	if (count > (xdr->out_size - xdr->out_index) / sizeof(uint32_t)) {
+		pr_err("%s: xdr out buffer full\n", __func__);
+		return -1;
+	}
+
+	xdr_copy_to_be32(xdr->out_buf + xdr->out_index, values, count);
+	xdr->out_index += count * sizeof(uint32_t);
+	return 0;
+}
+
+int xdr_send_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    const void *obj)
+{
+	const struct xdr_field *field = desc->fields;
+	uint32_t *buf = xdr->out_buf + xdr->out_index;
+	uint32_t i, size;
+
+	size = xdr_desc_size(desc);
+	if (size > xdr->out_size - xdr->out_index) {
+		pr_err("%s: xdr out buffer full\n", __func__);
+		return -1;
+	}
+
+	for (i = 0; i < desc->nr_fields; i++, field++) {
+		xdr_copy_to_be32(buf, obj + field->offset, field->count);
+		buf += field->count;
+	}
+
+	xdr->out_index += size;
+	return 0;
+}
+
 int xdr_recv_uint32(struct msm_rpc_xdr *xdr, uint32_t *value)
 {
 	if ((xdr->in_index + sizeof(uint32_t)) > xdr->in_size) {
@@ -174,6 +232,41 @@ int xdr_recv_bytes(struct msm_rpc_xdr *xdr, void **data,
 	return 0;
 }
 
+int xdr_recv_uint32_array(struct msm_rpc_xdr *xdr, uint32_t *values,
+			  uint32_t count)
+{
+	if (count > (xdr->in_size - xdr->in_index) / sizeof(uint32_t)) {
+		pr_err("%s: xdr in buffer full\n", __func__);
+		return -1;
+	}
+
+	xdr_copy_from_be32(values, xdr->in_buf + xdr->in_index, count);
+	xdr->in_index += count * sizeof(uint32_t);
+	return 0;
+}
+
+int xdr_recv_struct(struct msm_rpc_xdr *xdr, const struct xdr_desc *desc,
+		    void *obj)
+{
+	const struct xdr_field *field = desc->fields;
+	const uint32_t *buf = xdr->in_buf + xdr->in_index;
+	uint32_t i, size;
+
+	size = xdr_desc_size(desc);
+	if (size > xdr->in_size - xdr->in_index) {
+		pr_err("%s: xdr in buffer full\n", __func__);
+		return -1;
+	}
+
+	for (i = 0; i < desc->nr_fields; i++, field++) {
+		xdr_copy_from_be32(obj + field->offset, buf, field->count);
+		buf += field->count;
+	}
+
+	xdr->in_index += size;
+	return 0;
+}
+
 int xdr_send_pointer(struct msm_rpc_xdr *xdr, void **obj,
 		     uint32_t obj_size, void *xdr_op)
 {
@@ -229,6 +322,10 @@ int xdr_send_array(struct msm_rpc_xdr *xdr, void **addr, uint32_t *size,
 	if (rc)
 		return rc;
 
+	/* arrays of words are swapped in one go */
+	if (xdr_op == (void *)xdr_send_uint32 && elm_size == sizeof(uint32_t))
+		return xdr_send_uint32_array(xdr, tmp_addr, *size);
+
 	for (i = 0; i < *size; i++) {
 		rc = ((int (*) (struct msm_rpc_xdr *, void *))xdr_op)
 			(xdr, tmp_addr);
@@ -262,6 +359,15 @@ int xdr_recv_array(struct msm_rpc_xdr *xdr, void **addr, uint32_t *size,
 		return -1;
 
 	*addr = tmp_addr;
+	if (xdr_op == (void *)xdr_recv_uint32 && elm_size == sizeof(uint32_t)) {
+		rc = xdr_recv_uint32_array(xdr, tmp_addr, *size);
+		if (rc) {
+			kfree(*addr);
+			*addr = NULL;
+		}
+		return rc;
+	}
+
 	for (i = 0; i < *size; i++) {
 		rc = ((int (*) (struct msm_rpc_xdr *, void *))xdr_op)
 			(xdr, tmp_addr);
@@ -279,6 +279,9 @@ void __generic_unplug_device(struct request_queue *q)
  **/
 void generic_unplug_device(struct request_queue *q)
 {
+	if (blk_queue_staged(q))
+		blk_stage_kick(q);
+
 	if (blk_queue_plugged(q)) {
 		spin_lock_irq(q->queue_lock);
 		__generic_unplug_device(q);
@@ -382,6 +385,7 @@ void blk_sync_queue(struct request_queue *q)
 	del_timer_sync(&q->unplug_timer);
 	del_timer_sync(&q->timeout);
 	cancel_work_sync(&q->unplug_work);
+	blk_stage_sync(q);
 }
 EXPORT_SYMBOL(blk_sync_queue);
 
@@ -1177,15 +1181,6 @@ static inline bool queue_should_plug(struct request_queue *q)
 
 static int __make_request(struct request_queue *q, struct bio *bio)
 {
-	struct request *req;
-	int el_ret;
-	unsigned int bytes = bio->bi_size;
-	const unsigned short prio = bio_prio(bio);
-	const bool sync = bio_rw_flagged(bio, BIO_RW_SYNCIO);
-	const bool unplug = bio_rw_flagged(bio, BIO_RW_UNPLUG);
-	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
-	int rw_flags;
-
 	if (bio_rw_flagged(bio, BIO_RW_BARRIER) &&
 	    (q->next_ordered == QUEUE_ORDERED_NONE)) {
 		bio_endio(bio, -EOPNOTSUPP);
@@ -1198,7 +1193,40 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 	 */
 	blk_queue_bounce(q, &bio);
 
+	if (blk_queue_staged(q)) {
+		/*
+		 * A barrier must not overtake bios that are still sitting
+		 * in the per-cpu staging lists.
+		 */
+		if (unlikely(bio_rw_flagged(bio, BIO_RW_BARRIER))) {
+			blk_stage_barrier(q, bio);
+			return 0;
+		}
+		if (blk_stage_bio(q, bio))
+			return 0;
+	}
+
 	spin_lock_irq(q->queue_lock);
+	__make_request_locked(q, bio);
+	spin_unlock_irq(q->queue_lock);
+	return 0;
+}
+
+/*
+ * Queue @bio on @q, merging it into an existing request if possible.
+ * Called and returns with the queue_lock held, but may drop it and sleep
+ * to allocate a new request.
+ */
+void __make_request_locked(struct request_queue *q, struct bio *bio)
+{
+	struct request *req;
+	int el_ret;
+	unsigned int bytes = bio->bi_size;
+	const unsigned short prio = bio_prio(bio);
+	const bool sync = bio_rw_flagged(bio, BIO_RW_SYNCIO);
+	const bool unplug = bio_rw_flagged(bio, BIO_RW_UNPLUG);
+	const unsigned int ff = bio->bi_rw & REQ_FAILFAST_MASK;
+	int rw_flags;
 
 	if (unlikely(bio_rw_flagged(bio, BIO_RW_BARRIER)) || elv_queue_empty(q))
 		goto get_rq;
@@ -1301,8 +1329,6 @@ get_rq:
 out:
 	if (unplug || !queue_should_plug(q))
 		__generic_unplug_device(q);
-	spin_unlock_irq(q->queue_lock);
-	return 0;
 }
 
 /*
@@ -1886,6 +1912,7 @@ void blk_dequeue_request(struct request *rq)
 	if (blk_account_rq(rq)) {
 		q->in_flight[rq_is_sync(rq)]++;
 		set_io_start_time_ns(rq);
+		blk_lat_hist_dispatch(rq);
 	}
 }
 
@@ -2133,6 +2160,8 @@ static void blk_finish_request(struct request *req, int error)
 	blk_delete_timer(req);
 
 	blk_account_io_done(req);
+	if (blk_account_rq(req))
+		blk_lat_hist_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -0,0 +1,172 @@
+/*
+ * Per-queue request latency and size histograms
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/blkdev.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+
+#include "blk.h"
+
+#define BLK_LAT_BUCKETS		24	/* <1us .. >=4s, in usecs */
+#define BLK_SIZE_BUCKETS	16	/* <512b .. >=8MB */
+
+enum {
+	BLK_LAT_READ = 0,
+	BLK_LAT_WRITE,
+	BLK_LAT_SYNC,
+	BLK_LAT_ASYNC,
+	BLK_LAT_NR_TYPES,
+};
+
+/*
+ * All counters are updated under the queue_lock.  Readers don't take
+ * it, a histogram may be slightly inconsistent while it is updated.
+ */
+struct blk_latency_hist {
+	unsigned long queue[BLK_LAT_BUCKETS][BLK_LAT_NR_TYPES];
+	unsigned long service[BLK_LAT_BUCKETS][BLK_LAT_NR_TYPES];
+	unsigned long size[BLK_SIZE_BUCKETS][BLK_LAT_NR_TYPES];
+};
+
+static inline void blk_lat_hist_add(unsigned long *bucket, struct request *rq)
+{
+	bucket[rq_data_dir(rq) == READ ? BLK_LAT_READ : BLK_LAT_WRITE]++;
+	bucket[rq_is_sync(rq) ? BLK_LAT_SYNC : BLK_LAT_ASYNC]++;
+}
+
+static inline int blk_lat_bucket(u64 start, u64 end)
+{
+	unsigned long usecs;
+
+	if (!time_after64(end, start))
+		return 0;
+
+	usecs = div_u64(end - start, NSEC_PER_USEC);
+	return min_t(int, fls_long(usecs), BLK_LAT_BUCKETS - 1);
+}
+
+/*
+ * Called with the queue_lock held when @rq is handed to the driver.
+ */
+void __blk_lat_hist_dispatch(struct request *rq)
+{
+	struct blk_latency_hist *hist = rq->q->latency_hist;
+	int idx;
+
+	idx = blk_lat_bucket(rq_start_time_ns(rq), rq_io_start_time_ns(rq));
+	blk_lat_hist_add(hist->queue[idx], rq);
+
+	idx = min_t(int, fls(blk_rq_sectors(rq)), BLK_SIZE_BUCKETS - 1);
+	blk_lat_hist_add(hist->size[idx], rq);
+}
+
+/*
+ * Called with the queue_lock held when @rq has been completed.
+ */
+void __blk_lat_hist_done(struct request *rq)
+{
+	struct blk_latency_hist *hist = rq->q->latency_hist;
+	u64 now;
+	int idx;
+
+	preempt_disable();
+	now = sched_clock();
+	preempt_enable();
+
+	idx = blk_lat_bucket(rq_io_start_time_ns(rq), now);
+	blk_lat_hist_add(hist->service[idx], rq);
+}
+
+ssize_t blk_lat_hist_enable_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%d\n", blk_queue_lat_hist(q));
+}
+
+/*
+ * Writing 1 (re)starts collection with cleared histograms, writing 0
+ * stops it.  The histograms are kept until the queue is released.
+ */
+ssize_t blk_lat_hist_enable_store(struct request_queue *q, const char *page,
+				  size_t count)
+{
+	struct blk_latency_hist *hist = NULL;
+	unsigned long val;
+	char *p = (char *) page;
+
+	val = simple_strtoul(p, &p, 10);
+
+	if (val && !q->latency_hist) {
+		hist = kzalloc_node(sizeof(*hist), GFP_KERNEL, q->node);
+		if (!hist)
+			return -ENOMEM;
+	}
+
+	spin_lock_irq(q->queue_lock);
+	if (val) {
+		if (!q->latency_hist) {
+			q->latency_hist = hist;
+			hist = NULL;
+		} else
+			memset(q->latency_hist, 0, sizeof(*q->latency_hist));
+		queue_flag_set(QUEUE_FLAG_LAT_HIST, q);
+	} else
+		queue_flag_clear(QUEUE_FLAG_LAT_HIST, q);
+	spin_unlock_irq(q->queue_lock);
+
+	kfree(hist);
+	return count;
+}
+
+static ssize_t blk_lat_hist_print(char *page, const char *unit,
+				  unsigned long (*hist)[BLK_LAT_NR_TYPES],
+				  int buckets, unsigned long scale)
+{
+	ssize_t len;
+	int i;
+
+	len = sprintf(page, "%10s %10s %10s %10s %10s\n", unit,
+		      "read", "write", "sync", "async");
+
+	for (i = 0; i < buckets; i++)
+		len += sprintf(page + len, "%10lu %10lu %10lu %10lu %10lu\n",
+			       i ? scale << (i - 1) : 0,
+			       hist[i][BLK_LAT_READ], hist[i][BLK_LAT_WRITE],
+			       hist[i][BLK_LAT_SYNC], hist[i][BLK_LAT_ASYNC]);
+
+	return len;
+}
+
+ssize_t blk_lat_hist_queue_show(struct request_queue *q, char *page)
+{
+	if (!q->latency_hist)
+		return 0;
+
+	return blk_lat_hist_print(page, "usecs", q->latency_hist->queue,
+				  BLK_LAT_BUCKETS, 1);
+}
+
+ssize_t blk_lat_hist_service_show(struct request_queue *q, char *page)
+{
+	if (!q->latency_hist)
+		return 0;
+
+	return blk_lat_hist_print(page, "usecs", q->latency_hist->service,
+				  BLK_LAT_BUCKETS, 1);
+}
+
+ssize_t blk_lat_hist_size_show(struct request_queue *q, char *page)
+{
+	if (!q->latency_hist)
+		return 0;
+
+	return blk_lat_hist_print(page, "bytes", q->latency_hist->size,
+				  BLK_SIZE_BUCKETS, 512);
+}
+
+void blk_lat_hist_free(struct request_queue *q)
+{
+	kfree(q->latency_hist);
+	q->latency_hist = NULL;
+}
@@ -0,0 +1,295 @@
+/*
+ * Per-cpu bio staging for request based queues
+ *
+ * With several CPUs submitting small I/O to the same queue, every bio
+ * going through __make_request() takes the queue_lock once to merge or
+ * queue it, and the lock bounces between the submitters.  When staging
+ * is enabled through queue/stage_batch, bios are first collected on a
+ * per-cpu list and handed to the elevator stage_batch at a time under a
+ * single acquisition of the queue_lock.
+ *
+ * A staged list is flushed when it reaches stage_batch bios, when an
+ * unplugging bio is staged, when the queue is unplugged and at the
+ * latest unplug_delay after the first bio was staged.  Flushes are
+ * serialized by q->stage_mutex, and barriers are queued under it after
+ * every list has been flushed, so no staged bio can overtake a barrier
+ * or be overtaken by one.
+ *
+ * Staged bios are queued from whichever task flushes the list, so only
+ * async writes are staged, and only on elevators that keep no state
+ * about the submitting task: CFQ takes the io_context and ioprio of
+ * current in its set_request hook.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/percpu.h>
+
+#include "blk.h"
+
+#define BLK_STAGE_MAX_BATCH	64
+
+struct blk_stage {
+	spinlock_t		lock;
+	struct bio_list		bios;
+	unsigned int		count;
+	unsigned long		staged;		/* bios ever staged */
+	unsigned long		flushes;	/* non-empty lists flushed */
+};
+
+static void blk_stage_take(struct blk_stage *st, struct bio_list *bios)
+{
+	spin_lock_irq(&st->lock);
+	*bios = st->bios;
+	bio_list_init(&st->bios);
+	if (st->count)
+		st->flushes++;
+	st->count = 0;
+	spin_unlock_irq(&st->lock);
+}
+
+/*
+ * Hand the bios staged on @st to the elevator.  Called with
+ * q->stage_mutex held, which keeps other flushers from slipping in
+ * while __make_request_locked() drops the queue_lock to wait for a
+ * free request.
+ */
+static void __blk_stage_flush(struct request_queue *q, struct blk_stage *st)
+{
+	struct bio_list bios;
+	struct bio *bio;
+
+	blk_stage_take(st, &bios);
+	if (bio_list_empty(&bios))
+		return;
+
+	spin_lock_irq(q->queue_lock);
+	while ((bio = bio_list_pop(&bios)))
+		__make_request_locked(q, bio);
+	spin_unlock_irq(q->queue_lock);
+}
+
+static void blk_stage_flush(struct request_queue *q, struct blk_stage *st)
+{
+	mutex_lock(&q->stage_mutex);
+	__blk_stage_flush(q, st);
+	mutex_unlock(&q->stage_mutex);
+}
+
+static void __blk_stage_flush_all(struct request_queue *q)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		__blk_stage_flush(q, per_cpu_ptr(q->stage, cpu));
+}
+
+/* Process context only, as queueing a bio may sleep */
+void blk_stage_flush_all(struct request_queue *q)
+{
+	mutex_lock(&q->stage_mutex);
+	__blk_stage_flush_all(q);
+	mutex_unlock(&q->stage_mutex);
+}
+
+/*
+ * Queue barrier @bio after everything staged before it.  Holding the
+ * mutex across both waits for flushes already in progress and keeps
+ * later ones from queueing bios ahead of the barrier.
+ */
+void blk_stage_barrier(struct request_queue *q, struct bio *bio)
+{
+	mutex_lock(&q->stage_mutex);
+	__blk_stage_flush_all(q);
+	spin_lock_irq(q->queue_lock);
+	__make_request_locked(q, bio);
+	spin_unlock_irq(q->queue_lock);
+	mutex_unlock(&q->stage_mutex);
+}
+
+/*
+ * Only async writes are staged: a sync bio has a waiter that the batch
+ * would delay, and READ_META is sync as well.  Elevators with a
+ * set_request hook attach the io_context of current to the request,
+ * which would be the flusher's rather than the submitter's.
+ */
+static int blk_stage_allowed(struct request_queue *q, struct bio *bio)
+{
+	if (bio_data_dir(bio) == READ ||
+	    bio_rw_flagged(bio, BIO_RW_SYNCIO) ||
+	    bio_rw_flagged(bio, BIO_RW_META))
+		return 0;
+
+	return !q->elevator->ops->elevator_set_req_fn;
+}
+
+/*
+ * Stage @bio on the local cpu list.  Returns 0 if staging is disabled
+ * or not allowed for @bio, and the caller has to queue it itself.
+ */
+int blk_stage_bio(struct request_queue *q, struct bio *bio)
+{
+	unsigned int batch = ACCESS_ONCE(q->stage_batch);
+	struct blk_stage *st;
+	unsigned long flags;
+	int flush;
+
+	if (!batch || !blk_stage_allowed(q, bio))
+		return 0;
+
+	/*
+	 * Migrating after picking the list is harmless, it is only a
+	 * matter of which lock we end up taking.
+	 */
+	st = per_cpu_ptr(q->stage, get_cpu());
+	put_cpu();
+
+	spin_lock_irqsave(&st->lock, flags);
+	bio_list_add(&st->bios, bio);
+	st->staged++;
+	flush = ++st->count >= batch || bio_rw_flagged(bio, BIO_RW_UNPLUG);
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	if (flush)
+		blk_stage_flush(q, st);
+	else if (!timer_pending(&q->stage_timer))
+		mod_timer(&q->stage_timer, jiffies + q->unplug_delay);
+
+	return 1;
+}
+
+/*
+ * Called on unplug, possibly from atomic context.  The bios are queued
+ * from kblockd, which then unplugs the queue once more for them.
+ */
+void blk_stage_kick(struct request_queue *q)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (per_cpu_ptr(q->stage, cpu)->count) {
+			kblockd_schedule_work(q, &q->stage_work);
+			return;
+		}
+	}
+}
+
+static void blk_stage_timeout(unsigned long data)
+{
+	struct request_queue *q = (struct request_queue *)data;
+
+	kblockd_schedule_work(q, &q->stage_work);
+}
+
+static void blk_stage_work(struct work_struct *work)
+{
+	struct request_queue *q =
+		container_of(work, struct request_queue, stage_work);
+
+	blk_stage_flush_all(q);
+	q->unplug_fn(q);
+}
+
+/*
+ * Called from blk_sync_queue().  Bios still staged have been submitted
+ * and would never complete once the lists are freed, so queue them now
+ * that neither the timer nor the work can do it any more.
+ */
+void blk_stage_sync(struct request_queue *q)
+{
+	if (!q->stage)
+		return;
+
+	del_timer_sync(&q->stage_timer);
+	cancel_work_sync(&q->stage_work);
+	blk_stage_flush_all(q);
+	q->unplug_fn(q);
+}
+
+void blk_stage_free(struct request_queue *q)
+{
+	struct bio_list bios;
+	struct bio *bio;
+	int cpu;
+
+	if (!q->stage)
+		return;
+
+	/* nothing should be left after blk_sync_queue(), but never hang */
+	for_each_possible_cpu(cpu) {
+		blk_stage_take(per_cpu_ptr(q->stage, cpu), &bios);
+		while ((bio = bio_list_pop(&bios)))
+			bio_endio(bio, -EIO);
+	}
+	free_percpu(q->stage);
+}
+
+ssize_t blk_stage_batch_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%u\n", q->stage_batch);
+}
+
+/*
+ * "staged flushes": each flush takes the queue_lock once for the whole
+ * list, so staged - flushes is the number of acquisitions saved.
+ */
+ssize_t blk_stage_stats_show(struct request_queue *q, char *page)
+{
+	unsigned long staged = 0, flushes = 0;
+	int cpu;
+
+	if (q->stage) {
+		for_each_possible_cpu(cpu) {
+			struct blk_stage *st = per_cpu_ptr(q->stage, cpu);
+
+			staged += st->staged;
+			flushes += st->flushes;
+		}
+	}
+	return sprintf(page, "%lu %lu\n", staged, flushes);
+}
+
+ssize_t blk_stage_batch_store(struct request_queue *q, const char *page,
+			      size_t count)
+{
+	unsigned long batch;
+	int cpu;
+
+	if (strict_strtoul(page, 10, &batch) || batch > BLK_STAGE_MAX_BATCH)
+		return -EINVAL;
+
+	/* bio based drivers never go through __make_request() */
+	if (!q->request_fn)
+		return -EINVAL;
+
+	if (batch && !q->stage) {
+		struct blk_stage __percpu *stage;
+
+		stage = alloc_percpu(struct blk_stage);
+		if (!stage)
+			return -ENOMEM;
+
+		for_each_possible_cpu(cpu) {
+			struct blk_stage *st = per_cpu_ptr(stage, cpu);
+
+			spin_lock_init(&st->lock);
+			bio_list_init(&st->bios);
+		}
+		mutex_init(&q->stage_mutex);
+		setup_timer(&q->stage_timer, blk_stage_timeout,
+			    (unsigned long)q);
+		INIT_WORK(&q->stage_work, blk_stage_work);
+
+		smp_wmb();
+		q->stage = stage;
+	}
+
+	q->stage_batch = batch;
+	if (!batch && q->stage) {
+		blk_stage_flush_all(q);
+		q->unplug_fn(q);
+	}
+
+	return count;
+}
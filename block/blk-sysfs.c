@@ -374,6 +374,42 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static struct queue_sysfs_entry queue_lat_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_lat_hist_enable_show,
+	.store = blk_lat_hist_enable_store,
+};
+
+static struct queue_sysfs_entry queue_lat_hist_queue_entry = {
+	.attr = {.name = "latency_hist_queue", .mode = S_IRUGO },
+	.show = blk_lat_hist_queue_show,
+};
+
+static struct queue_sysfs_entry queue_lat_hist_service_entry = {
+	.attr = {.name = "latency_hist_service", .mode = S_IRUGO },
+	.show = blk_lat_hist_service_show,
+};
+
+static struct queue_sysfs_entry queue_lat_hist_size_entry = {
+	.attr = {.name = "latency_hist_size", .mode = S_IRUGO },
+	.show = blk_lat_hist_size_show,
+};
+#endif
+
+#ifdef CONFIG_BLK_PERCPU_STAGE
+static struct queue_sysfs_entry queue_stage_batch_entry = {
+	.attr = {.name = "stage_batch", .mode = S_IRUGO | S_IWUSR },
+	.show = blk_stage_batch_show,
+	.store = blk_stage_batch_store,
+};
+
+static struct queue_sysfs_entry queue_stage_stats_entry = {
+	.attr = {.name = "stage_stats", .mode = S_IRUGO },
+	.show = blk_stage_stats_show,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -394,6 +430,16 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_LATENCY_HIST
+	&queue_lat_hist_entry.attr,
+	&queue_lat_hist_queue_entry.attr,
+	&queue_lat_hist_service_entry.attr,
+	&queue_lat_hist_size_entry.attr,
+#endif
+#ifdef CONFIG_BLK_PERCPU_STAGE
+	&queue_stage_batch_entry.attr,
+	&queue_stage_stats_entry.attr,
+#endif
 	NULL,
 };
 
@@ -471,6 +517,8 @@ static void blk_release_queue(struct kobject *kobj)
 		__blk_queue_free_tags(q);
 
 	blk_trace_shutdown(q);
+	blk_lat_hist_free(q);
+	blk_stage_free(q);
 
 	bdi_destroy(&q->backing_dev_info);
 	kmem_cache_free(blk_requestq_cachep, q);
@@ -165,4 +165,64 @@ static inline int blk_do_io_stat(struct request *rq)
 	       (blk_fs_request(rq) || blk_discard_rq(rq));
 }
 
+#define blk_queue_lat_hist(q)	test_bit(QUEUE_FLAG_LAT_HIST, &(q)->queue_flags)
+
+#ifdef CONFIG_BLK_LATENCY_HIST
+void __blk_lat_hist_dispatch(struct request *rq);
+void __blk_lat_hist_done(struct request *rq);
+void blk_lat_hist_free(struct request_queue *q);
+ssize_t blk_lat_hist_enable_show(struct request_queue *q, char *page);
+ssize_t blk_lat_hist_enable_store(struct request_queue *q, const char *page,
+				  size_t count);
+ssize_t blk_lat_hist_queue_show(struct request_queue *q, char *page);
+ssize_t blk_lat_hist_service_show(struct request_queue *q, char *page);
+ssize_t blk_lat_hist_size_show(struct request_queue *q, char *page);
+
+static inline void blk_lat_hist_dispatch(struct request *rq)
+{
+	if (unlikely(blk_queue_lat_hist(rq->q)))
+		__blk_lat_hist_dispatch(rq);
+}
+
+static inline void blk_lat_hist_done(struct request *rq)
+{
+	if (unlikely(blk_queue_lat_hist(rq->q)))
+		__blk_lat_hist_done(rq);
+}
+#else
+static inline void blk_lat_hist_dispatch(struct request *rq) { }
+static inline void blk_lat_hist_done(struct request *rq) { }
+static inline void blk_lat_hist_free(struct request_queue *q) { }
+#endif
+
+void __make_request_locked(struct request_queue *q, struct bio *bio);
+
+#ifdef CONFIG_BLK_PERCPU_STAGE
+#define blk_queue_staged(q)	((q)->stage != NULL)
+
+int blk_stage_bio(struct request_queue *q, struct bio *bio);
+void blk_stage_flush_all(struct request_queue *q);
+void blk_stage_barrier(struct request_queue *q, struct bio *bio);
+void blk_stage_kick(struct request_queue *q);
+void blk_stage_sync(struct request_queue *q);
+void blk_stage_free(struct request_queue *q);
+ssize_t blk_stage_batch_show(struct request_queue *q, char *page);
+ssize_t blk_stage_stats_show(struct request_queue *q, char *page);
+ssize_t blk_stage_batch_store(struct request_queue *q, const char *page,
+			      size_t count);
+#else
+#define blk_queue_staged(q)	0
+
+static inline int blk_stage_bio(struct request_queue *q, struct bio *bio)
+{
+	return 0;
+}
+static inline void blk_stage_flush_all(struct request_queue *q) { }
+static inline void blk_stage_barrier(struct request_queue *q,
+				     struct bio *bio) { }
+static inline void blk_stage_kick(struct request_queue *q) { }
+static inline void blk_stage_sync(struct request_queue *q) { }
+static inline void blk_stage_free(struct request_queue *q) { }
+#endif
+
 #endif
@@ -0,0 +1,457 @@
+/*
+ *  Flash i/o scheduler.
+ *
+ *  Derived from the deadline i/o scheduler, for non-rotational flash
+ *  media (eMMC, SD) where a burst of writes makes reads wait behind
+ *  erase/program cycles, but seeking is free.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int write_expire = HZ / 2;	/* max time before a write batch is forced */
+static const int writes_starved = 4;	/* max sync dispatches while writes wait */
+static const int write_batch = 16;	/* # of sorted writes dispatched in one go */
+
+/*
+ * Requests are split into a sync class (reads and sync writes), which
+ * is served in FIFO order with strict priority, and an async class
+ * (background writes), which is served in sector-sorted batches.
+ */
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are present on both sort_list and fifo_list, indexed
+	 * by BLK_RW_SYNC / BLK_RW_ASYNC
+	 */
+	struct rb_root sort_list[2];
+	struct list_head fifo_list[2];
+
+	/*
+	 * next write in sort order, may be NULL
+	 */
+	struct request *next_write;
+	unsigned int batching;		/* number of writes in this batch */
+	unsigned int batch_forced;	/* batch may not yield to reads */
+	unsigned int starved;		/* times sync requests starved writes */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int write_expire;
+	int writes_starved;
+	int write_batch;
+	int front_merges;
+};
+
+static void flash_move_request(struct flash_data *, struct request *);
+
+static inline int flash_bio_sync(struct bio *bio)
+{
+	return bio_data_dir(bio) == READ || bio_rw_flagged(bio, BIO_RW_SYNCIO);
+}
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_is_sync(rq)];
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_request(fd, __alias);
+}
+
+static inline void
+flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq)
+		fd->next_write = flash_latter_request(rq);
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = rq_is_sync(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list, only writes expire
+	 */
+	rq_set_fifo_time(rq, jiffies + (sync ? 0 : fd->write_expire));
+	list_add_tail(&rq->queuelist, &fd->fifo_list[sync]);
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[flash_bio_sync(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+/*
+ * don't let a sync bio wait behind a background write batch
+ */
+static int flash_allow_merge(struct request_queue *q, struct request *rq,
+			     struct bio *bio)
+{
+	return flash_bio_sync(bio) == rq_is_sync(rq);
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    rq_is_sync(req) == rq_is_sync(next)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move an entry to dispatch queue
+ */
+static void
+flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	/*
+	 * sync requests don't disturb the position of the write sweep
+	 */
+	if (!rq_is_sync(rq))
+		fd->next_write = flash_latter_request(rq);
+
+	/*
+	 * take it off the sort and fifo list, move
+	 * to dispatch queue
+	 */
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+/*
+ * flash_write_expired returns 0 if there are no expired writes on the
+ * fifo, 1 otherwise. Requires !list_empty(&fd->fifo_list[BLK_RW_ASYNC])
+ */
+static inline int flash_write_expired(struct flash_data *fd)
+{
+	struct request *rq = rq_entry_fifo(fd->fifo_list[BLK_RW_ASYNC].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * flash_dispatch_requests selects the best request according to
+ * writes_starved, write_expire, write_batch, etc
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int syncs = !list_empty(&fd->fifo_list[BLK_RW_SYNC]);
+	const int writes = !list_empty(&fd->fifo_list[BLK_RW_ASYNC]);
+	struct request *rq;
+
+	/*
+	 * Continue a running write batch in sector order.  A batch that
+	 * was started because writes were starved or expired runs to its
+	 * end, any other batch yields as soon as sync requests show up.
+	 */
+	if (fd->batching && fd->next_write &&
+	    fd->batching < fd->write_batch &&
+	    (!syncs || fd->batch_forced)) {
+		rq = fd->next_write;
+		goto dispatch_write;
+	}
+
+	fd->batching = 0;
+
+	if (syncs) {
+		if (writes && (fd->starved >= fd->writes_starved ||
+			       flash_write_expired(fd))) {
+			fd->batch_forced = 1;
+			goto dispatch_writes;
+		}
+
+		if (writes)
+			fd->starved++;
+
+		rq = rq_entry_fifo(fd->fifo_list[BLK_RW_SYNC].next);
+		flash_move_request(fd, rq);
+		return 1;
+	}
+
+	if (!writes)
+		return 0;
+
+	fd->batch_forced = 0;
+
+dispatch_writes:
+	BUG_ON(RB_EMPTY_ROOT(&fd->sort_list[BLK_RW_ASYNC]));
+
+	fd->starved = 0;
+
+	if (flash_write_expired(fd)) {
+		/*
+		 * Start again from the write with the earliest expiry time.
+		 */
+		rq = rq_entry_fifo(fd->fifo_list[BLK_RW_ASYNC].next);
+	} else if (fd->next_write) {
+		/*
+		 * Continue the sweep from where the last batch stopped.
+		 */
+		rq = fd->next_write;
+	} else {
+		/*
+		 * Ran out of higher-sectored writes, wrap around.
+		 */
+		rq = rb_entry_rq(rb_first(&fd->sort_list[BLK_RW_ASYNC]));
+	}
+
+dispatch_write:
+	fd->batching++;
+	flash_move_request(fd, rq);
+
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return list_empty(&fd->fifo_list[BLK_RW_ASYNC])
+		&& list_empty(&fd->fifo_list[BLK_RW_SYNC]);
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(!list_empty(&fd->fifo_list[BLK_RW_SYNC]));
+	BUG_ON(!list_empty(&fd->fifo_list[BLK_RW_ASYNC]));
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	INIT_LIST_HEAD(&fd->fifo_list[BLK_RW_SYNC]);
+	INIT_LIST_HEAD(&fd->fifo_list[BLK_RW_ASYNC]);
+	fd->sort_list[BLK_RW_SYNC] = RB_ROOT;
+	fd->sort_list[BLK_RW_ASYNC] = RB_ROOT;
+	fd->write_expire = write_expire;
+	fd->writes_starved = writes_starved;
+	fd->write_batch = write_batch;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_write_expire_show, fd->write_expire, 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_write_batch_show, fd->write_batch, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_write_expire_store, &fd->write_expire, 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_write_batch_store, &fd->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(write_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(write_batch),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_allow_merge_fn =	flash_allow_merge,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
@@ -24,6 +24,18 @@
 #include <linux/slab.h>
 
 #define CRYPTD_MAX_CPU_QLEN 100
+#define CRYPTD_MAX_BATCH 16
+
+static unsigned int cryptd_batch = 8;
+module_param_named(batch, cryptd_batch, uint, 0644);
+MODULE_PARM_DESC(batch, "Maximum number of queued requests for the same "
+		 "tfm handled per worker pass (1 disables batching)");
+
+unsigned int cryptd_set_batch(unsigned int batch)
+{
+	return xchg(&cryptd_batch, batch);
+}
+EXPORT_SYMBOL_GPL(cryptd_set_batch);
 
 struct cryptd_cpu_queue {
 	struct crypto_queue queue;
@@ -107,29 +119,60 @@ static int cryptd_enqueue_request(struct cryptd_queue *queue,
 	return err;
 }
 
-/* Called in workqueue context, do one real cryption work (via
- * req->complete) and reschedule itself if there are more work to
- * do. */
+/* Is the request at the head of the queue for the given tfm? */
+static inline int cryptd_next_is_tfm(struct crypto_queue *queue,
+				     struct crypto_tfm *tfm)
+{
+	struct crypto_async_request *req;
+
+	if (!queue->qlen)
+		return 0;
+
+	req = list_entry(queue->list.next, struct crypto_async_request, list);
+	return req->tfm == tfm;
+}
+
+/* Called in workqueue context, do the real cryption work (via
+ * req->complete) for a run of up to cryptd_batch requests on the
+ * same tfm, and reschedule itself if there are more work to do.
+ * Batching amortizes the dequeue and workqueue dispatch cost over
+ * the run, which matters for small (e.g. IPsec sized) requests. */
 static void cryptd_queue_worker(struct work_struct *work)
 {
 	struct cryptd_cpu_queue *cpu_queue;
 	struct crypto_async_request *req, *backlog;
+	struct crypto_async_request *reqs[CRYPTD_MAX_BATCH];
+	struct crypto_async_request *backlogs[CRYPTD_MAX_BATCH];
+	unsigned int max_batch, nreqs, nbacklogs, i;
 
 	cpu_queue = container_of(work, struct cryptd_cpu_queue, work);
-	/* Only handle one request at a time to avoid hogging crypto
-	 * workqueue. preempt_disable/enable is used to prevent
-	 * being preempted by cryptd_enqueue_request() */
+	max_batch = clamp_t(unsigned int, cryptd_batch, 1, CRYPTD_MAX_BATCH);
+	nreqs = nbacklogs = 0;
+
+	/* Only handle a bounded number of requests at a time to avoid
+	 * hogging crypto workqueue. preempt_disable/enable is used to
+	 * prevent being preempted by cryptd_enqueue_request() */
 	preempt_disable();
-	backlog = crypto_get_backlog(&cpu_queue->queue);
-	req = crypto_dequeue_request(&cpu_queue->queue);
+	while (nreqs < max_batch) {
+		if (nreqs && !cryptd_next_is_tfm(&cpu_queue->queue,
+						 reqs[0]->tfm))
+			break;
+
+		backlog = crypto_get_backlog(&cpu_queue->queue);
+		req = crypto_dequeue_request(&cpu_queue->queue);
+		if (!req)
+			break;
+
+		if (backlog)
+			backlogs[nbacklogs++] = backlog;
+		reqs[nreqs++] = req;
+	}
 	preempt_enable();
 
-	if (!req)
-		return;
-
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
-	req->complete(req, 0);
+	for (i = 0; i < nbacklogs; i++)
+		backlogs[i]->complete(backlogs[i], -EINPROGRESS);
+	for (i = 0; i < nreqs; i++)
+		reqs[i]->complete(reqs[i], 0);
 
 	if (cpu_queue->queue.qlen)
 		queue_work(kcrypto_wq, &cpu_queue->work);
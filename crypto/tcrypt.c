@@ -16,6 +16,7 @@
  */
 
 #include <crypto/hash.h>
+#include <crypto/cryptd.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/gfp.h>
@@ -711,6 +712,192 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+/*
+ * Used by test_acipher_batch_speed(): keep TCRYPT_MAX_INFLIGHT small
+ * requests in flight on cryptd, once with its batching off and once
+ * with it on, so that both runs see the same concurrency.
+ */
+#define TCRYPT_MAX_INFLIGHT	32
+
+struct tcrypt_batch_result {
+	struct completion completion;
+	atomic_t pending;
+	int err;
+};
+
+static void tcrypt_batch_complete(struct crypto_async_request *req, int err)
+{
+	struct tcrypt_batch_result *res = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	if (err)
+		res->err = err;
+	if (atomic_dec_and_test(&res->pending))
+		complete(&res->completion);
+}
+
+static int do_acipher_batch(struct ablkcipher_request **reqs, int depth,
+			    int enc, struct tcrypt_batch_result *res)
+{
+	int i, ret;
+
+	INIT_COMPLETION(res->completion);
+	atomic_set(&res->pending, depth + 1);
+	res->err = 0;
+
+	for (i = 0; i < depth; i++) {
+		if (enc)
+			ret = crypto_ablkcipher_encrypt(reqs[i]);
+		else
+			ret = crypto_ablkcipher_decrypt(reqs[i]);
+
+		if (ret == -EINPROGRESS || ret == -EBUSY)
+			continue;
+
+		/* completed synchronously */
+		if (ret)
+			res->err = ret;
+		atomic_dec(&res->pending);
+	}
+
+	if (!atomic_dec_and_test(&res->pending))
+		wait_for_completion(&res->completion);
+
+	return res->err;
+}
+
+static int test_acipher_batch_jiffies(struct ablkcipher_request **reqs,
+				      int depth, int enc, int blen, int sec,
+				      struct tcrypt_batch_result *res)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount += depth) {
+		ret = do_acipher_batch(reqs, depth, enc, res);
+		if (ret)
+			return ret;
+	}
+
+	printk("%d operations in %d seconds (%ld bytes)\n",
+	       bcount, sec, (long)bcount * blen);
+	return 0;
+}
+
+static u32 batch_block_sizes[] = { 64, 128, 256, 512, 0 };
+
+static void test_acipher_batch_speed(const char *algo, int enc,
+				     unsigned int sec, unsigned int keysize)
+{
+	struct ablkcipher_request *reqs[TCRYPT_MAX_INFLIGHT];
+	static struct scatterlist sg[TCRYPT_MAX_INFLIGHT];
+	static u8 iv[TCRYPT_MAX_INFLIGHT][16];
+	struct tcrypt_batch_result res;
+	struct crypto_ablkcipher *tfm;
+	unsigned int iv_len, batches[2], old_batch;
+	const char *e;
+	u32 *b_size;
+	int i, j, ret;
+
+	if (enc == ENCRYPT)
+		e = "encryption";
+	else
+		e = "decryption";
+
+	printk("\ntesting speed of async %s %s\n", algo, e);
+
+	if (!sec)
+		sec = 1;
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		printk("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	iv_len = crypto_ablkcipher_ivsize(tfm);
+	if (iv_len > sizeof(iv[0])) {
+		printk("ivsize(%u) > iv buffer(%zu)\n", iv_len,
+		       sizeof(iv[0]));
+		goto out;
+	}
+
+	memset(tvmem[0], 0xff, PAGE_SIZE);
+	ret = crypto_ablkcipher_setkey(tfm, tvmem[0], keysize);
+	if (ret) {
+		printk("setkey() failed flags=%x\n",
+		       crypto_ablkcipher_get_flags(tfm));
+		goto out;
+	}
+
+	/* batching off, then the configured batch size or the default */
+	old_batch = cryptd_set_batch(1);
+	batches[0] = 1;
+	batches[1] = old_batch > 1 ? old_batch : 8;
+
+	init_completion(&res.completion);
+	memset(reqs, 0, sizeof(reqs));
+	for (i = 0; i < TCRYPT_MAX_INFLIGHT; i++) {
+		reqs[i] = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!reqs[i]) {
+			printk("ablkcipher request allocation failure\n");
+			goto out_free_req;
+		}
+		ablkcipher_request_set_callback(reqs[i],
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_batch_complete, &res);
+		memset(iv[i], 0xff, sizeof(iv[i]));
+	}
+
+	for (b_size = batch_block_sizes; *b_size; b_size++) {
+		/* give each request its own slice of tvmem */
+		if (TCRYPT_MAX_INFLIGHT * *b_size > TVMEMSIZE * PAGE_SIZE) {
+			printk("template (%u) too big for tvmem (%lu)\n",
+			       TCRYPT_MAX_INFLIGHT * *b_size,
+			       TVMEMSIZE * PAGE_SIZE);
+			break;
+		}
+
+		sg_init_table(sg, TCRYPT_MAX_INFLIGHT);
+		for (i = 0; i < TCRYPT_MAX_INFLIGHT; i++) {
+			unsigned int off = i * *b_size;
+
+			sg_set_buf(sg + i, tvmem[off / PAGE_SIZE] +
+				   off % PAGE_SIZE, *b_size);
+			ablkcipher_request_set_crypt(reqs[i], sg + i, sg + i,
+						     *b_size, iv[i]);
+		}
+
+		for (j = 0; j < ARRAY_SIZE(batches); j++) {
+			cryptd_set_batch(batches[j]);
+			printk("test (%d bit key, %d byte blocks, %d in flight, "
+			       "batch %u): ", keysize * 8, *b_size,
+			       TCRYPT_MAX_INFLIGHT, batches[j]);
+
+			ret = test_acipher_batch_jiffies(reqs,
+							 TCRYPT_MAX_INFLIGHT,
+							 enc, *b_size, sec,
+							 &res);
+			if (ret) {
+				printk("%s() failed ret=%d\n", e, ret);
+				goto out_free_req;
+			}
+		}
+	}
+
+out_free_req:
+	for (i = 0; i < TCRYPT_MAX_INFLIGHT; i++)
+		ablkcipher_request_free(reqs[i]);
+	cryptd_set_batch(old_batch);
+out:
+	crypto_free_ablkcipher(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -997,6 +1184,10 @@ static int do_test(int m)
 				speed_template_32_48_64);
 		test_cipher_speed("xts(aes)", DECRYPT, sec, NULL, 0,
 				speed_template_32_48_64);
+		test_cipher_speed("ctr(aes)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
 		break;
 
 	case 201:
@@ -1063,6 +1254,22 @@ static int do_test(int m)
 				  speed_template_16_32);
 		break;
 
+	case 207:
+		/* baseline for arch optimized aes implementations */
+		test_cipher_speed("ecb(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		break;
+
 	case 300:
 		/* fall through */
 
@@ -1138,6 +1345,12 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		/* baseline for arch optimized sha256 implementations */
+		test_hash_speed("sha256-generic", sec,
+				generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1215,6 +1428,11 @@ static int do_test(int m)
 	case 499:
 		break;
 
+	case 500:
+		test_acipher_batch_speed("cryptd(cbc(aes))", ENCRYPT, sec, 16);
+		test_acipher_batch_speed("cryptd(cbc(aes))", DECRYPT, sec, 16);
+		break;
+
 	case 1000:
 		test_available();
 		break;
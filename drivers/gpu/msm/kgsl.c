@@ -1981,6 +1981,8 @@ int kgsl_device_probe(struct kgsl_device *device,
 	ATOMIC_INIT_NOTIFIER_HEAD(&device->ts_notifier_list);
 
 	setup_timer(&device->idle_timer, kgsl_timer, (unsigned long) device);
+	/* a late idle check only keeps the core clocked a bit longer */
+	set_timer_slack(&device->idle_timer, HZ / 50);
 	status = kgsl_create_device_workqueue(device);
 	if (status)
 		goto error_free_irq;
@@ -33,6 +33,8 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/hrtimer.h>
+#include <linux/percpu.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
 #include <asm/io.h>
@@ -69,6 +71,13 @@
  * Events that require holding "epmutex" are very rare, while for
  * normal operations the epoll private "ep->mtx" will guarantee
  * a better scalability.
+ *
+ * With per-cpu ready lists (fs.epoll.percpu_ready), the poll callback
+ * does not take "ep->lock" to queue an item. The item is staged on a
+ * list of the current cpu, protected by a spinlock of its own, and is
+ * moved to the ready list under "ep->lock" by ep_merge_staged(). The
+ * callback then takes "ep->lock" only when there are waiters to wake
+ * up. "ep->lock" nests outside the per-cpu list locks.
  */
 
 /* Epoll private bits inside the event mask */
@@ -120,7 +129,8 @@ struct epitem {
 
 	/*
 	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * single linked chain of items. With per-cpu ready lists, it
+	 * chains the items staged on a cpu instead.
 	 */
 	struct epitem *next;
 
@@ -143,6 +153,12 @@ struct epitem {
 	struct epoll_event event;
 };
 
+/* Per-cpu list of items staged by ep_poll_callback() */
+struct ep_staged {
+	spinlock_t lock;
+	struct epitem *head;
+};
+
 /*
  * This structure is stored inside the "private_data" member of the file
  * structure and rapresent the main data sructure for the eventpoll
@@ -181,6 +197,14 @@ struct eventpoll {
 
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
+
+	/* Per-cpu ready sublists, NULL unless fs.epoll.percpu_ready is set */
+	struct ep_staged __percpu *staged;
+
+	/* Wakeups from the poll callback are delayed by this much, if set */
+	u64 batch_ns;
+	struct hrtimer batch_timer;
+	unsigned long batch_pending;
 };
 
 /* Wait structure used by the poll hooks */
@@ -219,6 +243,12 @@ struct ep_send_events_data {
 /* Maximum number of epoll watched descriptors, per user */
 static int max_user_watches __read_mostly;
 
+/* Use per-cpu ready lists in new epoll instances */
+static int percpu_ready __read_mostly;
+
+/* Wakeup batching window of new epoll instances, in microseconds */
+static int wakeup_batch_us __read_mostly;
+
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
  */
@@ -241,6 +271,8 @@ static struct kmem_cache *pwq_cache __read_mostly;
 #include <linux/sysctl.h>
 
 static int zero;
+static int one = 1;
+static int batch_max_us = 100000;
 
 ctl_table epoll_table[] = {
 	{
@@ -251,6 +283,24 @@ ctl_table epoll_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= &zero,
 	},
+	{
+		.procname	= "percpu_ready",
+		.data		= &percpu_ready,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+	{
+		.procname	= "wakeup_batch_us",
+		.data		= &wakeup_batch_us,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &batch_max_us,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -412,6 +462,153 @@ static void ep_poll_safewake(wait_queue_head_t *wq)
 	put_cpu();
 }
 
+/*
+ * Wakes up the waiters of the eventpoll, both on the eventpoll wait list
+ * and on the ->poll() wait list.
+ */
+static void ep_wake_waiters(struct eventpoll *ep)
+{
+	int pwake = 0;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (waitqueue_active(&ep->wq))
+		wake_up_locked(&ep->wq);
+	if (waitqueue_active(&ep->poll_wait))
+		pwake++;
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	/* We have to call this outside the lock */
+	if (pwake)
+		ep_poll_safewake(&ep->poll_wait);
+}
+
+/*
+ * With wakeup batching, the first event of a window arms the batch timer
+ * and the waiters are woken up once, when it expires, for all the events
+ * that came in meanwhile.
+ */
+static void ep_batch_wakeup(struct eventpoll *ep)
+{
+	if (!test_and_set_bit(0, &ep->batch_pending))
+		hrtimer_start(&ep->batch_timer, ns_to_ktime(ep->batch_ns),
+			      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart ep_batch_timeout(struct hrtimer *timer)
+{
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    batch_timer);
+
+	/*
+	 * Clear the flag before waking up, so that an event coming in after
+	 * the wakeup arms the timer again instead of being left behind.
+	 */
+	clear_bit(0, &ep->batch_pending);
+	smp_mb__after_clear_bit();
+	ep_wake_waiters(ep);
+
+	return HRTIMER_NORESTART;
+}
+
+/* Tells if items have been staged on any of the per-cpu ready lists */
+static inline int ep_has_staged(struct eventpoll *ep)
+{
+	int cpu;
+
+	if (!ep->staged)
+		return 0;
+	for_each_possible_cpu(cpu)
+		if (per_cpu_ptr(ep->staged, cpu)->head)
+			return 1;
+	return 0;
+}
+
+/* Tells if there are ready items, either on the ready list or staged */
+static inline int ep_ready_pending(struct eventpoll *ep)
+{
+	return !list_empty(&ep->rdllist) || ep_has_staged(ep);
+}
+
+/*
+ * Stages @epi on the ready list of the current cpu, unless it is staged
+ * already. Returns 1 if the item has been staged by this call.
+ */
+static int ep_stage(struct eventpoll *ep, struct epitem *epi)
+{
+	unsigned long flags;
+	struct ep_staged *st;
+
+	/* Claim the item, concurrent callbacks for it back off here */
+	if (cmpxchg(&epi->next, EP_UNACTIVE_PTR, NULL) != EP_UNACTIVE_PTR)
+		return 0;
+
+	local_irq_save(flags);
+	st = per_cpu_ptr(ep->staged, smp_processor_id());
+	spin_lock(&st->lock);
+	epi->next = st->head;
+	st->head = epi;
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	return 1;
+}
+
+/*
+ * Moves the items staged on the per-cpu lists to the ready list. Must be
+ * called with "ep->lock" held.
+ */
+static void ep_merge_staged(struct eventpoll *ep)
+{
+	int cpu;
+	struct ep_staged *st;
+	struct epitem *epi, *nepi;
+	LIST_HEAD(staged);
+
+	if (!ep->staged)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		st = per_cpu_ptr(ep->staged, cpu);
+		if (!st->head)
+			continue;
+
+		spin_lock(&st->lock);
+		nepi = st->head;
+		st->head = NULL;
+		spin_unlock(&st->lock);
+
+		/*
+		 * The chain is in LIFO order, adding each item at the head
+		 * of "staged" restores the order the events came in. Once
+		 * ->next is reset, the poll callback can stage the item
+		 * again, so it has to be read before.
+		 */
+		while ((epi = nepi) != NULL) {
+			nepi = epi->next;
+			epi->next = EP_UNACTIVE_PTR;
+			if (!ep_is_linked(&epi->rdllink))
+				list_add(&epi->rdllink, &staged);
+		}
+		list_splice_tail_init(&staged, &ep->rdllist);
+	}
+}
+
+/*
+ * Unlinks @epi from the ready list, or from the per-cpu list it is
+ * staged on. Its poll callbacks must have been unregistered already.
+ */
+static void ep_unlink_ready(struct eventpoll *ep, struct epitem *epi)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (epi->next != EP_UNACTIVE_PTR)
+		ep_merge_staged(ep);
+	if (ep_is_linked(&epi->rdllink))
+		list_del_init(&epi->rdllink);
+	spin_unlock_irqrestore(&ep->lock, flags);
+}
+
 /*
  * This function unregisters poll callbacks from the associated file
  * descriptor.  Must be called with "mtx" held (or "epmutex" if called from
@@ -467,6 +664,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_merge_staged(ep);
 	list_splice_init(&ep->rdllist, &txlist);
 	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
@@ -504,6 +702,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	 * Quickly re-inject items left on "txlist".
 	 */
 	list_splice(&txlist, &ep->rdllist);
+	ep_merge_staged(ep);
 
 	if (!list_empty(&ep->rdllist)) {
 		/*
@@ -532,7 +731,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
@@ -553,10 +751,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unlink_ready(ep, epi);
 
 	/* At this point it is safe to free the eventpoll item */
 	kmem_cache_free(epi_cache, epi);
@@ -594,6 +789,9 @@ static void ep_free(struct eventpoll *ep)
 		ep_unregister_pollwait(ep, epi);
 	}
 
+	/* No callback can arm the batch timer anymore */
+	hrtimer_cancel(&ep->batch_timer);
+
 	/*
 	 * Walks through the whole tree by freeing each "struct epitem". At this
 	 * point we are sure no poll callbacks will be lingering around, and also by
@@ -608,6 +806,7 @@ static void ep_free(struct eventpoll *ep)
 	mutex_unlock(&epmutex);
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
+	free_percpu(ep->staged);
 	kfree(ep);
 }
 
@@ -721,7 +920,7 @@ void eventpoll_release_file(struct file *file)
 
 static int ep_alloc(struct eventpoll **pep)
 {
-	int error;
+	int error, cpu;
 	struct user_struct *user;
 	struct eventpoll *ep;
 
@@ -731,6 +930,14 @@ static int ep_alloc(struct eventpoll **pep)
 	if (unlikely(!ep))
 		goto free_uid;
 
+	if (ACCESS_ONCE(percpu_ready)) {
+		ep->staged = alloc_percpu(struct ep_staged);
+		if (unlikely(!ep->staged))
+			goto free_ep;
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(ep->staged, cpu)->lock);
+	}
+
 	spin_lock_init(&ep->lock);
 	mutex_init(&ep->mtx);
 	init_waitqueue_head(&ep->wq);
@@ -739,11 +946,16 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	ep->batch_ns = (u64) ACCESS_ONCE(wakeup_batch_us) * NSEC_PER_USEC;
+	hrtimer_init(&ep->batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ep->batch_timer.function = ep_batch_timeout;
 
 	*pep = ep;
 
 	return 0;
 
+free_ep:
+	kfree(ep);
 free_uid:
 	free_uid(user);
 	return error;
@@ -778,6 +990,42 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 	return epir;
 }
 
+/*
+ * Poll callback for eventpolls with per-cpu ready lists. The item is
+ * staged on the list of the current cpu and "ep->lock" is only taken if
+ * somebody has to be woken up. The event mask checks are done without
+ * the lock, as in the other mode they are racy against ep_modify() and
+ * ep_send_events_proc() anyway.
+ */
+static int ep_poll_callback_staged(struct epitem *epi, void *key)
+{
+	struct eventpoll *ep = epi->ep;
+
+	if (!(epi->event.events & ~EP_PRIVATE_BITS))
+		return 1;
+	if (key && !((unsigned long) key & epi->event.events))
+		return 1;
+
+	/* Already staged, whoever did it takes care of the wakeup */
+	if (!ep_stage(ep, epi))
+		return 1;
+
+	/*
+	 * Pairs with set_current_state() in ep_poll(): either the waiter
+	 * sees the staged item, or we see the waiter.
+	 */
+	smp_mb();
+	if (!waitqueue_active(&ep->wq) && !waitqueue_active(&ep->poll_wait))
+		return 1;
+
+	if (ep->batch_ns)
+		ep_batch_wakeup(ep);
+	else
+		ep_wake_waiters(ep);
+
+	return 1;
+}
+
 /*
  * This is the callback that is passed to the wait queue wakeup
  * machanism. It is called by the stored file descriptors when they
@@ -790,6 +1038,9 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 
+	if (ep->staged)
+		return ep_poll_callback_staged(epi, key);
+
 	spin_lock_irqsave(&ep->lock, flags);
 
 	/*
@@ -828,6 +1079,12 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	if (!ep_is_linked(&epi->rdllink))
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 
+	if (ep->batch_ns) {
+		if (waitqueue_active(&ep->wq) || waitqueue_active(&ep->poll_wait))
+			ep_batch_wakeup(ep);
+		goto out_unlock;
+	}
+
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
@@ -982,10 +1239,7 @@ error_unregister:
 	 * list, since that is used/cleaned only inside a section bound by "mtx".
 	 * And ep_insert() is called with "mtx" held.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unlink_ready(ep, epi);
 
 	kmem_cache_free(epi_cache, epi);
 
@@ -1134,7 +1388,7 @@ retry:
 	spin_lock_irqsave(&ep->lock, flags);
 
 	res = 0;
-	if (list_empty(&ep->rdllist)) {
+	if (!ep_ready_pending(ep)) {
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
@@ -1150,7 +1404,7 @@ retry:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (!list_empty(&ep->rdllist) || timed_out)
+			if (ep_ready_pending(ep) || timed_out)
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
@@ -1168,7 +1422,7 @@ retry:
 		set_current_state(TASK_RUNNING);
 	}
 	/* Is it worth to try to dig for events ? */
-	eavail = !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	eavail = ep_ready_pending(ep) || ep->ovflist != EP_UNACTIVE_PTR;
 
 	spin_unlock_irqrestore(&ep->lock, flags);
 
@@ -119,6 +119,8 @@ static int ext2_create (struct inode * dir, struct dentry * dentry, int mode, st
 		inode->i_mapping->a_ops = &ext2_aops;
 		inode->i_fop = &ext2_file_operations;
 	}
+	if (!ext2_use_xip(inode->i_sb))
+		mapping_set_splice_move(inode->i_mapping);
 	mark_inode_dirty(inode);
 	return ext2_add_nondir(dentry, inode);
 }
@@ -1900,6 +1900,8 @@ void ext3_set_aops(struct inode *inode)
 		inode->i_mapping->a_ops = &ext3_writeback_aops;
 	else
 		inode->i_mapping->a_ops = &ext3_journalled_aops;
+	/* block_write_begin() takes an uptodate page as it finds it */
+	mapping_set_splice_move(inode->i_mapping);
 }
 
 /*
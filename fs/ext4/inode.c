@@ -4110,6 +4110,8 @@ void ext4_set_aops(struct inode *inode)
 		inode->i_mapping->a_ops = &ext4_writeback_aops;
 	else
 		inode->i_mapping->a_ops = &ext4_journalled_aops;
+	/* block_write_begin() takes an uptodate page as it finds it */
+	mapping_set_splice_move(inode->i_mapping);
 }
 
 /*
@@ -16,6 +16,7 @@
 #include <linux/writeback.h>
 #include <linux/buffer_head.h>
 #include <linux/falloc.h>
+#include <linux/fadvise.h>
 
 #include <asm/ioctls.h>
 
@@ -464,6 +465,8 @@ static int file_ioctl(struct file *filp, unsigned int cmd,
 	case FS_IOC_RESVSP:
 	case FS_IOC_RESVSP64:
 		return ioctl_preallocate(filp, p);
+	case FS_IOC_WILLNEED_RANGES:
+		return ioctl_willneed_ranges(filp, p);
 	}
 
 	return vfs_ioctl(filp, cmd, arg);
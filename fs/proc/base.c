@@ -368,6 +368,59 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 }
 #endif
 
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+/*
+ * Provides /proc/PID/wakeup_latency
+ */
+static int proc_pid_wakeup_latency(struct seq_file *m, struct pid_namespace *ns,
+				   struct pid *pid, struct task_struct *task)
+{
+	sched_show_wakeup_stats(m, &task->se.wakeup_stats);
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_RECLAIM_STATS
+/*
+ * Provides /proc/PID/reclaim_stall
+ */
+static int proc_pid_reclaim_stall(struct task_struct *task, char *buffer)
+{
+	struct reclaim_stall_stats *rs = &task->reclaim_stall;
+
+	return sprintf(buffer,
+		       "stalls %lu\ntotal_us %llu\nmax_us %llu\n"
+		       "lt1ms %u\nlt4ms %u\nlt16ms %u\nlt64ms %u\n"
+		       "lt256ms %u\nge256ms %u\n",
+		       rs->count,
+		       (unsigned long long)div_u64(rs->total_ns, NSEC_PER_USEC),
+		       (unsigned long long)div_u64(rs->max_ns, NSEC_PER_USEC),
+		       rs->hist[0], rs->hist[1], rs->hist[2],
+		       rs->hist[3], rs->hist[4], rs->hist[5]);
+}
+#endif
+
+#ifdef CONFIG_KSM
+/*
+ * Provides /proc/PID/ksm_stat
+ */
+static int proc_pid_ksm_stat(struct task_struct *task, char *buffer)
+{
+	struct mm_struct *mm = get_task_mm(task);
+	int len = 0;
+
+	if (mm) {
+		len = sprintf(buffer,
+			      "ksm_rmap_items %lu\nksm_merging_pages %lu\n"
+			      "ksm_unshared %lu\n",
+			      mm->ksm_rmap_items, mm->ksm_merging_pages,
+			      atomic_long_read(&mm->ksm_unshared));
+		mmput(mm);
+	}
+	return len;
+}
+#endif
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -2648,6 +2701,15 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	ONE("wakeup_latency", S_IRUGO, proc_pid_wakeup_latency),
+#endif
+#ifdef CONFIG_RECLAIM_STATS
+	INF("reclaim_stall", S_IRUGO, proc_pid_reclaim_stall),
+#endif
+#ifdef CONFIG_KSM
+	INF("ksm_stat",  S_IRUSR, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -2982,6 +3044,15 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	ONE("wakeup_latency", S_IRUGO, proc_pid_wakeup_latency),
+#endif
+#ifdef CONFIG_RECLAIM_STATS
+	INF("reclaim_stall", S_IRUGO, proc_pid_reclaim_stall),
+#endif
+#ifdef CONFIG_KSM
+	INF("ksm_stat",  S_IRUSR, proc_pid_ksm_stat),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -709,6 +709,96 @@ static int pipe_to_sendpage(struct pipe_inode_info *pipe,
 	return ret;
 }
 
+/*
+ * A stolen page may only go into the page cache if nothing but the pipe
+ * refers to it.
+ */
+static int pipe_to_file_check_page(struct pipe_buffer *buf, struct page *page)
+{
+	unsigned long allowed = 1 << PG_locked | 1 << PG_referenced |
+				1 << PG_uptodate;
+
+	/* stolen from another page cache, still on the LRU lists */
+	if (buf->flags & PIPE_BUF_FLAG_LRU)
+		allowed |= 1 << PG_lru | 1 << PG_active | 1 << PG_reclaim;
+
+	return page_mapcount(page) || page->mapping != NULL ||
+	       page_count(page) != 1 ||
+	       (page->flags & PAGE_FLAGS_CHECK_AT_PREP & ~allowed);
+}
+
+/*
+ * Move the page of @buf into the page cache of @mapping, so that
+ * pagecache_write_begin() finds it there and no copy is needed. Only
+ * full, page aligned buffers whose page the pipe can steal qualify, and
+ * only for filesystems that asked for it with mapping_set_splice_move():
+ * the page is added before ->write_begin() runs, which not every
+ * filesystem is prepared for. The page must also come from a zone the
+ * mapping allocates from.
+ *
+ * Must be called with the inode mutex of the target held. Returns 0 if
+ * the page has been moved.
+ */
+static int pipe_to_file_move(struct pipe_inode_info *pipe,
+			     struct pipe_buffer *buf, struct splice_desc *sd,
+			     struct address_space *mapping)
+{
+	gfp_t gfp_mask = mapping_gfp_mask(mapping);
+	struct page *page = buf->page;
+
+	if (!(sd->flags & SPLICE_F_MOVE) || buf->offset ||
+	    sd->len != PAGE_CACHE_SIZE || (sd->pos & ~PAGE_CACHE_MASK))
+		return 1;
+	if (!mapping_splice_move(mapping) ||
+	    page_zonenum(page) > gfp_zone(gfp_mask))
+		return 1;
+	if (buf->ops->steal(pipe, buf))
+		return 1;
+
+	/*
+	 * A gifted page is still an anon page on the LRU lists. Once its
+	 * owner has unmapped it, it can be turned into a page of our own;
+	 * while it is mapped the data is copied.
+	 */
+	if (PageAnon(page)) {
+		if (isolate_unmapped_anon_page(page))
+			goto out_unlock;
+		buf->flags &= ~PIPE_BUF_FLAG_LRU;
+	}
+
+	ClearPageMappedToDisk(page);
+	if (pipe_to_file_check_page(buf, page))
+		goto out_unlock;
+
+	/*
+	 * The contents are valid, mark the page uptodate before anybody
+	 * can see it, or a reader could read the old file data over it.
+	 * The buffer keeps its reference, the page cache takes another one.
+	 */
+	SetPageUptodate(page);
+	if (add_to_page_cache_locked(page, mapping, sd->pos >> PAGE_CACHE_SHIFT,
+				     gfp_mask & GFP_RECLAIM_MASK)) {
+		ClearPageUptodate(page);
+		goto out_unlock;
+	}
+	if (!(buf->flags & PIPE_BUF_FLAG_LRU))
+		lru_cache_add_file(page);
+	unlock_page(page);
+
+	/*
+	 * The page now belongs to the page cache, the pipe must not
+	 * recycle it when it drops its reference.
+	 */
+	buf->ops = &page_cache_pipe_buf_ops;
+	buf->flags |= PIPE_BUF_FLAG_LRU;
+
+	return 0;
+
+out_unlock:
+	unlock_page(page);
+	return 1;
+}
+
 /*
  * This is a little more tricky than the file -> pipe splicing. There are
  * basically three cases:
@@ -737,7 +827,7 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 	unsigned int offset, this_len;
 	struct page *page;
 	void *fsdata;
-	int ret;
+	int ret, moved;
 
 	/*
 	 * make sure the data in this buffer is uptodate
@@ -752,10 +842,21 @@ int pipe_to_file(struct pipe_inode_info *pipe, struct pipe_buffer *buf,
 	if (this_len + offset > PAGE_CACHE_SIZE)
 		this_len = PAGE_CACHE_SIZE - offset;
 
+	moved = !pipe_to_file_move(pipe, buf, sd, mapping);
+
 	ret = pagecache_write_begin(file, mapping, sd->pos, this_len,
 				AOP_FLAG_UNINTERRUPTIBLE, &page, &fsdata);
-	if (unlikely(ret))
+	if (unlikely(ret)) {
+		/*
+		 * The moved page is uptodate but never made it to the
+		 * file, don't leave it around in the page cache.
+		 */
+		if (moved)
+			invalidate_inode_pages2_range(mapping,
+					sd->pos >> PAGE_CACHE_SHIFT,
+					sd->pos >> PAGE_CACHE_SHIFT);
 		goto out;
+	}
 
 	if (buf->page != page) {
 		/*
@@ -1095,6 +1095,8 @@ static void yaffs_FillInodeFromObject(struct inode *inode, yaffs_Object *obj)
 			inode->i_fop = &yaffs_file_operations;
 			inode->i_mapping->a_ops =
 				&yaffs_file_address_operations;
+			/* a full uptodate page is written as it is */
+			mapping_set_splice_move(inode->i_mapping);
 			break;
 		case S_IFDIR:	/* directory */
 			inode->i_op = &yaffs_dir_inode_operations;
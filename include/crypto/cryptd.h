@@ -42,4 +42,7 @@ struct crypto_shash *cryptd_ahash_child(struct cryptd_ahash *tfm);
 struct shash_desc *cryptd_shash_desc(struct ahash_request *req);
 void cryptd_free_ahash(struct cryptd_ahash *tfm);
 
+/* returns the previous value, for tcrypt to compare batch sizes */
+unsigned int cryptd_set_batch(unsigned int batch);
+
 #endif
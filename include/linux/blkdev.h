@@ -28,6 +28,8 @@ struct request_queue;
 struct elevator_queue;
 struct request_pm_state;
 struct blk_trace;
+struct blk_latency_hist;
+struct blk_stage;
 struct request;
 struct sg_io_hdr;
 
@@ -195,7 +197,7 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
 #endif
@@ -432,6 +434,16 @@ struct request_queue
 	int			node;
 #ifdef CONFIG_BLK_DEV_IO_TRACE
 	struct blk_trace	*blk_trace;
+#endif
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_latency_hist	*latency_hist;
+#endif
+#ifdef CONFIG_BLK_PERCPU_STAGE
+	struct blk_stage __percpu *stage;
+	unsigned int		stage_batch;
+	struct mutex		stage_mutex;
+	struct timer_list	stage_timer;
+	struct work_struct	stage_work;
 #endif
 	/*
 	 * reserved for flush operations
@@ -466,6 +478,7 @@ struct request_queue
 #define QUEUE_FLAG_IO_STAT     15	/* do IO stats */
 #define QUEUE_FLAG_DISCARD     16	/* supports DISCARD */
 #define QUEUE_FLAG_NOXMERGES   17	/* No extended merges */
+#define QUEUE_FLAG_LAT_HIST    18	/* do latency histograms */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_STACKABLE)	|	\
@@ -1213,7 +1226,7 @@ static inline void put_dev_sector(Sector p)
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
 
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_LATENCY_HIST)
 /*
  * This should not be using sched_clock(). A real patch is in progress
  * to fix this up, until that is in place we need to disable preemption
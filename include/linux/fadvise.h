@@ -1,6 +1,8 @@
 #ifndef FADVISE_H_INCLUDED
 #define FADVISE_H_INCLUDED
 
+#include <linux/types.h>
+
 #define POSIX_FADV_NORMAL	0 /* No further special treatment.  */
 #define POSIX_FADV_RANDOM	1 /* Expect random page references.  */
 #define POSIX_FADV_SEQUENTIAL	2 /* Expect sequential page references.  */
@@ -18,4 +20,23 @@
 #define POSIX_FADV_NOREUSE	5 /* Data will be accessed once.  */
 #endif
 
+/*
+ * Linux specific: FS_IOC_WILLNEED_RANGES starts readahead on a list of
+ * ranges of a regular file in one call, e.g. to replay the accesses
+ * recorded during an earlier application launch.  Each range is handled
+ * like POSIX_FADV_WILLNEED.
+ */
+#define FADV_MAX_RANGES		1024
+
+struct fadvise_range {
+	__u64	offset;
+	__u64	len;
+};
+
+struct fadvise_ranges {
+	__u64	ranges;		/* user address of struct fadvise_range[] */
+	__u32	count;		/* number of ranges, at most FADV_MAX_RANGES */
+	__u32	flags;		/* must be zero */
+};
+
 #endif	/* FADVISE_H_INCLUDED */
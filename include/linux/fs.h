@@ -322,6 +322,7 @@ struct inodes_stat_t {
 #define	FS_IOC_GETVERSION		_IOR('v', 1, long)
 #define	FS_IOC_SETVERSION		_IOW('v', 2, long)
 #define FS_IOC_FIEMAP			_IOWR('f', 11, struct fiemap)
+#define FS_IOC_WILLNEED_RANGES		_IOW('f', 12, struct fadvise_ranges)
 #define FS_IOC32_GETFLAGS		_IOR('f', 1, int)
 #define FS_IOC32_SETFLAGS		_IOW('f', 2, int)
 #define FS_IOC32_GETVERSION		_IOR('v', 1, int)
@@ -899,6 +900,10 @@ struct file_ra_state {
 	unsigned int ra_pages;		/* Maximum readahead window */
 	unsigned int mmap_miss;		/* Cache miss stat for mmap accesses */
 	loff_t prev_pos;		/* Cache last read() position */
+
+	pgoff_t mmap_prev;		/* Last fault of a mmap stride */
+	long mmap_stride;		/* Distance between strided faults */
+	unsigned int mmap_stride_hits;	/* # of faults at that distance */
 };
 
 /*
@@ -1939,6 +1944,9 @@ extern char * getname(const char __user *);
 
 extern int ioctl_preallocate(struct file *filp, void __user *argp);
 
+/* mm/fadvise.c */
+extern int ioctl_willneed_ranges(struct file *filp, void __user *argp);
+
 /* fs/dcache.c */
 extern void __init vfs_caches_init_early(void);
 extern void __init vfs_caches_init(unsigned long);
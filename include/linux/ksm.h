@@ -24,9 +24,19 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+int ksm_enable_merge_any(struct mm_struct *mm);
+int ksm_disable_merge_any(struct mm_struct *mm);
+unsigned long ksm_vm_flags(struct mm_struct *mm, unsigned long vm_flags);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
+	mm->ksm_rmap_items = 0;
+	mm->ksm_merging_pages = 0;
+	atomic_long_set(&mm->ksm_unshared, 0);
+
+	/* PR_SET_MEMORY_MERGE is inherited by children, but not over exec */
+	if (test_bit(MMF_VM_MERGE_ANY, &oldmm->flags))
+		set_bit(MMF_VM_MERGE_ANY, &mm->flags);
 	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
 		return __ksm_enter(mm);
 	return 0;
@@ -55,6 +65,15 @@ static inline struct stable_node *page_stable_node(struct page *page)
 	return PageKsm(page) ? page_rmapping(page) : NULL;
 }
 
+/*
+ * Called when a write fault replaces @page by a private copy in @mm.
+ */
+static inline void ksm_account_unshare(struct mm_struct *mm, struct page *page)
+{
+	if (page && PageKsm(page))
+		atomic_long_inc(&mm->ksm_unshared);
+}
+
 static inline void set_page_stable_node(struct page *page,
 					struct stable_node *stable_node)
 {
@@ -92,6 +111,22 @@ void ksm_migrate_page(struct page *newpage, struct page *oldpage);
 
 #else  /* !CONFIG_KSM */
 
+static inline int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	return -EINVAL;
+}
+
+static inline int ksm_disable_merge_any(struct mm_struct *mm)
+{
+	return 0;
+}
+
+static inline unsigned long ksm_vm_flags(struct mm_struct *mm,
+					 unsigned long vm_flags)
+{
+	return vm_flags;
+}
+
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
 	return 0;
@@ -106,6 +141,10 @@ static inline int PageKsm(struct page *page)
 	return 0;
 }
 
+static inline void ksm_account_unshare(struct mm_struct *mm, struct page *page)
+{
+}
+
 #ifdef CONFIG_MMU
 static inline int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
@@ -1016,6 +1016,12 @@ struct shrinker {
 	/* These are for internal use */
 	struct list_head list;
 	long nr;	/* objs pending delete */
+#ifdef CONFIG_RECLAIM_STATS
+	unsigned long nr_calls;		/* shrink_slab() passes */
+	unsigned long nr_scanned;	/* objs asked to scan */
+	unsigned long nr_freed;		/* objs reported freed */
+	u64 time_ns;			/* time spent in ->shrink() */
+#endif
 };
 #define DEFAULT_SEEKS 2 /* A good number if you don't know better. */
 extern void register_shrinker(struct shrinker *);
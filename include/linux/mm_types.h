@@ -310,6 +310,12 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_KSM
+	/* Maintained by ksmd under ksm_thread_mutex */
+	unsigned long ksm_rmap_items;		/* pages tracked by ksmd */
+	unsigned long ksm_merging_pages;	/* pages mapping a KSM page */
+	atomic_long_t ksm_unshared;		/* KSM pages broken by COW */
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -375,6 +375,16 @@ struct zone {
 	 */
 	unsigned int inactive_ratio;
 
+	/* Evictions and activations, for refault distances */
+	atomic_long_t		inactive_age;
+
+#ifdef CONFIG_RECLAIM_STATS
+	/* Direct reclaim passes over this zone and the time they took */
+	unsigned long		reclaim_calls;
+	u64			reclaim_time_ns;
+	u64			reclaim_max_ns;
+#endif
+
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
@@ -23,6 +23,7 @@ enum mapping_flags {
 	AS_ENOSPC	= __GFP_BITS_SHIFT + 1,	/* ENOSPC on async write */
 	AS_MM_ALL_LOCKS	= __GFP_BITS_SHIFT + 2,	/* under mm_take_all_locks() */
 	AS_UNEVICTABLE	= __GFP_BITS_SHIFT + 3,	/* e.g., ramdisk, SHM_LOCK */
+	AS_SPLICE_MOVE	= __GFP_BITS_SHIFT + 4,	/* takes pages by SPLICE_F_MOVE */
 };
 
 static inline void mapping_set_error(struct address_space *mapping, int error)
@@ -52,6 +53,21 @@ static inline int mapping_unevictable(struct address_space *mapping)
 	return !!mapping;
 }
 
+/*
+ * Set by filesystems whose ->write_begin() copes with finding an uptodate
+ * page without private data in the page cache that it did not add itself,
+ * so that splice can move pipe pages into it instead of copying them.
+ */
+static inline void mapping_set_splice_move(struct address_space *mapping)
+{
+	set_bit(AS_SPLICE_MOVE, &mapping->flags);
+}
+
+static inline int mapping_splice_move(struct address_space *mapping)
+{
+	return test_bit(AS_SPLICE_MOVE, &mapping->flags);
+}
+
 static inline gfp_t mapping_gfp_mask(struct address_space * mapping)
 {
 	return (__force gfp_t)mapping->flags & __GFP_BITS_MASK;
@@ -102,4 +102,12 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Let KSM merge every compatible anonymous area of the process, as if
+ * it had all been madvised MADV_MERGEABLE.  Inherited across fork,
+ * cleared by exec.  Numbered as in mainline, 35-66 are taken there.
+ */
+#define PR_SET_MEMORY_MERGE	67
+#define PR_GET_MEMORY_MERGE	68
+
 #endif /* _LINUX_PRCTL_H */
@@ -435,6 +435,7 @@ extern int get_dumpable(struct mm_struct *mm);
 #endif
 					/* leave room for more dump flags */
 #define MMF_VM_MERGEABLE	16	/* KSM may merge identical pages */
+#define MMF_VM_MERGE_ANY	17	/* KSM may merge any compatible vma */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -756,6 +757,33 @@ struct task_delay_info {
 };
 #endif	/* CONFIG_TASK_DELAY_ACCT */
 
+#ifdef CONFIG_RECLAIM_STATS
+#define NR_RECLAIM_STALL_BUCKETS	6
+
+struct reclaim_stall_stats {
+	unsigned long	count;		/* # of direct reclaim stalls */
+	u64		total_ns;	/* time spent in direct reclaim */
+	u64		max_ns;		/* longest single stall */
+	/* stalls of <1, <4, <16, <64, <256 and >= 256 msecs */
+	unsigned int	hist[NR_RECLAIM_STALL_BUCKETS];
+};
+#endif
+
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+#define NR_WAKEUP_LATENCY_BUCKETS	16
+
+struct sched_wakeup_stats {
+	unsigned long	count;		/* # of wakeups that got to run */
+	u64		total_ns;	/* time from wakeup to running */
+	u64		max_ns;		/* longest single wait */
+	/* <1 usec, <2^i usecs for i = 1..14, and >= 16384 usecs */
+	unsigned int	hist[NR_WAKEUP_LATENCY_BUCKETS];
+};
+
+extern void sched_show_wakeup_stats(struct seq_file *m,
+				    struct sched_wakeup_stats *ws);
+#endif
+
 static inline int sched_info_on(void)
 {
 #ifdef CONFIG_SCHEDSTATS
@@ -1138,6 +1166,11 @@ struct sched_entity {
 	struct sched_statistics statistics;
 #endif
 
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	u64			wakeup_start;	/* rq clock at wakeup, 0 if none */
+	struct sched_wakeup_stats wakeup_stats;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct sched_entity	*parent;
 	/* rq on which this entity is (to be) queued: */
@@ -1454,6 +1487,9 @@ struct task_struct {
 #ifdef	CONFIG_TASK_DELAY_ACCT
 	struct task_delay_info *delays;
 #endif
+#ifdef CONFIG_RECLAIM_STATS
+	struct reclaim_stall_stats reclaim_stall;
+#endif
 #ifdef CONFIG_FAULT_INJECTION
 	int make_it_fail;
 #endif
@@ -1902,6 +1938,10 @@ int sched_rt_handler(struct ctl_table *table, int write,
 
 extern unsigned int sysctl_sched_compat_yield;
 
+#ifdef CONFIG_CFS_BANDWIDTH
+extern unsigned int sysctl_sched_cfs_bandwidth_slice;
+#endif
+
 #ifdef CONFIG_RT_MUTEXES
 extern int rt_mutex_getprio(struct task_struct *p);
 extern void rt_mutex_setprio(struct task_struct *p, int prio);
@@ -53,6 +53,9 @@ struct kmem_cache {
 	unsigned int batchcount;
 	unsigned int limit;
 	unsigned int shared;
+	unsigned int tune_base;		/* limit picked at creation */
+	unsigned int tune_max;		/* upper bound for auto-tuning */
+	long tune_charge;		/* bytes taken from the tune budget */
 
 	unsigned int buffer_size;
 	u32 reciprocal_buffer_size;
@@ -97,6 +100,8 @@ struct kmem_cache {
 	atomic_t allocmiss;
 	atomic_t freehit;
 	atomic_t freemiss;
+	unsigned long tune_grown;
+	unsigned long tune_shrunk;
 
 	/*
 	 * If debugging is enabled, then the allocator can add additional
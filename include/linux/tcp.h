@@ -438,8 +438,15 @@ struct tcp_sock {
 		int	space;
 		u32	seq;
 		u32	time;
+		u32	rate;	/* delivery rate, bytes per second */
 	} rcvq_space;
 
+/* sk_rcvbuf and sk_sndbuf above tcp_rmem[2] and tcp_wmem[2], charged to
+ * tcp_autotune_allocated
+ */
+	u32	rcvbuf_over;
+	u32	sndbuf_over;
+
 /* TCP-specific MTU probe information. */
 	struct {
 		u32		  probe_seq_start;
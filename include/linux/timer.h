@@ -27,6 +27,7 @@ struct timer_list {
 	void *start_site;
 	char start_comm[16];
 	int start_pid;
+	unsigned long start_expires;	/* expiry asked for, before slack */
 #endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
@@ -172,6 +173,7 @@ extern int mod_timer_pending(struct timer_list *timer, unsigned long expires);
 extern int mod_timer_pinned(struct timer_list *timer, unsigned long expires);
 
 extern void set_timer_slack(struct timer_list *time, int slack_hz);
+extern int sysctl_timer_coalescing;
 
 #define TIMER_NOT_PINNED	0
 #define TIMER_PINNED		1
@@ -196,6 +198,7 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+#define TIMER_STATS_FLAG_COALESCED	0x2
 
 extern void init_timer_stats(void);
 
@@ -43,6 +43,12 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+#ifdef CONFIG_RECLAIM_STATS
+		ALLOCSTALL_LT1MS, ALLOCSTALL_LT4MS, ALLOCSTALL_LT16MS,
+		ALLOCSTALL_LT64MS, ALLOCSTALL_LT256MS, ALLOCSTALL_GE256MS,
+		ALLOCSTALL_MS,
+#endif
+		WORKINGSET_REFAULT, WORKINGSET_ACTIVATE,
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
@@ -30,6 +30,7 @@ struct unix_skb_parms {
 #ifdef CONFIG_SECURITY_NETWORK
 	u32			secid;		/* Security ID		*/
 #endif
+	u32			consumed;	/* Stream bytes read	*/
 };
 
 #define UNIXCB(skb) 	(*(struct unix_skb_parms *)&((skb)->cb))
@@ -42,6 +43,8 @@ struct unix_skb_parms {
 				SINGLE_DEPTH_NESTING)
 
 #ifdef __KERNEL__
+struct unix_stream_post;
+
 /* The AF_UNIX socket */
 struct unix_sock {
 	/* WARNING: sk has to be the first member */
@@ -59,6 +62,7 @@ struct unix_sock {
 	unsigned int		gc_maybe_cycle : 1;
 	unsigned char		recursion_level;
 	struct socket_wq	peer_wq;
+	struct unix_stream_post	*post;		/* Reader's posted buffer */
 };
 #define unix_sk(__sk) ((struct unix_sock *)__sk)
 
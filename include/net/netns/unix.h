@@ -7,6 +7,7 @@
 struct ctl_table_header;
 struct netns_unix {
 	int			sysctl_max_dgram_qlen;
+	int			sysctl_dgram_wake_coalesce;
 	struct ctl_table_header	*ctl;
 };
 
@@ -236,6 +236,7 @@ extern int sysctl_tcp_low_latency;
 extern int sysctl_tcp_dma_copybreak;
 extern int sysctl_tcp_nometrics_save;
 extern int sysctl_tcp_moderate_rcvbuf;
+extern int sysctl_tcp_rtt_autotune;
 extern int sysctl_tcp_tso_win_divisor;
 extern int sysctl_tcp_abc;
 extern int sysctl_tcp_mtu_probing;
@@ -1019,6 +1020,52 @@ static inline int tcp_full_space(const struct sock *sk)
 	return tcp_win_from_space(sk->sk_rcvbuf); 
 }
 
+/* With tcp_rtt_autotune, buffers follow the measured bandwidth-delay
+ * product past tcp_rmem[2]/tcp_wmem[2].  What all sockets hold above
+ * those limits together is bounded by a quarter of tcp_mem[0].
+ */
+extern atomic_long_t tcp_autotune_allocated;
+extern int tcp_autotune_grow(int *buf, int size, int fixed, u32 *over);
+
+static inline long tcp_autotune_budget(void)
+{
+	return (long)sysctl_tcp_mem[0] << (PAGE_SHIFT - 2);
+}
+
+/* Largest buffer a socket could get, for picking the window scale */
+static inline int tcp_autotune_max(int fixed)
+{
+	if (!sysctl_tcp_rtt_autotune)
+		return fixed;
+	return min_t(long, (long)fixed + tcp_autotune_budget(), INT_MAX / 2);
+}
+
+/* Largest buffer a socket holding @over above @fixed could grow to now */
+static inline int tcp_autotune_limit(int fixed, u32 over)
+{
+	long room;
+
+	if (!sysctl_tcp_rtt_autotune)
+		return fixed + over;
+
+	room = tcp_autotune_budget() -
+	       atomic_long_read(&tcp_autotune_allocated);
+	return min_t(long, (long)fixed + over + max(room, 0L), INT_MAX / 2);
+}
+
+static inline int tcp_rmem_limit(const struct sock *sk)
+{
+	return tcp_autotune_limit(sysctl_tcp_rmem[2], tcp_sk(sk)->rcvbuf_over);
+}
+
+static inline void tcp_autotune_release(struct tcp_sock *tp)
+{
+	atomic_long_sub(tp->rcvbuf_over + tp->sndbuf_over,
+			&tcp_autotune_allocated);
+	tp->rcvbuf_over = 0;
+	tp->sndbuf_over = 0;
+}
+
 static inline void tcp_openreq_init(struct request_sock *req,
 				    struct tcp_options_received *rx_opt,
 				    struct sk_buff *skb)
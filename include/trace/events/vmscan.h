@@ -0,0 +1,114 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vmscan
+
+#if !defined(_TRACE_VMSCAN_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_VMSCAN_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mm_vmscan_direct_reclaim_begin,
+
+	TP_PROTO(int order, gfp_t gfp_flags),
+
+	TP_ARGS(order, gfp_flags),
+
+	TP_STRUCT__entry(
+		__field(	int,		order		)
+		__field(	gfp_t,		gfp_flags	)
+	),
+
+	TP_fast_assign(
+		__entry->order		= order;
+		__entry->gfp_flags	= gfp_flags;
+	),
+
+	TP_printk("order=%d gfp_flags=0x%x",
+		__entry->order,
+		__entry->gfp_flags)
+);
+
+TRACE_EVENT(mm_vmscan_direct_reclaim_end,
+
+	TP_PROTO(unsigned long nr_reclaimed, u64 delay_ns),
+
+	TP_ARGS(nr_reclaimed, delay_ns),
+
+	TP_STRUCT__entry(
+		__field(	unsigned long,	nr_reclaimed	)
+		__field(	u64,		delay_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->delay_ns	= delay_ns;
+	),
+
+	TP_printk("nr_reclaimed=%lu delay_ns=%llu",
+		__entry->nr_reclaimed,
+		(unsigned long long)__entry->delay_ns)
+);
+
+TRACE_EVENT(mm_vmscan_zone_reclaim,
+
+	TP_PROTO(struct zone *zone, int priority, unsigned long nr_reclaimed,
+		 u64 delay_ns),
+
+	TP_ARGS(zone, priority, nr_reclaimed, delay_ns),
+
+	TP_STRUCT__entry(
+		__field(	int,		nid		)
+		__field(	int,		zid		)
+		__field(	int,		priority	)
+		__field(	unsigned long,	nr_reclaimed	)
+		__field(	u64,		delay_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->nid		= zone_to_nid(zone);
+		__entry->zid		= zone_idx(zone);
+		__entry->priority	= priority;
+		__entry->nr_reclaimed	= nr_reclaimed;
+		__entry->delay_ns	= delay_ns;
+	),
+
+	TP_printk("nid=%d zid=%d priority=%d nr_reclaimed=%lu delay_ns=%llu",
+		__entry->nid,
+		__entry->zid,
+		__entry->priority,
+		__entry->nr_reclaimed,
+		(unsigned long long)__entry->delay_ns)
+);
+
+TRACE_EVENT(mm_shrink_slab,
+
+	TP_PROTO(struct shrinker *shrinker, unsigned long nr_scanned,
+		 unsigned long nr_freed, u64 delay_ns),
+
+	TP_ARGS(shrinker, nr_scanned, nr_freed, delay_ns),
+
+	TP_STRUCT__entry(
+		__field(	void *,		shrink		)
+		__field(	unsigned long,	nr_scanned	)
+		__field(	unsigned long,	nr_freed	)
+		__field(	u64,		delay_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->shrink		= shrinker->shrink;
+		__entry->nr_scanned	= nr_scanned;
+		__entry->nr_freed	= nr_freed;
+		__entry->delay_ns	= delay_ns;
+	),
+
+	TP_printk("%pF nr_scanned=%lu nr_freed=%lu delay_ns=%llu",
+		__entry->shrink,
+		__entry->nr_scanned,
+		__entry->nr_freed,
+		(unsigned long long)__entry->delay_ns)
+);
+
+#endif /* _TRACE_VMSCAN_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -1087,6 +1087,9 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 
 	task_io_accounting_init(&p->ioac);
 	acct_clear_integrals(p);
+#ifdef CONFIG_RECLAIM_STATS
+	memset(&p->reclaim_stall, 0, sizeof(p->reclaim_stall));
+#endif
 
 	posix_cpu_timers_init(p);
 
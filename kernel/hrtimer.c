@@ -774,13 +774,22 @@ static inline void timer_stats_hrtimer_clear_start_info(struct hrtimer *timer)
 #endif
 }
 
-static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
+/*
+ * A timer that runs before its hard expiry was pulled into an earlier
+ * wakeup by its slack, and did not need one of its own.
+ */
+static inline void timer_stats_account_hrtimer(struct hrtimer *timer,
+					       ktime_t now)
 {
 #ifdef CONFIG_TIMER_STATS
+	int saved;
+
 	if (likely(!timer_stats_active))
 		return;
+	saved = now.tv64 < hrtimer_get_expires_tv64(timer);
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
-				 timer->function, timer->start_comm, 0);
+				 timer->function, timer->start_comm,
+				 saved ? TIMER_STATS_FLAG_COALESCED : 0);
 #endif
 }
 
@@ -1036,6 +1045,8 @@ EXPORT_SYMBOL_GPL(hrtimer_start_range_ns);
  * @tim:	expiry time
  * @mode:	expiry mode: absolute (HRTIMER_ABS) or relative (HRTIMER_REL)
  *
+ * The timer may expire up to the slack set by hrtimer_set_slack() late.
+ *
  * Returns:
  *  0 on success
  *  1 when the timer was active
@@ -1043,10 +1054,28 @@ EXPORT_SYMBOL_GPL(hrtimer_start_range_ns);
 int
 hrtimer_start(struct hrtimer *timer, ktime_t tim, const enum hrtimer_mode mode)
 {
-	return __hrtimer_start_range_ns(timer, tim, 0, mode, 1);
+	unsigned long delta_ns = sysctl_timer_coalescing ? timer->slack : 0;
+
+	return __hrtimer_start_range_ns(timer, tim, delta_ns, mode, 1);
 }
 EXPORT_SYMBOL_GPL(hrtimer_start);
 
+/**
+ * hrtimer_set_slack - set the default expiry range of an hrtimer
+ * @timer:	the timer to be modified
+ * @slack_ns:	how late, in ns, the timer may expire
+ *
+ * hrtimer_start() arms the timer as if hrtimer_start_range_ns() had
+ * been called with @slack_ns, so its expiry can be batched with other
+ * timers expiring up to @slack_ns later.  The slack is ignored while
+ * kernel.timer_coalescing is cleared.
+ */
+void hrtimer_set_slack(struct hrtimer *timer, unsigned long slack_ns)
+{
+	timer->slack = slack_ns;
+}
+EXPORT_SYMBOL_GPL(hrtimer_set_slack);
+
 
 /**
  * hrtimer_try_to_cancel - try to deactivate a timer
@@ -1220,7 +1249,7 @@ static void __run_hrtimer(struct hrtimer *timer, ktime_t *now)
 
 	debug_deactivate(timer);
 	__remove_hrtimer(timer, base, HRTIMER_STATE_CALLBACK, 0);
-	timer_stats_account_hrtimer(timer);
+	timer_stats_account_hrtimer(timer, *now);
 	fn = timer->function;
 
 	/*
@@ -658,6 +658,10 @@ static int __init wakelocks_init(void)
 	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
 		INIT_LIST_HEAD(&active_wake_locks[i]);
 
+	/* expiring a little late only delays suspend, let them batch */
+	set_timer_slack(&expire_timer, HZ / 20);
+	set_timer_slack(&suspend_exception_timer, HZ);
+
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
 			"deleted_wake_locks");
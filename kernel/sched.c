@@ -229,6 +229,25 @@ static void destroy_rt_bandwidth(struct rt_bandwidth *rt_b)
 }
 #endif
 
+struct cfs_bandwidth {
+#ifdef CONFIG_CFS_BANDWIDTH
+	/* nests inside the rq lock: */
+	raw_spinlock_t		lock;
+	ktime_t			period;
+	u64			quota;
+	/* runtime left in the current period, handed out in slices */
+	u64			runtime;
+
+	int			idle, timer_active;
+	struct hrtimer		period_timer;
+	struct list_head	throttled_cfs_rq;
+
+	/* statistics */
+	int			nr_periods, nr_throttled;
+	u64			throttled_time;
+#endif
+};
+
 /*
  * sched_domains_mutex serializes calls to arch_init_sched_domains,
  * detach_destroy_domains and partition_sched_domains.
@@ -253,6 +272,8 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+
+	struct cfs_bandwidth cfs_bandwidth;
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -262,6 +283,10 @@ struct task_group {
 	struct rt_bandwidth rt_bandwidth;
 #endif
 
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	struct sched_wakeup_stats __percpu *wakeup_stats;
+#endif
+
 	struct rcu_head rcu;
 	struct list_head list;
 
@@ -312,7 +337,7 @@ struct task_group init_task_group;
 /* CFS-related fields in a runqueue */
 struct cfs_rq {
 	struct load_weight load;
-	unsigned long nr_running;
+	unsigned long nr_running, h_nr_running;
 
 	u64 exec_clock;
 	u64 min_vruntime;
@@ -369,6 +394,19 @@ struct cfs_rq {
 	 */
 	unsigned long rq_weight;
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	/*
+	 * runtime_remaining is what this cpu may still run of the group's
+	 * quota before it has to go back to the task_group for another
+	 * slice; it goes negative while the cfs_rq is throttled.
+	 */
+	int runtime_enabled;
+	s64 runtime_remaining;
+
+	u64 throttled_timestamp;
+	int throttled;
+	struct list_head throttled_list;
+#endif
 #endif
 };
 
@@ -1868,7 +1906,6 @@ static void activate_task(struct rq *rq, struct task_struct *p, int flags)
 		rq->nr_uninterruptible--;
 
 	enqueue_task(rq, p, flags);
-	inc_nr_running(rq);
 }
 
 /*
@@ -1880,7 +1917,6 @@ static void deactivate_task(struct rq *rq, struct task_struct *p, int flags)
 		rq->nr_uninterruptible++;
 
 	dequeue_task(rq, p, flags);
-	dec_nr_running(rq);
 }
 
 #include "sched_idletask.c"
@@ -2353,6 +2389,7 @@ out_activate:
 	else
 		schedstat_inc(p, se.statistics.nr_wakeups_remote);
 	activate_task(rq, p, en_flags);
+	sched_wakeup_start(rq, p);
 	success = 1;
 
 out_running:
@@ -2420,6 +2457,10 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	p->se.wakeup_start = 0;
+	memset(&p->se.wakeup_stats, 0, sizeof(p->se.wakeup_stats));
+#endif
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 	p->se.on_rq = 0;
@@ -3741,6 +3782,7 @@ need_resched_nonpreemptible:
 
 	if (likely(prev != next)) {
 		sched_info_switch(prev, next);
+		sched_wakeup_end(rq, next);
 		perf_event_task_sched_out(prev, next);
 
 		rq->nr_switches++;
@@ -7597,6 +7639,7 @@ static void init_cfs_rq(struct cfs_rq *cfs_rq, struct rq *rq)
 	cfs_rq->rq = rq;
 #endif
 	cfs_rq->min_vruntime = (u64)(-(1LL << 20));
+	init_cfs_rq_runtime(cfs_rq);
 }
 
 static void init_rt_rq(struct rt_rq *rt_rq, struct rq *rq)
@@ -7746,9 +7789,18 @@ void __init sched_init(void)
 			global_rt_period(), global_rt_runtime());
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	init_cfs_bandwidth(&init_task_group.cfs_bandwidth);
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 	list_add(&init_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&init_task_group.children);
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	init_task_group.wakeup_stats = alloc_percpu(struct sched_wakeup_stats);
+	/* every wakeup is charged to it, there is no going on without */
+	BUG_ON(!init_task_group.wakeup_stats);
+#endif
 
 #endif /* CONFIG_CGROUP_SCHED */
 
@@ -8033,6 +8085,9 @@ static void free_fair_sched_group(struct task_group *tg)
 {
 	int i;
 
+	/* the period timer walks the throttled cfs_rqs */
+	destroy_cfs_bandwidth(&tg->cfs_bandwidth);
+
 	for_each_possible_cpu(i) {
 		if (tg->cfs_rq)
 			kfree(tg->cfs_rq[i]);
@@ -8052,6 +8107,8 @@ int alloc_fair_sched_group(struct task_group *tg, struct task_group *parent)
 	struct rq *rq;
 	int i;
 
+	init_cfs_bandwidth(&tg->cfs_bandwidth);
+
 	tg->cfs_rq = kzalloc(sizeof(cfs_rq) * nr_cpu_ids, GFP_KERNEL);
 	if (!tg->cfs_rq)
 		goto err;
@@ -8093,6 +8150,7 @@ static inline void register_fair_sched_group(struct task_group *tg, int cpu)
 
 static inline void unregister_fair_sched_group(struct task_group *tg, int cpu)
 {
+	unthrottle_offline_cfs_rq(tg->cfs_rq[cpu]);
 	list_del_rcu(&tg->cfs_rq[cpu]->leaf_cfs_rq_list);
 }
 #else /* !CONFG_FAIR_GROUP_SCHED */
@@ -8210,6 +8268,9 @@ static void free_sched_group(struct task_group *tg)
 {
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	free_percpu(tg->wakeup_stats);
+#endif
 	kfree(tg);
 }
 
@@ -8230,6 +8291,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	tg->wakeup_stats = alloc_percpu(struct sched_wakeup_stats);
+	if (!tg->wakeup_stats)
+		goto err;
+#endif
+
 	spin_lock_irqsave(&task_group_lock, flags);
 	for_each_possible_cpu(i) {
 		register_fair_sched_group(tg, i);
@@ -8682,6 +8749,23 @@ int sched_rt_handler(struct ctl_table *table, int write,
 	return ret;
 }
 
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+/*
+ * Shared by /proc/<pid>/wakeup_latency and cpu.wakeup_latency.
+ */
+void sched_show_wakeup_stats(struct seq_file *m, struct sched_wakeup_stats *ws)
+{
+	int i;
+
+	seq_printf(m, "wakeups %lu\ntotal_us %llu\nmax_us %llu\n", ws->count,
+		   (unsigned long long)div_u64(ws->total_ns, NSEC_PER_USEC),
+		   (unsigned long long)div_u64(ws->max_ns, NSEC_PER_USEC));
+	for (i = 0; i < NR_WAKEUP_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, "lt%uus %u\n", 1U << i, ws->hist[i]);
+	seq_printf(m, "ge%uus %u\n", 1U << (i - 1), ws->hist[i]);
+}
+#endif
+
 #ifdef CONFIG_CGROUP_SCHED
 
 /* return corresponding task_group object of a cgroup */
@@ -8793,6 +8877,178 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Serializes updates of a task group's bandwidth settings.
+ */
+static DEFINE_MUTEX(cfs_constraints_mutex);
+
+static const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC; /* 1s */
+static const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC; /* 1ms */
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(tg);
+	int i, runtime_enabled;
+
+	/* the root group always runs unconstrained */
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	/*
+	 * Ensure we have at least some amount of bandwidth every period,
+	 * and that the period is short enough for the timer to be of use.
+	 */
+	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
+		return -EINVAL;
+
+	if (period > max_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	runtime_enabled = quota != RUNTIME_INF;
+
+	raw_spin_lock_irq(&cfs_b->lock);
+	cfs_b->period = ns_to_ktime(period);
+	cfs_b->quota = quota;
+	cfs_b->runtime = quota;
+	raw_spin_unlock_irq(&cfs_b->lock);
+
+	for_each_possible_cpu(i) {
+		struct cfs_rq *cfs_rq = tg->cfs_rq[i];
+		struct rq *rq = cpu_rq(i);
+
+		raw_spin_lock_irq(&rq->lock);
+		cfs_rq->runtime_enabled = runtime_enabled;
+		cfs_rq->runtime_remaining = 0;
+
+		if (cfs_rq_throttled(cfs_rq)) {
+			update_rq_clock(rq);
+			unthrottle_cfs_rq(cfs_rq);
+		}
+		raw_spin_unlock_irq(&rq->lock);
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+static int tg_set_cfs_quota(struct task_group *tg, s64 cfs_quota_us)
+{
+	u64 quota, period;
+
+	period = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+	else if (cfs_quota_us > div_u64(RUNTIME_INF, NSEC_PER_USEC))
+		return -EINVAL;
+	else
+		quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static s64 tg_get_cfs_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg_cfs_bandwidth(tg)->quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg_cfs_bandwidth(tg)->quota;
+	do_div(quota_us, NSEC_PER_USEC);
+	return quota_us;
+}
+
+static int tg_set_cfs_period(struct task_group *tg, u64 cfs_period_us)
+{
+	u64 quota, period;
+
+	if (cfs_period_us > div_u64(max_cfs_quota_period, NSEC_PER_USEC))
+		return -EINVAL;
+
+	period = cfs_period_us * NSEC_PER_USEC;
+	quota = tg_cfs_bandwidth(tg)->quota;
+
+	return tg_set_cfs_bandwidth(tg, period, quota);
+}
+
+static u64 tg_get_cfs_period(struct task_group *tg)
+{
+	u64 cfs_period_us;
+
+	cfs_period_us = ktime_to_ns(tg_cfs_bandwidth(tg)->period);
+	do_div(cfs_period_us, NSEC_PER_USEC);
+	return cfs_period_us;
+}
+
+static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_quota_write_s64(struct cgroup *cgrp, struct cftype *cftype,
+				   s64 cfs_quota_us)
+{
+	return tg_set_cfs_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static u64 cpu_cfs_period_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return tg_get_cfs_period(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+				    u64 cfs_period_us)
+{
+	return tg_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
+}
+
+static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
+			  struct cgroup_map_cb *cb)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cgroup_tg(cgrp));
+	int nr_periods, nr_throttled;
+	u64 throttled_time;
+
+	raw_spin_lock_irq(&cfs_b->lock);
+	nr_periods = cfs_b->nr_periods;
+	nr_throttled = cfs_b->nr_throttled;
+	throttled_time = cfs_b->throttled_time;
+	raw_spin_unlock_irq(&cfs_b->lock);
+
+	cb->fill(cb, "nr_periods", nr_periods);
+	cb->fill(cb, "nr_throttled", nr_throttled);
+	cb->fill(cb, "throttled_time", throttled_time);
+
+	return 0;
+}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+static int cpu_wakeup_latency_show(struct cgroup *cgrp, struct cftype *cft,
+				   struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	struct sched_wakeup_stats sum;
+	int cpu, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct sched_wakeup_stats *ws = per_cpu_ptr(tg->wakeup_stats, cpu);
+
+		sum.count += ws->count;
+		sum.total_ns += ws->total_ns;
+		sum.max_ns = max(sum.max_ns, ws->max_ns);
+		for (i = 0; i < NR_WAKEUP_LATENCY_BUCKETS; i++)
+			sum.hist[i] += ws->hist[i];
+	}
+	sched_show_wakeup_stats(m, &sum);
+
+	return 0;
+}
+#endif /* CONFIG_SCHED_WAKEUP_STATS */
+
 #ifdef CONFIG_RT_GROUP_SCHED
 static int cpu_rt_runtime_write(struct cgroup *cgrp, struct cftype *cft,
 				s64 val)
@@ -8825,6 +9081,22 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_CFS_BANDWIDTH
+	{
+		.name = "cfs_quota_us",
+		.read_s64 = cpu_cfs_quota_read_s64,
+		.write_s64 = cpu_cfs_quota_write_s64,
+	},
+	{
+		.name = "cfs_period_us",
+		.read_u64 = cpu_cfs_period_read_u64,
+		.write_u64 = cpu_cfs_period_write_u64,
+	},
+	{
+		.name = "stat",
+		.read_map = cpu_stats_show,
+	},
+#endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
 		.name = "rt_runtime_us",
@@ -8837,6 +9109,12 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+	{
+		.name = "wakeup_latency",
+		.read_seq_string = cpu_wakeup_latency_show,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
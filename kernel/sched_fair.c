@@ -516,6 +516,10 @@ __update_curr(struct cfs_rq *cfs_rq, struct sched_entity *curr,
 	update_min_vruntime(cfs_rq);
 }
 
+static __always_inline void
+account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec);
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq);
+
 static void update_curr(struct cfs_rq *cfs_rq)
 {
 	struct sched_entity *curr = cfs_rq->curr;
@@ -544,6 +548,8 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
 	}
+
+	account_cfs_rq_runtime(cfs_rq, delta_exec);
 }
 
 static inline void
@@ -782,6 +788,10 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	check_spread(cfs_rq, se);
 	if (se != cfs_rq->curr)
 		__enqueue_entity(cfs_rq, se);
+
+	/* a cfs_rq that has run out of runtime must not become runnable */
+	if (cfs_rq->nr_running == 1)
+		check_cfs_rq_runtime(cfs_rq);
 }
 
 static void __clear_buddies(struct cfs_rq *cfs_rq, struct sched_entity *se)
@@ -942,6 +952,9 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 	if (prev->on_rq)
 		update_curr(cfs_rq);
 
+	/* throttle cfs_rqs that have exceeded their runtime */
+	check_cfs_rq_runtime(cfs_rq);
+
 	check_spread(cfs_rq, prev);
 	if (prev->on_rq) {
 		update_stats_wait_start(cfs_rq, prev);
@@ -980,6 +993,362 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 		check_preempt_tick(cfs_rq, curr);
 }
 
+/**************************************************
+ * CFS bandwidth control machinery
+ *
+ * Each task_group with a quota owns a pool of runtime that is refilled
+ * every period by cfs_b->period_timer.  The per-cpu cfs_rqs of the group
+ * draw from it a slice at a time, so the global lock is only taken once
+ * every sysctl_sched_cfs_bandwidth_slice of execution.  A cfs_rq that
+ * cannot get more runtime is throttled: its entity is taken off the
+ * parent and the cfs_rq is queued on cfs_b->throttled_cfs_rq until the
+ * period timer hands out fresh runtime.
+ */
+
+#ifdef CONFIG_CFS_BANDWIDTH
+/*
+ * Amount of runtime a cfs_rq takes from the task_group pool at a time.
+ * (default: 5 msec, units: microseconds)
+ */
+unsigned int sysctl_sched_cfs_bandwidth_slice = 5000UL;
+
+/* default period: 100 msec, units: nanoseconds */
+static inline u64 default_cfs_period(void)
+{
+	return 100000000ULL;
+}
+
+static inline u64 sched_cfs_bandwidth_slice(void)
+{
+	return (u64)sysctl_sched_cfs_bandwidth_slice * NSEC_PER_USEC;
+}
+
+static inline struct cfs_bandwidth *tg_cfs_bandwidth(struct task_group *tg)
+{
+	return &tg->cfs_bandwidth;
+}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return cfs_rq->throttled;
+}
+
+/*
+ * Called with cfs_b->lock held.  The timer is only started when it is
+ * known to be idle, so we never race with its callback restarting it.
+ * The rq lock may be held as well, hence no softirq wakeup.
+ */
+static void start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	if (cfs_b->timer_active)
+		return;
+
+	cfs_b->timer_active = 1;
+	__hrtimer_start_range_ns(&cfs_b->period_timer, cfs_b->period, 0,
+				 HRTIMER_MODE_REL_PINNED, 0);
+}
+
+/*
+ * Top up cfs_rq->runtime_remaining to a slice from the group pool.
+ * Returns non-zero if the cfs_rq has runtime left afterwards.
+ */
+static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	u64 amount = 0, min_amount;
+
+	/* note: this is a positive sum, runtime_remaining <= 0 */
+	min_amount = sched_cfs_bandwidth_slice() - cfs_rq->runtime_remaining;
+
+	raw_spin_lock(&cfs_b->lock);
+	if (cfs_b->quota == RUNTIME_INF) {
+		amount = min_amount;
+	} else {
+		start_cfs_bandwidth(cfs_b);
+
+		if (cfs_b->runtime > 0) {
+			amount = min(cfs_b->runtime, min_amount);
+			cfs_b->runtime -= amount;
+			cfs_b->idle = 0;
+		}
+	}
+	raw_spin_unlock(&cfs_b->lock);
+
+	cfs_rq->runtime_remaining += amount;
+
+	return cfs_rq->runtime_remaining > 0;
+}
+
+static void
+__account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec)
+{
+	cfs_rq->runtime_remaining -= delta_exec;
+	if (likely(cfs_rq->runtime_remaining > 0))
+		return;
+
+	/*
+	 * If the group pool is empty as well, reschedule so that
+	 * put_prev_entity() gets to throttle us.
+	 */
+	if (!assign_cfs_rq_runtime(cfs_rq) && likely(cfs_rq->curr))
+		resched_task(rq_of(cfs_rq)->curr);
+}
+
+static __always_inline void
+account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec)
+{
+	if (!cfs_rq->runtime_enabled)
+		return;
+
+	__account_cfs_rq_runtime(cfs_rq, delta_exec);
+}
+
+static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se;
+	long task_delta, dequeue = 1;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+
+	/* our tasks can't be picked, take them out of the runnable counts */
+	task_delta = cfs_rq->h_nr_running;
+	for_each_sched_entity(se) {
+		struct cfs_rq *qcfs_rq = cfs_rq_of(se);
+
+		/* already off the parent, e.g. the last task went to sleep */
+		if (!se->on_rq)
+			break;
+
+		if (dequeue)
+			dequeue_entity(qcfs_rq, se, DEQUEUE_SLEEP);
+		qcfs_rq->h_nr_running -= task_delta;
+
+		/* Don't dequeue parent if it has other entities besides us */
+		if (qcfs_rq->load.weight)
+			dequeue = 0;
+	}
+
+	if (!se)
+		rq->nr_running -= task_delta;
+
+	cfs_rq->throttled = 1;
+	cfs_rq->throttled_timestamp = rq->clock;
+
+	raw_spin_lock(&cfs_b->lock);
+	list_add_tail_rcu(&cfs_rq->throttled_list, &cfs_b->throttled_cfs_rq);
+	raw_spin_unlock(&cfs_b->lock);
+}
+
+static void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	struct cfs_bandwidth *cfs_b = tg_cfs_bandwidth(cfs_rq->tg);
+	struct sched_entity *se;
+	long task_delta, enqueue = 1;
+
+	se = cfs_rq->tg->se[cpu_of(rq)];
+
+	cfs_rq->throttled = 0;
+
+	raw_spin_lock(&cfs_b->lock);
+	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_timestamp;
+	list_del_rcu(&cfs_rq->throttled_list);
+	raw_spin_unlock(&cfs_b->lock);
+
+	/* nothing to put back if every task left while we were throttled */
+	if (!cfs_rq->load.weight)
+		return;
+
+	task_delta = cfs_rq->h_nr_running;
+	for_each_sched_entity(se) {
+		if (se->on_rq)
+			enqueue = 0;
+
+		cfs_rq = cfs_rq_of(se);
+		if (enqueue)
+			enqueue_entity(cfs_rq, se, ENQUEUE_WAKEUP);
+		cfs_rq->h_nr_running += task_delta;
+
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		rq->nr_running += task_delta;
+
+	/* kick the cpu if it went idle because of us */
+	if (rq->curr == rq->idle && rq->cfs.nr_running)
+		resched_task(rq->curr);
+}
+
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	if (!cfs_rq->runtime_enabled || cfs_rq->runtime_remaining > 0)
+		return;
+
+	if (cfs_rq_throttled(cfs_rq) || assign_cfs_rq_runtime(cfs_rq))
+		return;
+
+	throttle_cfs_rq(cfs_rq);
+}
+
+/*
+ * The group is going away.  Its cfs_rq holds no tasks any more, but may
+ * still sit on the throttled list, where the period timer would find it
+ * after it has been freed.
+ */
+static void unthrottle_offline_cfs_rq(struct cfs_rq *cfs_rq)
+{
+	struct rq *rq = rq_of(cfs_rq);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	if (cfs_rq_throttled(cfs_rq)) {
+		update_rq_clock(rq);
+		unthrottle_cfs_rq(cfs_rq);
+	}
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/*
+ * Hand the freshly refilled pool to the throttled cfs_rqs, oldest first.
+ * Called from the period timer without cfs_b->lock held, as the rq lock
+ * nests outside of it.
+ */
+static void distribute_cfs_runtime(struct cfs_bandwidth *cfs_b)
+{
+	struct cfs_rq *cfs_rq;
+	u64 runtime;
+	int empty = 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(cfs_rq, &cfs_b->throttled_cfs_rq,
+				throttled_list) {
+		struct rq *rq = rq_of(cfs_rq);
+
+		raw_spin_lock(&rq->lock);
+		if (!cfs_rq_throttled(cfs_rq))
+			goto next;
+
+		runtime = sched_cfs_bandwidth_slice() -
+			  cfs_rq->runtime_remaining;
+
+		raw_spin_lock(&cfs_b->lock);
+		runtime = min(runtime, cfs_b->runtime);
+		cfs_b->runtime -= runtime;
+		empty = !cfs_b->runtime;
+		raw_spin_unlock(&cfs_b->lock);
+
+		cfs_rq->runtime_remaining += runtime;
+		if (cfs_rq->runtime_remaining > 0) {
+			update_rq_clock(rq);
+			unthrottle_cfs_rq(cfs_rq);
+		}
+next:
+		raw_spin_unlock(&rq->lock);
+
+		if (empty)
+			break;
+	}
+	rcu_read_unlock();
+}
+
+/*
+ * Refill the pool for a new period.  Returns non-zero when the timer can
+ * be stopped because nobody used the group's runtime in the last period;
+ * it is restarted by the next assign_cfs_rq_runtime().
+ */
+static int do_sched_cfs_period_timer(struct cfs_bandwidth *cfs_b, int overrun)
+{
+	int throttled;
+
+	raw_spin_lock(&cfs_b->lock);
+	throttled = !list_empty(&cfs_b->throttled_cfs_rq);
+	cfs_b->nr_periods += overrun;
+
+	cfs_b->runtime = cfs_b->quota;
+	if (cfs_b->quota == RUNTIME_INF || (cfs_b->idle && !throttled)) {
+		cfs_b->timer_active = 0;
+		raw_spin_unlock(&cfs_b->lock);
+		return 1;
+	}
+
+	cfs_b->idle = 1;
+	if (throttled)
+		cfs_b->nr_throttled += overrun;
+	raw_spin_unlock(&cfs_b->lock);
+
+	if (throttled)
+		distribute_cfs_runtime(cfs_b);
+
+	return 0;
+}
+
+static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
+{
+	struct cfs_bandwidth *cfs_b =
+		container_of(timer, struct cfs_bandwidth, period_timer);
+	ktime_t now;
+	int overrun;
+	int idle = 0;
+
+	for (;;) {
+		now = hrtimer_cb_get_time(timer);
+		overrun = hrtimer_forward(timer, now, cfs_b->period);
+
+		if (!overrun)
+			break;
+
+		/* once timer_active is clear someone may restart us */
+		idle = do_sched_cfs_period_timer(cfs_b, overrun);
+		if (idle)
+			break;
+	}
+
+	return idle ? HRTIMER_NORESTART : HRTIMER_RESTART;
+}
+
+static void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	raw_spin_lock_init(&cfs_b->lock);
+	cfs_b->runtime = 0;
+	cfs_b->quota = RUNTIME_INF;
+	cfs_b->period = ns_to_ktime(default_cfs_period());
+
+	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
+	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	cfs_b->period_timer.function = sched_cfs_period_timer;
+}
+
+static void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+{
+	hrtimer_cancel(&cfs_b->period_timer);
+}
+
+static void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
+{
+	cfs_rq->runtime_enabled = 0;
+	cfs_rq->throttled = 0;
+	INIT_LIST_HEAD(&cfs_rq->throttled_list);
+}
+#else /* !CONFIG_CFS_BANDWIDTH */
+static __always_inline void
+account_cfs_rq_runtime(struct cfs_rq *cfs_rq, unsigned long delta_exec) {}
+static void check_cfs_rq_runtime(struct cfs_rq *cfs_rq) {}
+static inline void unthrottle_offline_cfs_rq(struct cfs_rq *cfs_rq) {}
+
+static inline int cfs_rq_throttled(struct cfs_rq *cfs_rq)
+{
+	return 0;
+}
+
+static inline void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b) {}
+static inline void destroy_cfs_bandwidth(struct cfs_bandwidth *cfs_b) {}
+static inline void init_cfs_rq_runtime(struct cfs_rq *cfs_rq) {}
+#endif /* CONFIG_CFS_BANDWIDTH */
+
 /**************************************************
  * CFS operations on tasks:
  */
@@ -1041,9 +1410,10 @@ static inline void hrtick_update(struct rq *rq)
 #endif
 
 /*
- * The enqueue_task method is called before nr_running is
- * increased. Here we update the fair scheduling stats and
- * then put the task into the rbtree:
+ * The enqueue_task method is called when a task becomes runnable.
+ * Here we update the fair scheduling stats and then put the task
+ * into the rbtree.  rq->nr_running only counts tasks that are not
+ * below a throttled cfs_rq:
  */
 static void
 enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
@@ -1056,16 +1426,33 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 			break;
 		cfs_rq = cfs_rq_of(se);
 		enqueue_entity(cfs_rq, se, flags);
+		/*
+		 * A throttled cfs_rq keeps its entity off the parent, it is
+		 * put back there by unthrottle_cfs_rq().
+		 */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running++;
 		flags = ENQUEUE_WAKEUP;
 	}
 
+	/* the levels above that were already queued */
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running++;
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		inc_nr_running(rq);
 	hrtick_update(rq);
 }
 
 /*
- * The dequeue_task method is called before nr_running is
- * decreased. We remove the task from the rbtree and
- * update the fair scheduling stats:
+ * The dequeue_task method is called when a task stops being
+ * runnable. We remove the task from the rbtree and update the
+ * fair scheduling stats:
  */
 static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 {
@@ -1075,12 +1462,27 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	for_each_sched_entity(se) {
 		cfs_rq = cfs_rq_of(se);
 		dequeue_entity(cfs_rq, se, flags);
+		/* a throttled cfs_rq is already off the parent */
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+		cfs_rq->h_nr_running--;
 		/* Don't dequeue parent if it has other entities besides us */
-		if (cfs_rq->load.weight)
+		if (cfs_rq->load.weight) {
+			se = parent_entity(se);
 			break;
+		}
 		flags |= DEQUEUE_SLEEP;
 	}
 
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+		cfs_rq->h_nr_running--;
+		if (cfs_rq_throttled(cfs_rq))
+			break;
+	}
+
+	if (!se)
+		dec_nr_running(rq);
 	hrtick_update(rq);
 }
 
@@ -1644,8 +2046,12 @@ static void set_last_buddy(struct sched_entity *se)
 static void set_next_buddy(struct sched_entity *se)
 {
 	if (likely(task_of(se)->policy != SCHED_IDLE)) {
-		for_each_sched_entity(se)
+		for_each_sched_entity(se) {
+			/* don't point buddies at a throttled hierarchy */
+			if (!se->on_rq)
+				break;
 			cfs_rq_of(se)->next = se;
+		}
 	}
 }
 
@@ -276,6 +276,69 @@ sched_info_switch(struct task_struct *prev, struct task_struct *next)
 #define sched_info_switch(t, next)		do { } while (0)
 #endif /* CONFIG_SCHEDSTATS || CONFIG_TASK_DELAY_ACCT */
 
+#ifdef CONFIG_SCHED_WAKEUP_STATS
+static inline void
+sched_wakeup_stats_add(struct sched_wakeup_stats *ws, u64 delta)
+{
+	unsigned int idx = 0;
+	u32 us;
+
+	if (delta >= NSEC_PER_USEC) {
+		/* anything past a second lands in the top bucket anyway */
+		us = delta < NSEC_PER_SEC ? (u32)delta / NSEC_PER_USEC :
+					    USEC_PER_SEC;
+		idx = min_t(unsigned int, fls(us),
+			    NR_WAKEUP_LATENCY_BUCKETS - 1);
+	}
+
+	ws->count++;
+	ws->total_ns += delta;
+	if (delta > ws->max_ns)
+		ws->max_ns = delta;
+	ws->hist[idx]++;
+}
+
+/*
+ * Called with the rq lock held, once a wakeup has put @p on @rq.
+ */
+static inline void sched_wakeup_start(struct rq *rq, struct task_struct *p)
+{
+	p->se.wakeup_start = rq->clock;
+}
+
+/*
+ * Called with the rq lock held when @p has been picked to run next.
+ * The per-cgroup histograms are per-cpu and only ever touched under
+ * the lock of that cpu's rq.
+ */
+static inline void sched_wakeup_end(struct rq *rq, struct task_struct *p)
+{
+	u64 delta;
+
+	if (!p->se.wakeup_start)
+		return;
+
+	/* rq clocks of different cpus are not synchronized */
+	delta = rq->clock - p->se.wakeup_start;
+	if ((s64)delta < 0)
+		delta = 0;
+	p->se.wakeup_start = 0;
+
+	sched_wakeup_stats_add(&p->se.wakeup_stats, delta);
+#ifdef CONFIG_CGROUP_SCHED
+	sched_wakeup_stats_add(per_cpu_ptr(task_group(p)->wakeup_stats,
+					   cpu_of(rq)), delta);
+#endif
+}
+#else
+static inline void sched_wakeup_start(struct rq *rq, struct task_struct *p)
+{
+}
+static inline void sched_wakeup_end(struct rq *rq, struct task_struct *p)
+{
+}
+#endif /* CONFIG_SCHED_WAKEUP_STATS */
+
 /*
  * The following are functions that support scheduler-internal time accounting.
  * These functions are generally called at the timer tick.  None of this depends
@@ -42,6 +42,7 @@
 #include <linux/syscalls.h>
 #include <linux/kprobes.h>
 #include <linux/user_namespace.h>
+#include <linux/ksm.h>
 
 #include <asm/uaccess.h>
 #include <asm/io.h>
@@ -1613,6 +1614,21 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			else
 				error = PR_MCE_KILL_DEFAULT;
 			break;
+		case PR_SET_MEMORY_MERGE:
+			if (arg3 | arg4 | arg5)
+				return -EINVAL;
+			down_write(&me->mm->mmap_sem);
+			if (arg2)
+				error = ksm_enable_merge_any(me->mm);
+			else
+				error = ksm_disable_merge_any(me->mm);
+			up_write(&me->mm->mmap_sem);
+			break;
+		case PR_GET_MEMORY_MERGE:
+			if (arg2 | arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = test_bit(MMF_VM_MERGE_ANY, &me->mm->flags);
+			break;
 		default:
 			error = -EINVAL;
 			break;
@@ -65,9 +65,11 @@ struct entry {
 	pid_t			pid;
 
 	/*
-	 * Number of timeout events:
+	 * Number of timeout events, and of those which slack moved
+	 * onto an earlier wakeup:
 	 */
 	unsigned long		count;
+	unsigned long		coalesced;
 	unsigned int		timer_flag;
 
 	/*
@@ -204,6 +206,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->coalesced = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -227,9 +230,12 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
  * @startf:	pointer to the function which did the timer setup
  * @timerf:	pointer to the timer callback function of the timer
  * @comm:	name of the process which set up the timer
+ * @timer_flag:	TIMER_STATS_FLAG_* bits describing this expiry
  *
  * When the timer is already registered, then the event counter is
  * incremented. Otherwise the timer is registered in a free slot.
+ * Expiries flagged TIMER_STATS_FLAG_COALESCED did not need a wakeup
+ * of their own and are counted as saved wakeups as well.
  */
 void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 			      void *timerf, char *comm,
@@ -251,16 +257,18 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	input.start_func = startf;
 	input.expire_func = timerf;
 	input.pid = pid;
-	input.timer_flag = timer_flag;
+	input.timer_flag = timer_flag & ~TIMER_STATS_FLAG_COALESCED;
 
 	raw_spin_lock_irqsave(lock, flags);
 	if (!timer_stats_active)
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (timer_flag & TIMER_STATS_FLAG_COALESCED)
+			entry->coalesced++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -282,7 +290,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	struct timespec period;
 	struct entry *entry;
 	unsigned long ms;
-	long events = 0;
+	long events = 0, coalesced = 0;
 	ktime_t time;
 	int i;
 
@@ -298,7 +306,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	period = ktime_to_timespec(time);
 	ms = period.tv_nsec / 1000000;
 
-	seq_puts(m, "Timer Stats Version: v0.2\n");
+	seq_puts(m, "Timer Stats Version: v0.3\n");
 	seq_printf(m, "Sample period: %ld.%03ld s\n", period.tv_sec, ms);
 	if (atomic_read(&overflow_count))
 		seq_printf(m, "Overflow: %d entries\n",
@@ -320,6 +328,7 @@ static int tstats_show(struct seq_file *m, void *v)
 		seq_puts(m, ")\n");
 
 		events += entry->count;
+		coalesced += entry->coalesced;
 	}
 
 	ms += period.tv_sec * 1000;
@@ -333,6 +342,13 @@ static int tstats_show(struct seq_file *m, void *v)
 	else
 		seq_printf(m, "%ld total events\n", events);
 
+	if (coalesced && period.tv_sec)
+		seq_printf(m, "%ld coalesced events, %ld.%03ld wakeups/sec saved\n",
+			   coalesced, coalesced * 1000 / ms,
+			   (coalesced * 1000000 / ms) % 1000);
+	else
+		seq_printf(m, "%ld coalesced events\n", coalesced);
+
 	mutex_unlock(&show_mutex);
 
 	return 0;
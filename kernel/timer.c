@@ -330,6 +330,9 @@ EXPORT_SYMBOL_GPL(round_jiffies_up_relative);
  *
  * By setting the slack to -1, a percentage of the delay is used
  * instead.
+ *
+ * Slack is only applied while kernel.timer_coalescing is set, so the
+ * wakeups it saves can be measured by turning it off.
  */
 void set_timer_slack(struct timer_list *timer, int slack_hz)
 {
@@ -337,6 +340,8 @@ void set_timer_slack(struct timer_list *timer, int slack_hz)
 }
 EXPORT_SYMBOL_GPL(set_timer_slack);
 
+int sysctl_timer_coalescing __read_mostly = 1;
+
 
 static inline void set_running_timer(struct tvec_base *base,
 					struct timer_list *timer)
@@ -399,7 +404,17 @@ void __timer_stats_timer_set_start_info(struct timer_list *timer, void *addr)
 	timer->start_pid = current->pid;
 }
 
-static void timer_stats_account_timer(struct timer_list *timer)
+static inline void
+timer_stats_timer_set_requested(struct timer_list *timer, unsigned long expires)
+{
+	timer->start_expires = expires;
+}
+
+/*
+ * @shared: an earlier timer expired in the same pass.  This one only
+ * saved a wakeup if its slack moved it there from an earlier jiffy.
+ */
+static void timer_stats_account_timer(struct timer_list *timer, int shared)
 {
 	unsigned int flag = 0;
 
@@ -407,13 +422,19 @@ static void timer_stats_account_timer(struct timer_list *timer)
 		return;
 	if (unlikely(tbase_get_deferrable(timer->base)))
 		flag |= TIMER_STATS_FLAG_DEFERRABLE;
+	if (shared && time_before(timer->start_expires, timer->expires))
+		flag |= TIMER_STATS_FLAG_COALESCED;
 
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, flag);
 }
 
 #else
-static void timer_stats_account_timer(struct timer_list *timer) {}
+static inline void
+timer_stats_timer_set_requested(struct timer_list *timer, unsigned long expires)
+{
+}
+static void timer_stats_account_timer(struct timer_list *timer, int shared) {}
 #endif
 
 #ifdef CONFIG_DEBUG_OBJECTS_TIMERS
@@ -652,13 +673,14 @@ static struct tvec_base *lock_timer_base(struct timer_list *timer,
 
 static inline int
 __mod_timer(struct timer_list *timer, unsigned long expires,
-						bool pending_only, int pinned)
+			unsigned long requested, bool pending_only, int pinned)
 {
 	struct tvec_base *base, *new_base;
 	unsigned long flags;
 	int ret = 0 , cpu;
 
 	timer_stats_timer_set_start_info(timer);
+	timer_stats_timer_set_requested(timer, requested);
 	BUG_ON(!timer->function);
 
 	base = lock_timer_base(timer, &flags);
@@ -730,7 +752,7 @@ out_unlock:
  */
 int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 {
-	return __mod_timer(timer, expires, true, TIMER_NOT_PINNED);
+	return __mod_timer(timer, expires, expires, true, TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pending);
 
@@ -750,6 +772,9 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	unsigned long expires_limit, mask;
 	int bit;
 
+	if (!sysctl_timer_coalescing)
+		return expires;
+
 	expires_limit = expires;
 
 	if (timer->slack >= 0) {
@@ -804,9 +829,8 @@ int mod_timer(struct timer_list *timer, unsigned long expires)
 	if (timer_pending(timer) && timer->expires == expires)
 		return 1;
 
-	expires = apply_slack(timer, expires);
-
-	return __mod_timer(timer, expires, false, TIMER_NOT_PINNED);
+	return __mod_timer(timer, apply_slack(timer, expires), expires,
+			   false, TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer);
 
@@ -828,7 +852,7 @@ int mod_timer_pinned(struct timer_list *timer, unsigned long expires)
 	if (timer->expires == expires && timer_pending(timer))
 		return 1;
 
-	return __mod_timer(timer, expires, false, TIMER_PINNED);
+	return __mod_timer(timer, expires, expires, false, TIMER_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pinned);
 
@@ -866,6 +890,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	unsigned long flags;
 
 	timer_stats_timer_set_start_info(timer);
+	timer_stats_timer_set_requested(timer, timer->expires);
 	BUG_ON(timer_pending(timer) || !timer->function);
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
@@ -1069,6 +1094,7 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 static inline void __run_timers(struct tvec_base *base)
 {
 	struct timer_list *timer;
+	int nr_run = 0;
 
 	spin_lock_irq(&base->lock);
 	while (time_after_eq(jiffies, base->timer_jiffies)) {
@@ -1094,7 +1120,8 @@ static inline void __run_timers(struct tvec_base *base)
 			fn = timer->function;
 			data = timer->data;
 
-			timer_stats_account_timer(timer);
+			/* all but the first expiry share its wakeup */
+			timer_stats_account_timer(timer, nr_run++ > 0);
 
 			set_running_timer(base, timer);
 			detach_timer(timer, 1);
@@ -1456,7 +1483,7 @@ signed long __sched schedule_timeout(signed long timeout)
 	expire = timeout + jiffies;
 
 	setup_timer_on_stack(&timer, process_timeout, (unsigned long)current);
-	__mod_timer(&timer, expire, false, TIMER_NOT_PINNED);
+	__mod_timer(&timer, expire, expire, false, TIMER_NOT_PINNED);
 	schedule();
 	del_singleshot_timer_sync(&timer);
 
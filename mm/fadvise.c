@@ -19,6 +19,77 @@
 #include <linux/syscalls.h>
 
 #include <asm/unistd.h>
+#include <asm/uaccess.h>
+
+static int fadvise_willneed(struct address_space *mapping, struct file *file,
+			    loff_t offset, loff_t endbyte)
+{
+	pgoff_t start_index;
+	pgoff_t end_index;
+	unsigned long nrpages;
+	int ret;
+
+	if (!mapping->a_ops->readpage)
+		return -EINVAL;
+
+	/* First and last PARTIAL page! */
+	start_index = offset >> PAGE_CACHE_SHIFT;
+	end_index = endbyte >> PAGE_CACHE_SHIFT;
+
+	/* Careful about overflow on the "+1" */
+	nrpages = end_index - start_index + 1;
+	if (!nrpages)
+		nrpages = ~0UL;
+
+	ret = force_page_cache_readahead(mapping, file,
+			start_index,
+			nrpages);
+	if (ret > 0)
+		ret = 0;
+	return ret;
+}
+
+/*
+ * FS_IOC_WILLNEED_RANGES: POSIX_FADV_WILLNEED on each of a list of ranges,
+ * stopping at the first one that fails.
+ */
+int ioctl_willneed_ranges(struct file *file, void __user *argp)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct fadvise_range __user *ranges;
+	struct fadvise_ranges arg;
+	struct fadvise_range range;
+	unsigned int i;
+	int ret;
+
+	if (copy_from_user(&arg, argp, sizeof(arg)))
+		return -EFAULT;
+	if (arg.flags || arg.count > FADV_MAX_RANGES)
+		return -EINVAL;
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+	if (!mapping)
+		return -EINVAL;
+	/* no bad return value, but ignore advice, as fadvise does */
+	if (mapping->a_ops->get_xip_mem)
+		return 0;
+
+	ranges = (struct fadvise_range __user *)(unsigned long)arg.ranges;
+	for (i = 0; i < arg.count; i++) {
+		if (copy_from_user(&range, &ranges[i], sizeof(range)))
+			return -EFAULT;
+		if ((loff_t)range.offset < 0 || (loff_t)range.len <= 0 ||
+		    (loff_t)(range.offset + range.len) < 0)
+			return -EINVAL;
+
+		ret = fadvise_willneed(mapping, file, range.offset,
+				       range.offset + range.len - 1);
+		if (ret)
+			return ret;
+		cond_resched();
+	}
+	return 0;
+}
 
 /*
  * POSIX_FADV_WILLNEED could set PG_Referenced, and POSIX_FADV_NOREUSE could
@@ -32,7 +103,6 @@ SYSCALL_DEFINE(fadvise64_64)(int fd, loff_t offset, loff_t len, int advice)
 	loff_t endbyte;			/* inclusive */
 	pgoff_t start_index;
 	pgoff_t end_index;
-	unsigned long nrpages;
 	int ret = 0;
 
 	if (!file)
@@ -93,25 +163,7 @@ SYSCALL_DEFINE(fadvise64_64)(int fd, loff_t offset, loff_t len, int advice)
 		spin_unlock(&file->f_lock);
 		break;
 	case POSIX_FADV_WILLNEED:
-		if (!mapping->a_ops->readpage) {
-			ret = -EINVAL;
-			break;
-		}
-
-		/* First and last PARTIAL page! */
-		start_index = offset >> PAGE_CACHE_SHIFT;
-		end_index = endbyte >> PAGE_CACHE_SHIFT;
-
-		/* Careful about overflow on the "+1" */
-		nrpages = end_index - start_index + 1;
-		if (!nrpages)
-			nrpages = ~0UL;
-		
-		ret = force_page_cache_readahead(mapping, file,
-				start_index,
-				nrpages);
-		if (ret > 0)
-			ret = 0;
+		ret = fadvise_willneed(mapping, file, offset, endbyte);
 		break;
 	case POSIX_FADV_NOREUSE:
 		break;
@@ -450,10 +450,12 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
 	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
+		if (!page_is_file_cache(page))
 			lru_cache_add_anon(page);
+		else if (workingset_refault(mapping, offset))
+			lru_cache_add_lru(page, LRU_ACTIVE_FILE);
+		else
+			lru_cache_add_file(page);
 	}
 	return ret;
 }
@@ -1430,6 +1432,55 @@ static int page_cache_read(struct file *file, pgoff_t offset)
 }
 
 #define MMAP_LOTSAMISS  (100)
+#define MMAP_HOT_SCALE	(4)	/* max read-around, in ra_pages */
+#define MMAP_STRIDE_HITS (2)	/* strided faults before prefetching */
+#define MMAP_STRIDE_AHEAD (4)	/* strides prefetched ahead */
+
+/*
+ * Faults that keep stepping through a file at a fixed distance, larger
+ * than the read-around window (walking the entries of a zip or dex
+ * file), get the next MMAP_STRIDE_AHEAD steps read ahead.  Once that
+ * is going, every fault on the stride pushes the prefetch one further.
+ * Only misses can start a new stride, hits elsewhere in the file are
+ * just read-around pages being used.
+ */
+static void do_stride_mmap_readahead(struct file_ra_state *ra,
+				     struct file *file,
+				     pgoff_t offset, int miss)
+{
+	long stride = (long)(offset - ra->mmap_prev);
+	unsigned long nr;
+	int i;
+
+	if (!stride || stride != ra->mmap_stride) {
+		if (miss) {
+			ra->mmap_prev = offset;
+			ra->mmap_stride = stride;
+			ra->mmap_stride_hits = 0;
+		}
+		return;
+	}
+
+	ra->mmap_prev = offset;
+	if (!ra->ra_pages || abs(stride) <= ra->ra_pages / 2)
+		return;
+
+	if (ra->mmap_stride_hits < MMAP_STRIDE_HITS) {
+		if (++ra->mmap_stride_hits < MMAP_STRIDE_HITS)
+			return;
+		i = 1;
+	} else {
+		i = MMAP_STRIDE_AHEAD;
+	}
+
+	nr = max(ra->ra_pages / 4, 1U);
+	for (; i <= MMAP_STRIDE_AHEAD; i++) {
+		if (stride < 0 && offset < (pgoff_t)(-stride * i))
+			break;
+		force_page_cache_readahead(file->f_mapping, file,
+					   offset + stride * i, nr);
+	}
+}
 
 /*
  * Synchronous readahead happens when we don't even find
@@ -1464,14 +1515,25 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	if (ra->mmap_miss > MMAP_LOTSAMISS)
 		return;
 
+	do_stride_mmap_readahead(ra, file, offset, 1);
+
 	/*
-	 * mmap read-around
+	 * mmap read-around.  A miss within a window's distance of the
+	 * previous window means the hot region is larger than it, so the
+	 * window grows up to MMAP_HOT_SCALE * ra_pages; a miss elsewhere
+	 * starts over.  The tail of the window is marked for async
+	 * readahead, so a fault there extends it in the background.
 	 */
-	ra_pages = max_sane_readahead(ra->ra_pages);
+	if (ra->size && offset + ra->size >= ra->start &&
+	    offset < ra->start + 2 * ra->size)
+		ra_pages = min(ra->size * 2, ra->ra_pages * MMAP_HOT_SCALE);
+	else
+		ra_pages = ra->ra_pages;
+	ra_pages = max_sane_readahead(ra_pages);
 	if (ra_pages) {
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
-		ra->async_size = 0;
+		ra->async_size = ra_pages / 4;
 		ra_submit(ra, mapping, file);
 	}
 }
@@ -1493,6 +1555,8 @@ static void do_async_mmap_readahead(struct vm_area_struct *vma,
 		return;
 	if (ra->mmap_miss > 0)
 		ra->mmap_miss--;
+	if (ra->mmap_stride)
+		do_stride_mmap_readahead(ra, file, offset, 0);
 	if (PageReadahead(page))
 		page_cache_async_readahead(mapping, ra, file,
 					   page, offset, ra->ra_pages);
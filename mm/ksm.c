@@ -148,6 +148,8 @@ struct rmap_item {
 #define SEQNR_MASK	0x0ff	/* low bits of unstable tree seqnr */
 #define UNSTABLE_FLAG	0x100	/* is a node of the unstable tree */
 #define STABLE_FLAG	0x200	/* is listed from the stable tree */
+#define BACKOFF_SHIFT	10	/* log2 of passes between checks of a */
+#define BACKOFF_MASK	0xc00	/* page whose content keeps changing */
 
 /* The stable and unstable tree heads */
 static struct rb_root root_stable_tree = RB_ROOT;
@@ -243,6 +245,7 @@ static inline struct rmap_item *alloc_rmap_item(void)
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
 	ksm_rmap_items--;
+	rmap_item->mm->ksm_rmap_items--;
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -314,6 +317,19 @@ static inline int in_stable_tree(struct rmap_item *rmap_item)
 	return rmap_item->address & STABLE_FLAG;
 }
 
+/*
+ * A page found changed on consecutive passes backs off exponentially,
+ * up to being checked on one pass in eight, so that ksmd spends its
+ * pages_to_scan budget on the areas which stay stable.
+ */
+static inline int rmap_item_backed_off(struct rmap_item *rmap_item)
+{
+	unsigned int level = (rmap_item->address & BACKOFF_MASK) >>
+							BACKOFF_SHIFT;
+
+	return ksm_scan.seqnr & ((1 << level) - 1);
+}
+
 static void hold_anon_vma(struct rmap_item *rmap_item,
 			  struct anon_vma *anon_vma)
 {
@@ -357,6 +373,31 @@ static inline bool ksm_test_exit(struct mm_struct *mm)
  * Could a ksm page appear anywhere else?  Actually yes, in a VM_PFNMAP
  * mmap of /dev/mem or /dev/kmem, where we would not want to touch it.
  */
+static int vma_ksm_compatible(unsigned long vm_flags)
+{
+	/*
+	 * Be somewhat over-protective for now!
+	 */
+	if (vm_flags & (VM_SHARED  | VM_MAYSHARE   |
+			VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
+			VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
+			VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
+		return 0;
+	return 1;
+}
+
+/*
+ * VM_MERGEABLE marks areas madvised MADV_MERGEABLE; in a process which
+ * did PR_SET_MEMORY_MERGE, every compatible area is mergeable as well.
+ */
+static inline int vma_ksm_mergeable(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_MERGEABLE)
+		return 1;
+	return test_bit(MMF_VM_MERGE_ANY, &vma->vm_mm->flags) &&
+	       vma_ksm_compatible(vma->vm_flags);
+}
+
 static int break_ksm(struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
@@ -423,7 +464,7 @@ static void break_cow(struct rmap_item *rmap_item)
 	vma = find_vma(mm, addr);
 	if (!vma || vma->vm_start > addr)
 		goto out;
-	if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
+	if (!vma_ksm_mergeable(vma) || !vma->anon_vma)
 		goto out;
 	break_ksm(vma, addr);
 out:
@@ -443,7 +484,7 @@ static struct page *get_mergeable_page(struct rmap_item *rmap_item)
 	vma = find_vma(mm, addr);
 	if (!vma || vma->vm_start > addr)
 		goto out;
-	if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
+	if (!vma_ksm_mergeable(vma) || !vma->anon_vma)
 		goto out;
 
 	page = follow_page(vma, addr, FOLL_GET);
@@ -470,6 +511,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -557,6 +599,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
@@ -646,7 +689,7 @@ static int unmerge_and_remove_all_rmap_items(void)
 		for (vma = mm->mmap; vma; vma = vma->vm_next) {
 			if (ksm_test_exit(mm))
 				break;
-			if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
+			if (!vma_ksm_mergeable(vma) || !vma->anon_vma)
 				continue;
 			err = unmerge_ksm_pages(vma,
 						vma->vm_start, vma->vm_end);
@@ -845,7 +888,7 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 	if (page == kpage)			/* ksm page forked */
 		return 0;
 
-	if (!(vma->vm_flags & VM_MERGEABLE))
+	if (!vma_ksm_mergeable(vma))
 		goto out;
 	if (!PageAnon(page))
 		goto out;
@@ -1139,6 +1182,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -1157,9 +1201,12 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	struct stable_node *stable_node;
 	struct page *kpage;
 	unsigned int checksum;
+	unsigned long backoff;
 	int err;
 
+	backoff = rmap_item->address & BACKOFF_MASK;
 	remove_rmap_item_from_tree(rmap_item);
+	rmap_item->address &= ~BACKOFF_MASK;
 
 	/* We first start with searching the page inside the stable tree */
 	kpage = stable_tree_search(page);
@@ -1187,6 +1234,9 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
+		if (backoff != BACKOFF_MASK)
+			backoff += 1 << BACKOFF_SHIFT;
+		rmap_item->address |= backoff;
 		return;
 	}
 
@@ -1247,6 +1297,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	if (rmap_item) {
 		/* It has already been zeroed */
 		rmap_item->mm = mm_slot->mm;
+		rmap_item->mm->ksm_rmap_items++;
 		rmap_item->address = addr;
 		rmap_item->rmap_list = *rmap_list;
 		*rmap_list = rmap_item;
@@ -1285,7 +1336,7 @@ next_mm:
 		vma = find_vma(mm, ksm_scan.address);
 
 	for (; vma; vma = vma->vm_next) {
-		if (!(vma->vm_flags & VM_MERGEABLE))
+		if (!vma_ksm_mergeable(vma))
 			continue;
 		if (ksm_scan.address < vma->vm_start)
 			ksm_scan.address = vma->vm_start;
@@ -1376,7 +1427,8 @@ static void ksm_do_scan(unsigned int scan_npages)
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
 			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
+		if ((!PageKsm(page) || !in_stable_tree(rmap_item)) &&
+		    !rmap_item_backed_off(rmap_item))
 			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
 	}
@@ -1416,13 +1468,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 	switch (advice) {
 	case MADV_MERGEABLE:
-		/*
-		 * Be somewhat over-protective for now!
-		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
-				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
+		if ((*vm_flags & VM_MERGEABLE) || !vma_ksm_compatible(*vm_flags))
 			return 0;		/* just ignore the advice */
 
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
@@ -1451,6 +1497,65 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 	return 0;
 }
 
+/*
+ * Called with mmap_sem held for writing, on behalf of PR_SET_MEMORY_MERGE:
+ * this is for a zygote-like parent, whose forked children are mostly
+ * made of the same data without any of them knowing where it lies.
+ * The setting is kept in the mm rather than in VM_MERGEABLE, so that
+ * turning it off again leaves madvised areas alone.
+ */
+int ksm_enable_merge_any(struct mm_struct *mm)
+{
+	int err;
+
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+		err = __ksm_enter(mm);
+		if (err)
+			return err;
+	}
+	set_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	return 0;
+}
+
+int ksm_disable_merge_any(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+	int err;
+
+	if (!test_bit(MMF_VM_MERGE_ANY, &mm->flags))
+		return 0;
+
+	/* ksmd needs mmap_sem to merge, so nothing merges again meanwhile */
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if ((vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma ||
+		    !vma_ksm_compatible(vma->vm_flags))
+			continue;
+		err = unmerge_ksm_pages(vma, vma->vm_start, vma->vm_end);
+		if (err)
+			return err;
+	}
+	clear_bit(MMF_VM_MERGE_ANY, &mm->flags);
+	return 0;
+}
+
+/*
+ * Flags for a vma about to be created in @mm, with mmap_sem held for
+ * writing.  Areas of a PR_SET_MEMORY_MERGE process are mergeable without
+ * VM_MERGEABLE, but ksmd may have let go of the mm while it had none, so
+ * register it again.
+ */
+unsigned long ksm_vm_flags(struct mm_struct *mm, unsigned long vm_flags)
+{
+	if (test_bit(MMF_VM_MERGE_ANY, &mm->flags) &&
+	    !test_bit(MMF_VM_MERGEABLE, &mm->flags) &&
+	    vma_ksm_compatible(vm_flags))
+		__ksm_enter(mm);
+	return vm_flags;
+}
+
 int __ksm_enter(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -105,6 +105,7 @@
 #include	<linux/kmemtrace.h>
 #include	<linux/rcupdate.h>
 #include	<linux/string.h>
+#include	<linux/ctype.h>
 #include	<linux/uaccess.h>
 #include	<linux/nodemask.h>
 #include	<linux/kmemleak.h>
@@ -129,6 +130,9 @@
  *		  0 for faster, smaller code (especially in the critical paths).
  *
  * FORCED_DEBUG	- 1 enables SLAB_RED_ZONE and SLAB_POISON (if possible)
+ *		  for the caches selected with slab_debug=, all by default.
+ *		  Caches without debug flags skip the debug checks and the
+ *		  per-object statistics.
  */
 
 #ifdef CONFIG_DEBUG_SLAB
@@ -279,6 +283,8 @@ struct kmem_list3 {
 	struct array_cache **alien;	/* on other nodes */
 	unsigned long next_reap;	/* updated without locking */
 	int free_touched;		/* updated without locking */
+	unsigned long refills;		/* per-cpu array refills and */
+	unsigned long flushes;		/* flushes since the last reap */
 };
 
 /*
@@ -337,6 +343,8 @@ static void kmem_list3_init(struct kmem_list3 *parent)
 	spin_lock_init(&parent->list_lock);
 	parent->free_objects = 0;
 	parent->free_touched = 0;
+	parent->refills = 0;
+	parent->flushes = 0;
 }
 
 #define MAKE_LIST(cachep, listp, slab, nodeid)				\
@@ -355,6 +363,11 @@ static void kmem_list3_init(struct kmem_list3 *parent)
 #define CFLGS_OFF_SLAB		(0x80000000UL)
 #define	OFF_SLAB(x)	((x)->flags & CFLGS_OFF_SLAB)
 
+#define SLAB_DEBUG_FLAGS	(SLAB_RED_ZONE | SLAB_POISON | SLAB_STORE_USER)
+
+/* dflags: tunables were set through /proc/slabinfo, don't auto-tune */
+#define DFLGS_FIXED_TUNABLES	(0x00000001UL)
+
 #define BATCHREFILL_LIMIT	16
 /*
  * Optimization question: fewer reaps means less probability for unnessary
@@ -386,10 +399,18 @@ static void kmem_list3_init(struct kmem_list3 *parent)
 		if ((x)->max_freeable < i)				\
 			(x)->max_freeable = i;				\
 	} while (0)
-#define STATS_INC_ALLOCHIT(x)	atomic_inc(&(x)->allochit)
+#define STATS_INC_DEBUG(x, c)						\
+	do {								\
+		if ((x)->flags & SLAB_DEBUG_FLAGS)			\
+			atomic_inc(&(x)->c);				\
+	} while (0)
+/* misses take the list_lock anyway, and are what auto-tuning acts on */
+#define STATS_INC_ALLOCHIT(x)	STATS_INC_DEBUG(x, allochit)
 #define STATS_INC_ALLOCMISS(x)	atomic_inc(&(x)->allocmiss)
-#define STATS_INC_FREEHIT(x)	atomic_inc(&(x)->freehit)
+#define STATS_INC_FREEHIT(x)	STATS_INC_DEBUG(x, freehit)
 #define STATS_INC_FREEMISS(x)	atomic_inc(&(x)->freemiss)
+#define STATS_INC_TUNE_GROWN(x)	((x)->tune_grown++)
+#define STATS_INC_TUNE_SHRUNK(x) ((x)->tune_shrunk++)
 #else
 #define	STATS_INC_ACTIVE(x)	do { } while (0)
 #define	STATS_DEC_ACTIVE(x)	do { } while (0)
@@ -406,6 +427,8 @@ static void kmem_list3_init(struct kmem_list3 *parent)
 #define STATS_INC_ALLOCMISS(x)	do { } while (0)
 #define STATS_INC_FREEHIT(x)	do { } while (0)
 #define STATS_INC_FREEMISS(x)	do { } while (0)
+#define STATS_INC_TUNE_GROWN(x)	do { } while (0)
+#define STATS_INC_TUNE_SHRUNK(x) do { } while (0)
 #endif
 
 #if DEBUG
@@ -428,6 +451,68 @@ static int obj_offset(struct kmem_cache *cachep)
 	return cachep->obj_offset;
 }
 
+#if FORCED_DEBUG
+/*
+ * slab_debug=<flags>[,<cache>,...] picks the debug options forced on new
+ * caches, any of Z (red zone), P (poison) and U (last user), or "-" for
+ * none.  When cache names follow, only those caches are debugged; a
+ * trailing '*' in a name matches any suffix.  Without the parameter all
+ * caches get all options, as before.
+ */
+static unsigned long slab_debug_flags __read_mostly = SLAB_DEBUG_FLAGS;
+static char *slab_debug_names __read_mostly;
+
+static int __init setup_slab_debug(char *str)
+{
+	slab_debug_flags = 0;
+	for (; *str && *str != ','; str++) {
+		switch (tolower(*str)) {
+		case '-':
+			break;
+		case 'z':
+			slab_debug_flags |= SLAB_RED_ZONE;
+			break;
+		case 'p':
+			slab_debug_flags |= SLAB_POISON;
+			break;
+		case 'u':
+			slab_debug_flags |= SLAB_STORE_USER;
+			break;
+		default:
+			printk(KERN_ERR "slab_debug option '%c' "
+			       "unknown. skipped\n", *str);
+		}
+	}
+	if (*str == ',' && str[1])
+		slab_debug_names = str + 1;
+	return 1;
+}
+__setup("slab_debug=", setup_slab_debug);
+
+static unsigned long slab_debug_match(const char *name)
+{
+	const char *p = slab_debug_names;
+	size_t len;
+
+	if (!p)
+		return slab_debug_flags;
+
+	while (*p) {
+		len = strcspn(p, ",");
+		if (len && p[len - 1] == '*') {
+			if (!strncmp(name, p, len - 1))
+				return slab_debug_flags;
+		} else if (len == strlen(name) && !strncmp(name, p, len)) {
+			return slab_debug_flags;
+		}
+		p += len;
+		if (*p == ',')
+			p++;
+	}
+	return 0;
+}
+#endif
+
 static int obj_size(struct kmem_cache *cachep)
 {
 	return cachep->obj_size;
@@ -800,6 +885,55 @@ static void __slab_error(const char *function, struct kmem_cache *cachep,
  * line
   */
 
+/*
+ * The per-cpu array sizes picked by enable_cpucache() are a guess from
+ * the object size.  Caches that keep refilling and flushing their
+ * arrays under bursty load get the limit doubled by cache_reap(), up
+ * to TUNE_MAX_SCALE times the initial guess and TUNE_MAX_BYTES per cpu,
+ * and halved again towards the guess once they go idle.  The memory the
+ * arrays have grown by in total is bounded by slab_tune_budget; each
+ * cache returns its share when it shrinks back, is tuned by hand or is
+ * destroyed.
+ *
+ * A cache counts as busy above slab_tune_busy refills plus flushes per
+ * cpu and second.  A refill or flush takes the list_lock and moves
+ * batchcount objects, estimated at a microsecond, so the default of a
+ * thousand is about 0.1% of a cpu.  That is an estimate, not a
+ * measurement: the allocmiss and freemiss rates in /proc/slabinfo,
+ * sampled with Documentation/vm/slabtune.c, show where a workload's
+ * caches fall, and slabtune_busy= moves the threshold without a rebuild.
+ */
+#define TUNE_BUSY	(slab_tune_busy * REAPTIMEOUT_LIST3 / HZ)
+#define TUNE_IDLE	2
+#define TUNE_MAX_SCALE	4
+#define TUNE_MAX_BYTES	(32 * 1024)
+
+static int slab_autotune __read_mostly = 1;
+static unsigned long slab_tune_busy __read_mostly = 1000;
+static long slab_tune_bytes;	/* protected by cache_chain_mutex */
+static long slab_tune_budget;
+
+/* Called with cache_chain_mutex held */
+static void slab_tune_set_charge(struct kmem_cache *cachep, long charge)
+{
+	slab_tune_bytes += charge - cachep->tune_charge;
+	cachep->tune_charge = charge;
+}
+
+static int __init noslabtune_setup(char *s)
+{
+	slab_autotune = 0;
+	return 1;
+}
+__setup("noslabtune", noslabtune_setup);
+
+static int __init slabtune_busy_setup(char *s)
+{
+	slab_tune_busy = simple_strtoul(s, NULL, 0);
+	return 1;
+}
+__setup("slabtune_busy=", slabtune_busy_setup);
+
 static int use_alien_caches __read_mostly = 1;
 static int __init noaliencache_setup(char *s)
 {
@@ -1659,6 +1793,9 @@ static int __init cpucache_init(void)
 {
 	int cpu;
 
+	/* let auto-tuning grow the per-cpu arrays by 1/256 of memory */
+	slab_tune_budget = (totalram_pages << PAGE_SHIFT) >> 8;
+
 	/*
 	 * Register the timers that return unneeded pages to the page allocator
 	 */
@@ -2170,6 +2307,9 @@ kmem_cache_create (const char *name, size_t size, size_t align,
 	size_t left_over, slab_size, ralign;
 	struct kmem_cache *cachep = NULL, *pc;
 	gfp_t gfp;
+#if FORCED_DEBUG
+	unsigned long debug_flags;
+#endif
 
 	/*
 	 * Sanity checks... these are all serious usage bugs.
@@ -2224,11 +2364,12 @@ kmem_cache_create (const char *name, size_t size, size_t align,
 	 * above the next power of two: caches with object sizes just above a
 	 * power of two have a significant amount of internal fragmentation.
 	 */
+	debug_flags = slab_debug_match(name);
 	if (size < 4096 || fls(size - 1) == fls(size-1 + REDZONE_ALIGN +
 						2 * sizeof(unsigned long long)))
-		flags |= SLAB_RED_ZONE | SLAB_STORE_USER;
+		flags |= debug_flags & (SLAB_RED_ZONE | SLAB_STORE_USER);
 	if (!(flags & SLAB_DESTROY_BY_RCU))
-		flags |= SLAB_POISON;
+		flags |= debug_flags & SLAB_POISON;
 #endif
 	if (flags & SLAB_DESTROY_BY_RCU)
 		BUG_ON(flags & SLAB_POISON);
@@ -2631,6 +2772,7 @@ void kmem_cache_destroy(struct kmem_cache *cachep)
 	if (unlikely(cachep->flags & SLAB_DESTROY_BY_RCU))
 		rcu_barrier();
 
+	slab_tune_set_charge(cachep, 0);
 	__kmem_cache_destroy(cachep);
 	mutex_unlock(&cache_chain_mutex);
 	put_online_cpus();
@@ -2930,6 +3072,9 @@ static void *cache_free_debugcheck(struct kmem_cache *cachep, void *objp,
 	unsigned int objnr;
 	struct slab *slabp;
 
+	if (!(cachep->flags & SLAB_DEBUG_FLAGS))
+		return objp - obj_offset(cachep);
+
 	BUG_ON(virt_to_cache(objp) != cachep);
 
 	objp -= obj_offset(cachep);
@@ -2975,6 +3120,9 @@ static void check_slabp(struct kmem_cache *cachep, struct slab *slabp)
 	kmem_bufctl_t i;
 	int entries = 0;
 
+	if (!(cachep->flags & SLAB_DEBUG_FLAGS))
+		return;
+
 	/* Check slab's freelist to see if this obj is there. */
 	for (i = slabp->free; i != BUFCTL_END; i = slab_bufctl(slabp)[i]) {
 		entries++;
@@ -3027,6 +3175,7 @@ retry:
 
 	BUG_ON(ac->avail > 0 || !l3);
 	spin_lock(&l3->list_lock);
+	l3->refills++;
 
 	/* See if we can refill from the shared array */
 	if (l3->shared && transfer_objects(ac, l3->shared, batchcount)) {
@@ -3111,6 +3260,8 @@ static void *cache_alloc_debugcheck_after(struct kmem_cache *cachep,
 {
 	if (!objp)
 		return objp;
+	if (!(cachep->flags & SLAB_DEBUG_FLAGS))
+		return objp + obj_offset(cachep);
 	if (cachep->flags & SLAB_POISON) {
 #ifdef CONFIG_DEBUG_PAGEALLOC
 		if ((cachep->buffer_size % PAGE_SIZE) == 0 && OFF_SLAB(cachep))
@@ -3561,6 +3712,7 @@ static void cache_flusharray(struct kmem_cache *cachep, struct array_cache *ac)
 	check_irq_off();
 	l3 = cachep->nodelists[node];
 	spin_lock(&l3->list_lock);
+	l3->flushes++;
 	if (l3->shared) {
 		struct array_cache *shared_array = l3->shared;
 		int max = shared_array->limit - shared_array->avail;
@@ -4061,8 +4213,16 @@ static int enable_cpucache(struct kmem_cache *cachep, gfp_t gfp)
 	 * With debugging enabled, large batchcount lead to excessively long
 	 * periods with disabled local interrupts. Limit the batchcount
 	 */
-	if (limit > 32)
+	if ((cachep->flags & SLAB_DEBUG_FLAGS) && limit > 32)
 		limit = 32;
+#endif
+	cachep->tune_base = limit;
+	cachep->tune_max = max_t(unsigned int, limit,
+				 min_t(unsigned int, limit * TUNE_MAX_SCALE,
+				       TUNE_MAX_BYTES / cachep->buffer_size));
+#if DEBUG
+	if ((cachep->flags & SLAB_DEBUG_FLAGS) && cachep->tune_max > 32)
+		cachep->tune_max = 32;
 #endif
 	err = do_tune_cpucache(cachep, limit, (limit + 1) / 2, shared, gfp);
 	if (err)
@@ -4100,6 +4260,54 @@ void drain_array(struct kmem_cache *cachep, struct kmem_list3 *l3,
 	}
 }
 
+/*
+ * Adapt the per-cpu array limit of @cachep to the refill and flush rate
+ * seen on @l3 since the last call.  Called with cache_chain_mutex held.
+ */
+static void cache_autotune(struct kmem_cache *cachep, struct kmem_list3 *l3)
+{
+	unsigned long events;
+	unsigned int old_limit = cachep->limit;
+	unsigned int limit = old_limit;
+	long charge = 0;
+
+	spin_lock_irq(&l3->list_lock);
+	events = l3->refills + l3->flushes;
+	l3->refills = 0;
+	l3->flushes = 0;
+	spin_unlock_irq(&l3->list_lock);
+
+	if (!slab_autotune || (cachep->dflags & DFLGS_FIXED_TUNABLES))
+		return;
+
+	if (events >= TUNE_BUSY * num_online_cpus())
+		limit = min(limit * 2, cachep->tune_max);
+	else if (events <= TUNE_IDLE)
+		limit = max(limit / 2, cachep->tune_base);
+	if (limit == old_limit)
+		return;
+
+	/* the shared array holds shared * batchcount objects */
+	if (limit > cachep->tune_base)
+		charge = (long)(limit - cachep->tune_base) *
+			 cachep->buffer_size *
+			 (num_online_cpus() + cachep->shared / 2);
+	if (charge > cachep->tune_charge &&
+	    slab_tune_bytes - cachep->tune_charge + charge > slab_tune_budget)
+		return;
+
+	if (do_tune_cpucache(cachep, limit, (limit + 1) / 2, cachep->shared,
+			     GFP_KERNEL))
+		return;
+
+	/* do_tune_cpucache() has set cachep->limit to the new value */
+	if (limit > old_limit)
+		STATS_INC_TUNE_GROWN(cachep);
+	else
+		STATS_INC_TUNE_SHRUNK(cachep);
+	slab_tune_set_charge(cachep, charge);
+}
+
 /**
  * cache_reap - Reclaim memory from caches.
  * @w: work descriptor
@@ -4146,6 +4354,8 @@ static void cache_reap(struct work_struct *w)
 
 		l3->next_reap = jiffies + REAPTIMEOUT_LIST3;
 
+		cache_autotune(searchp, l3);
+
 		drain_array(searchp, l3, l3->shared, 0, node);
 
 		if (l3->free_touched)
@@ -4189,6 +4399,7 @@ static void print_slabinfo_header(struct seq_file *m)
 	seq_puts(m, " : globalstat <listallocs> <maxobjs> <grown> <reaped> "
 		 "<error> <maxfreeable> <nodeallocs> <remotefrees> <alienoverflow>");
 	seq_puts(m, " : cpustat <allochit> <allocmiss> <freehit> <freemiss>");
+	seq_puts(m, " : autotune <grown> <shrunk>");
 #endif
 	seq_putc(m, '\n');
 }
@@ -4306,6 +4517,8 @@ static int s_show(struct seq_file *m, void *p)
 		seq_printf(m, " : cpustat %6lu %6lu %6lu %6lu",
 			   allochit, allocmiss, freehit, freemiss);
 	}
+	seq_printf(m, " : autotune %4lu %4lu",
+		   cachep->tune_grown, cachep->tune_shrunk);
 #endif
 	seq_putc(m, '\n');
 	return 0;
@@ -4373,6 +4586,10 @@ ssize_t slabinfo_write(struct file *file, const char __user * buffer,
 				res = do_tune_cpucache(cachep, limit,
 						       batchcount, shared,
 						       GFP_KERNEL);
+				if (!res) {
+					cachep->dflags |= DFLGS_FIXED_TUNABLES;
+					slab_tune_set_charge(cachep, 0);
+				}
 			}
 			break;
 		}
@@ -29,6 +29,7 @@
 #include <linux/pagevec.h>
 #include <linux/backing-dev.h>
 #include <linux/rmap.h>
+#include <linux/ksm.h>
 #include <linux/topology.h>
 #include <linux/cpu.h>
 #include <linux/cpuset.h>
@@ -40,6 +41,9 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -48,6 +52,9 @@
 
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/vmscan.h>
+
 struct scan_control {
 	/* Incremented by the number of inactive pages that were scanned */
 	unsigned long nr_scanned;
@@ -161,6 +168,12 @@ static unsigned long zone_nr_lru_pages(struct zone *zone,
 void register_shrinker(struct shrinker *shrinker)
 {
 	shrinker->nr = 0;
+#ifdef CONFIG_RECLAIM_STATS
+	shrinker->nr_calls = 0;
+	shrinker->nr_scanned = 0;
+	shrinker->nr_freed = 0;
+	shrinker->time_ns = 0;
+#endif
 	down_write(&shrinker_rwsem);
 	list_add_tail(&shrinker->list, &shrinker_list);
 	up_write(&shrinker_rwsem);
@@ -178,6 +191,72 @@ void unregister_shrinker(struct shrinker *shrinker)
 }
 EXPORT_SYMBOL(unregister_shrinker);
 
+#ifdef CONFIG_RECLAIM_STATS
+/* protects the shrinker and zone reclaim statistics */
+static DEFINE_SPINLOCK(reclaim_stats_lock);
+
+static void shrinker_stats_account(struct shrinker *shrinker,
+				   unsigned long nr_scanned,
+				   unsigned long nr_freed, u64 delta)
+{
+	spin_lock(&reclaim_stats_lock);
+	shrinker->nr_calls++;
+	shrinker->nr_scanned += nr_scanned;
+	shrinker->nr_freed += nr_freed;
+	shrinker->time_ns += delta;
+	spin_unlock(&reclaim_stats_lock);
+}
+
+static void zone_reclaim_stats_account(struct zone *zone, u64 delta)
+{
+	spin_lock(&reclaim_stats_lock);
+	zone->reclaim_calls++;
+	zone->reclaim_time_ns += delta;
+	if (delta > zone->reclaim_max_ns)
+		zone->reclaim_max_ns = delta;
+	spin_unlock(&reclaim_stats_lock);
+}
+
+/*
+ * Account a direct reclaim stall to the global histogram in /proc/vmstat
+ * and to the stalling task.  Buckets are <1, <4, <16, <64, <256 and
+ * >= 256 milliseconds.
+ */
+static void reclaim_stall_account(u64 delta)
+{
+	struct reclaim_stall_stats *rs = &current->reclaim_stall;
+	unsigned long ms = div_u64(delta, NSEC_PER_MSEC);
+	int bucket = 0;
+
+	while (bucket < NR_RECLAIM_STALL_BUCKETS - 1 &&
+	       ms >= 1UL << (2 * bucket))
+		bucket++;
+
+	count_vm_event(ALLOCSTALL_LT1MS + bucket);
+	count_vm_events(ALLOCSTALL_MS, ms);
+
+	rs->count++;
+	rs->total_ns += delta;
+	if (delta > rs->max_ns)
+		rs->max_ns = delta;
+	rs->hist[bucket]++;
+}
+#else
+static inline void shrinker_stats_account(struct shrinker *shrinker,
+					  unsigned long nr_scanned,
+					  unsigned long nr_freed, u64 delta)
+{
+}
+
+static inline void zone_reclaim_stats_account(struct zone *zone, u64 delta)
+{
+}
+
+static inline void reclaim_stall_account(u64 delta)
+{
+}
+#endif
+
 #define SHRINK_BATCH 128
 /*
  * Call the shrink functions to age shrinkable caches
@@ -214,6 +293,10 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 		unsigned long long delta;
 		unsigned long total_scan;
 		unsigned long max_pass;
+		unsigned long nr_scanned = 0;
+		unsigned long nr_freed = 0;
+		ktime_t start = ktime_get();
+		u64 elapsed;
 
 		max_pass = (*shrinker->shrink)(shrinker, 0, gfp_mask);
 		delta = (4 * scanned) / shrinker->seeks;
@@ -249,14 +332,20 @@ unsigned long shrink_slab(unsigned long scanned, gfp_t gfp_mask,
 			if (shrink_ret == -1)
 				break;
 			if (shrink_ret < nr_before)
-				ret += nr_before - shrink_ret;
+				nr_freed += nr_before - shrink_ret;
 			count_vm_events(SLABS_SCANNED, this_scan);
+			nr_scanned += this_scan;
 			total_scan -= this_scan;
 
 			cond_resched();
 		}
 
 		shrinker->nr += total_scan;
+		ret += nr_freed;
+
+		elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+		shrinker_stats_account(shrinker, nr_scanned, nr_freed, elapsed);
+		trace_mm_shrink_slab(shrinker, nr_scanned, nr_freed, elapsed);
 	}
 	up_read(&shrinker_rwsem);
 	return ret;
@@ -454,6 +543,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap, page);
 	} else {
+		workingset_eviction(mapping, page);
 		__remove_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -1086,6 +1176,46 @@ int isolate_lru_page(struct page *page)
 	return ret;
 }
 
+/**
+ * isolate_unmapped_anon_page - make a page that was anon a plain page
+ * @page: locked anon page, the caller holding the only reference
+ *
+ * Takes an anon page that is no longer mapped anywhere off the LRU
+ * lists and drops its anon state, so that the caller can add it to the
+ * page cache.  splice uses it for pages gifted with vmsplice() that
+ * their owner has unmapped since.
+ *
+ * Returns 0 on success, -EBUSY if the page is in use by anybody else or
+ * is more than a plain anon page.
+ */
+int isolate_unmapped_anon_page(struct page *page)
+{
+	VM_BUG_ON(!PageLocked(page));
+
+	if (!PageAnon(page) || PageKsm(page) || page_mapped(page) ||
+	    PageSwapCache(page) || PageMlocked(page) || PageUnevictable(page))
+		return -EBUSY;
+
+	if (PageLRU(page)) {
+		if (isolate_lru_page(page))
+			return -EBUSY;
+		/* reclaim or migration may have got a reference first */
+		if (page_count(page) != 2) {
+			putback_lru_page(page);
+			return -EBUSY;
+		}
+		put_page(page);
+	}
+
+	ClearPageActive(page);
+	ClearPageReclaim(page);
+	ClearPageSwapBacked(page);
+	/* dirtied by the last unmap, nobody accounted it */
+	ClearPageDirty(page);
+	page->mapping = NULL;
+	return 0;
+}
+
 /*
  * shrink_inactive_list() is a helper for shrink_zone().  It returns the number
  * of reclaimed pages
@@ -1698,6 +1828,9 @@ static void shrink_zones(int priority, struct zonelist *zonelist,
 	enum zone_type high_zoneidx = gfp_zone(sc->gfp_mask);
 	struct zoneref *z;
 	struct zone *zone;
+	unsigned long nr_reclaimed;
+	ktime_t start;
+	u64 delta;
 
 	for_each_zone_zonelist_nodemask(zone, z, zonelist, high_zoneidx,
 					sc->nodemask) {
@@ -1723,7 +1856,15 @@ static void shrink_zones(int priority, struct zonelist *zonelist,
 							priority);
 		}
 
+		nr_reclaimed = sc->nr_reclaimed;
+		start = ktime_get();
 		shrink_zone(priority, zone, sc);
+		delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		if (scanning_global_lru(sc))
+			zone_reclaim_stats_account(zone, delta);
+		trace_mm_vmscan_zone_reclaim(zone, priority,
+				sc->nr_reclaimed - nr_reclaimed, delta);
 	}
 }
 
@@ -1893,8 +2034,19 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 		.mem_cgroup = NULL,
 		.nodemask = nodemask,
 	};
+	unsigned long nr_reclaimed;
+	ktime_t start = ktime_get();
+	u64 delta;
 
-	return do_try_to_free_pages(zonelist, &sc);
+	trace_mm_vmscan_direct_reclaim_begin(order, gfp_mask);
+
+	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	reclaim_stall_account(delta);
+	trace_mm_vmscan_direct_reclaim_end(nr_reclaimed, delta);
+
+	return nr_reclaimed;
 }
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
@@ -2938,3 +3090,78 @@ void scan_unevictable_unregister_node(struct node *node)
 	sysdev_remove_file(&node->sysdev, &attr_scan_unevictable_pages);
 }
 
+
+#if defined(CONFIG_RECLAIM_STATS) && defined(CONFIG_DEBUG_FS)
+static int reclaim_zones_show(struct seq_file *m, void *v)
+{
+	struct zone *zone;
+
+	seq_printf(m, "%-6s %-10s %10s %14s %12s\n",
+		   "node", "zone", "calls", "time_us", "max_us");
+	spin_lock(&reclaim_stats_lock);
+	for_each_populated_zone(zone)
+		seq_printf(m, "%-6d %-10s %10lu %14llu %12llu\n",
+			   zone_to_nid(zone), zone->name, zone->reclaim_calls,
+			   div_u64(zone->reclaim_time_ns, NSEC_PER_USEC),
+			   div_u64(zone->reclaim_max_ns, NSEC_PER_USEC));
+	spin_unlock(&reclaim_stats_lock);
+	return 0;
+}
+
+static int reclaim_zones_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, reclaim_zones_show, NULL);
+}
+
+static const struct file_operations reclaim_zones_fops = {
+	.open		= reclaim_zones_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int reclaim_shrinkers_show(struct seq_file *m, void *v)
+{
+	struct shrinker *shrinker;
+
+	seq_printf(m, "%-40s %10s %12s %12s %14s\n",
+		   "shrinker", "calls", "scanned", "freed", "time_us");
+	down_read(&shrinker_rwsem);
+	spin_lock(&reclaim_stats_lock);
+	list_for_each_entry(shrinker, &shrinker_list, list)
+		seq_printf(m, "%-40pf %10lu %12lu %12lu %14llu\n",
+			   shrinker->shrink, shrinker->nr_calls, shrinker->nr_scanned,
+			   shrinker->nr_freed,
+			   div_u64(shrinker->time_ns, NSEC_PER_USEC));
+	spin_unlock(&reclaim_stats_lock);
+	up_read(&shrinker_rwsem);
+	return 0;
+}
+
+static int reclaim_shrinkers_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, reclaim_shrinkers_show, NULL);
+}
+
+static const struct file_operations reclaim_shrinkers_fops = {
+	.open		= reclaim_shrinkers_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init reclaim_stats_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("reclaim", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("zones", 0444, dir, NULL, &reclaim_zones_fops);
+	debugfs_create_file("shrinkers", 0444, dir, NULL,
+			    &reclaim_shrinkers_fops);
+	return 0;
+}
+late_initcall(reclaim_stats_debugfs_init);
+#endif
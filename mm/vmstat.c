@@ -788,6 +788,17 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+#ifdef CONFIG_RECLAIM_STATS
+	"allocstall_lt1ms",
+	"allocstall_lt4ms",
+	"allocstall_lt16ms",
+	"allocstall_lt64ms",
+	"allocstall_lt256ms",
+	"allocstall_ge256ms",
+	"allocstall_ms",
+#endif
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
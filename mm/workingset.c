@@ -0,0 +1,190 @@
+/*
+ * Workingset detection
+ *
+ * When a file page is reclaimed, remember when it was evicted, so that
+ * a refault of the same page can be told apart from a first access.
+ *
+ * Each zone has an inactive age, a counter that ticks on every
+ * eviction and activation.  Those are the events that move a page
+ * towards the tail of the inactive list, so the difference between the
+ * age at refault and the age recorded at eviction is how much the page
+ * would have needed to stay resident: its refault distance.  If that
+ * distance is no larger than the active file list, the page would have
+ * been reclaimed in favour of active pages that might be less used than
+ * it, so the refaulting page is put straight onto the active list
+ * instead of having to prove itself on the inactive list again.
+ *
+ * The eviction records live in a lossy hash table indexed by mapping
+ * and page index, one record per bucket.  Collisions simply overwrite
+ * older records and unlocked updates may race, which costs at most a
+ * wrong guess about one page.  A record for a mapping that has since
+ * been freed can likewise only cause one spurious activation.
+ */
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/vmstat.h>
+#include <linux/jhash.h>
+#include <linux/bootmem.h>
+#include <linux/rcupdate.h>
+
+#define ZONE_BITS	(NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_SHIFT	ZONE_BITS
+#define EVICTION_MASK	(~0U >> EVICTION_SHIFT)
+
+struct shadow_entry {
+	u32	cookie;		/* identifies mapping and index, 0 if unused */
+	u32	shadow;		/* inactive age and zone at eviction */
+};
+
+struct shadow_hash {
+	struct shadow_entry *table;
+	unsigned int mask;
+};
+
+/*
+ * Reclaim may run before workingset_init(), so the table is published
+ * through a single pointer once it is completely set up.
+ */
+static struct shadow_hash shadow_hash_storage __read_mostly;
+static struct shadow_hash *shadow_hash __read_mostly;
+static unsigned long shadow_entries;
+
+static int __init set_shadow_entries(char *str)
+{
+	if (!str)
+		return 0;
+	shadow_entries = simple_strtoul(str, &str, 0);
+	return 1;
+}
+__setup("workingset_entries=", set_shadow_entries);
+
+static struct shadow_entry *shadow_lookup(struct address_space *mapping,
+					  pgoff_t index, u32 *cookie)
+{
+	struct shadow_hash *sh = rcu_dereference_raw(shadow_hash);
+	u32 key = (u32)(unsigned long)mapping;
+	u32 hash;
+
+	if (!sh)
+		return NULL;
+
+	hash = jhash_2words(key, (u32)index, 0);
+	*cookie = jhash_2words(key, (u32)index, hash) | 1;
+	return &sh->table[hash & sh->mask];
+}
+
+static u32 pack_shadow(struct zone *zone, unsigned long eviction)
+{
+	u32 shadow = eviction & EVICTION_MASK;
+
+	shadow = (shadow << NODES_SHIFT) | zone_to_nid(zone);
+	shadow = (shadow << ZONES_SHIFT) | zone_idx(zone);
+	return shadow;
+}
+
+static struct zone *unpack_shadow(u32 shadow, unsigned long *eviction)
+{
+	int zid, nid;
+
+	zid = shadow & ((1U << ZONES_SHIFT) - 1);
+	shadow >>= ZONES_SHIFT;
+	nid = shadow & ((1U << NODES_SHIFT) - 1);
+	shadow >>= NODES_SHIFT;
+	*eviction = shadow;
+	return NODE_DATA(nid)->node_zones + zid;
+}
+
+/**
+ * workingset_eviction - note the eviction of a file page
+ * @mapping: address space the page is being removed from
+ * @page: the page being evicted
+ *
+ * Called by reclaim with the page locked, before it is removed from
+ * the page cache.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	struct shadow_entry *entry;
+	unsigned long eviction;
+	u32 cookie;
+
+	entry = shadow_lookup(mapping, page->index, &cookie);
+	if (!entry)
+		return;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	entry->shadow = pack_shadow(zone, eviction);
+	entry->cookie = cookie;
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @mapping: address space the page is being added to
+ * @index: page index in @mapping
+ *
+ * Returns 1 if the page was evicted recently enough that it should be
+ * activated right away, 0 otherwise.
+ */
+int workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	struct shadow_entry *entry;
+	unsigned long refault_distance;
+	unsigned long eviction;
+	unsigned long refault;
+	struct zone *zone;
+	u32 cookie;
+
+	entry = shadow_lookup(mapping, index, &cookie);
+	if (!entry || entry->cookie != cookie)
+		return 0;
+	entry->cookie = 0;
+
+	zone = unpack_shadow(entry->shadow, &eviction);
+	refault = atomic_long_read(&zone->inactive_age);
+	refault_distance = (refault - eviction) & EVICTION_MASK;
+
+	count_vm_event(WORKINGSET_REFAULT);
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		count_vm_event(WORKINGSET_ACTIVATE);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static int __init workingset_init(void)
+{
+	struct shadow_hash *sh = &shadow_hash_storage;
+	unsigned int shift;
+
+	BUILD_BUG_ON(ZONE_BITS > 8);
+
+	/* by default, one record per four pages of memory */
+	sh->table = alloc_large_system_hash("Workingset shadow",
+					    sizeof(struct shadow_entry),
+					    shadow_entries,
+					    PAGE_SHIFT + 2,
+					    0,
+					    &shift,
+					    NULL,
+					    0);
+	sh->mask = (1U << shift) - 1;
+	memset(sh->table, 0, sizeof(struct shadow_entry) << shift);
+
+	/* only now can lookups see the table */
+	rcu_assign_pointer(shadow_hash, sh);
+	return 0;
+}
+module_init(workingset_init);
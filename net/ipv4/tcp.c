@@ -294,6 +294,51 @@ EXPORT_SYMBOL(sysctl_tcp_wmem);
 atomic_t tcp_memory_allocated;	/* Current allocated memory. */
 EXPORT_SYMBOL(tcp_memory_allocated);
 
+/* Bytes of socket buffers granted above tcp_rmem[2] and tcp_wmem[2]. */
+atomic_long_t tcp_autotune_allocated;
+
+/*
+ * Grow *@buf, sk_rcvbuf or sk_sndbuf, to @size.  Up to @fixed, which is
+ * tcp_rmem[2] or tcp_wmem[2], this is free.  With tcp_rtt_autotune the
+ * part above is taken from the budget shared by all sockets and added
+ * to *@over, which tcp_autotune_release() gives back.  Growth stops
+ * where the budget runs out or once TCP memory reaches tcp_mem[0].
+ * Returns nonzero if *@buf grew.
+ */
+int tcp_autotune_grow(int *buf, int size, int fixed, u32 *over)
+{
+	long want, prev, budget;
+
+	if (size <= *buf)
+		return 0;
+
+	if (size > fixed + *over) {
+		want = size - fixed - *over;
+		if (!sysctl_tcp_rtt_autotune ||
+		    atomic_read(&tcp_memory_allocated) >= sysctl_tcp_mem[0]) {
+			want = 0;
+		} else {
+			budget = tcp_autotune_budget();
+			prev = atomic_long_add_return(want,
+						      &tcp_autotune_allocated);
+			prev -= want;
+			if (prev + want > budget) {
+				long granted = max(budget - prev, 0L);
+
+				atomic_long_sub(want - granted,
+						&tcp_autotune_allocated);
+				want = granted;
+			}
+		}
+		*over += want;
+		size = fixed + *over;
+		if (size <= *buf)
+			return 0;
+	}
+	*buf = size;
+	return 1;
+}
+
 /*
  * Current number of TCP sockets.
  */
@@ -93,6 +93,7 @@ int sysctl_tcp_nometrics_save __read_mostly;
 int sysctl_tcp_thin_dupack __read_mostly;
 
 int sysctl_tcp_moderate_rcvbuf __read_mostly = 1;
+int sysctl_tcp_rtt_autotune __read_mostly;
 int sysctl_tcp_abc __read_mostly;
 
 #define FLAG_DATA		0x01 /* Incoming frame contained data.		*/
@@ -256,8 +257,8 @@ static void tcp_fixup_sndbuf(struct sock *sk)
 	int sndmem = tcp_sk(sk)->rx_opt.mss_clamp + MAX_TCP_HEADER + 16 +
 		     sizeof(struct sk_buff);
 
-	if (sk->sk_sndbuf < 3 * sndmem)
-		sk->sk_sndbuf = min(3 * sndmem, sysctl_tcp_wmem[2]);
+	tcp_autotune_grow(&sk->sk_sndbuf, 3 * sndmem, sysctl_tcp_wmem[2],
+			  &tcp_sk(sk)->sndbuf_over);
 }
 
 /* 2. Tuning advertised window (window_clamp, rcv_ssthresh)
@@ -291,7 +292,7 @@ static int __tcp_grow_window(const struct sock *sk, const struct sk_buff *skb)
 	struct tcp_sock *tp = tcp_sk(sk);
 	/* Optimize this! */
 	int truesize = tcp_win_from_space(skb->truesize) >> 1;
-	int window = tcp_win_from_space(sysctl_tcp_rmem[2]) >> 1;
+	int window = tcp_win_from_space(tcp_rmem_limit(sk)) >> 1;
 
 	while (tp->rcv_ssthresh <= window) {
 		if (truesize <= skb->len)
@@ -342,8 +343,8 @@ static void tcp_fixup_rcvbuf(struct sock *sk)
 	 */
 	while (tcp_win_from_space(rcvmem) < tp->advmss)
 		rcvmem += 128;
-	if (sk->sk_rcvbuf < 4 * rcvmem)
-		sk->sk_rcvbuf = min(4 * rcvmem, sysctl_tcp_rmem[2]);
+	tcp_autotune_grow(&sk->sk_rcvbuf, 4 * rcvmem, sysctl_tcp_rmem[2],
+			  &tp->rcvbuf_over);
 }
 
 /* 4. Try to fixup all. It is made immediately after connection enters
@@ -360,6 +361,7 @@ static void tcp_init_buffer_space(struct sock *sk)
 		tcp_fixup_sndbuf(sk);
 
 	tp->rcvq_space.space = tp->rcv_wnd;
+	tp->rcvq_space.rate = 0;
 
 	maxwin = tcp_full_space(sk);
 
@@ -390,12 +392,12 @@ static void tcp_clamp_window(struct sock *sk)
 
 	icsk->icsk_ack.quick = 0;
 
-	if (sk->sk_rcvbuf < sysctl_tcp_rmem[2] &&
-	    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK) &&
+	if (!(sk->sk_userlocks & SOCK_RCVBUF_LOCK) &&
 	    !tcp_memory_pressure &&
 	    atomic_read(&tcp_memory_allocated) < sysctl_tcp_mem[0]) {
-		sk->sk_rcvbuf = min(atomic_read(&sk->sk_rmem_alloc),
-				    sysctl_tcp_rmem[2]);
+		tcp_autotune_grow(&sk->sk_rcvbuf,
+				  atomic_read(&sk->sk_rmem_alloc),
+				  sysctl_tcp_rmem[2], &tp->rcvbuf_over);
 	}
 	if (atomic_read(&sk->sk_rmem_alloc) > sk->sk_rcvbuf)
 		tp->rcv_ssthresh = min(tp->window_clamp, 2U * tp->advmss);
@@ -491,9 +493,35 @@ static inline void tcp_rcv_rtt_measure_ts(struct sock *sk,
  * This function should be called every time data is copied to user space.
  * It calculates the appropriate TCP receive buffer space.
  */
+/* Size the receive space from the delivery rate: the data copied to
+ * the user over @time jiffies.  Rate times RTT is what the sender keeps
+ * in flight.  While the rate is still going up, as in slow start, plan
+ * for the next RTT running at the rate it is heading for, up to twice
+ * the last one, instead of lagging one RTT behind.
+ */
+static int tcp_rtt_rcvspace(struct tcp_sock *tp, u32 copied, int time,
+			    int space)
+{
+	u32 prev = tp->rcvq_space.rate;
+	u64 rate, bdp;
+
+	if (time <= 0)
+		return space;
+
+	rate = div_u64((u64)copied * HZ, time);
+	tp->rcvq_space.rate = min_t(u64, rate, ~0U);
+
+	bdp = div_u64(rate * (tp->rcv_rtt_est.rtt >> 3), HZ);
+	if (prev && rate > prev)
+		bdp = div_u64(bdp * min_t(u64, rate, 2 * (u64)prev), prev);
+
+	return max_t(u64, space, min_t(u64, 2 * bdp, INT_MAX));
+}
+
 void tcp_rcv_space_adjust(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
+	u32 copied;
 	int time;
 	int space;
 
@@ -504,7 +532,10 @@ void tcp_rcv_space_adjust(struct sock *sk)
 	if (time < (tp->rcv_rtt_est.rtt >> 3) || tp->rcv_rtt_est.rtt == 0)
 		return;
 
-	space = 2 * (tp->copied_seq - tp->rcvq_space.seq);
+	copied = tp->copied_seq - tp->rcvq_space.seq;
+	space = 2 * copied;
+	if (sysctl_tcp_rtt_autotune)
+		space = tcp_rtt_rcvspace(tp, copied, time, space);
 
 	space = max(tp->rcvq_space.space, space);
 
@@ -529,10 +560,9 @@ void tcp_rcv_space_adjust(struct sock *sk)
 			while (tcp_win_from_space(rcvmem) < tp->advmss)
 				rcvmem += 128;
 			space *= rcvmem;
-			space = min(space, sysctl_tcp_rmem[2]);
-			if (space > sk->sk_rcvbuf) {
-				sk->sk_rcvbuf = space;
-
+			if (tcp_autotune_grow(&sk->sk_rcvbuf, space,
+					      sysctl_tcp_rmem[2],
+					      &tp->rcvbuf_over)) {
 				/* Make the window clamp follow along.  */
 				tp->window_clamp = new_clamp;
 			}
@@ -4887,9 +4917,13 @@ static void tcp_new_space(struct sock *sk)
 			MAX_TCP_HEADER + 16 + sizeof(struct sk_buff);
 		int demanded = max_t(unsigned int, tp->snd_cwnd,
 				     tp->reordering + 1);
+
+		/* cwnd still doubles every RTT in slow start */
+		if (sysctl_tcp_rtt_autotune && tp->snd_cwnd < tp->snd_ssthresh)
+			demanded *= 2;
 		sndmem *= 2 * demanded;
-		if (sndmem > sk->sk_sndbuf)
-			sk->sk_sndbuf = min(sndmem, sysctl_tcp_wmem[2]);
+		tcp_autotune_grow(&sk->sk_sndbuf, sndmem, sysctl_tcp_wmem[2],
+				  &tp->sndbuf_over);
 		tp->snd_cwnd_stamp = tcp_time_stamp;
 	}
 
@@ -1914,6 +1914,8 @@ void tcp_v4_destroy_sock(struct sock *sk)
 
 	tcp_cleanup_congestion_control(sk);
 
+	tcp_autotune_release(tp);
+
 	/* Cleanup up the write buffer. */
 	tcp_write_queue_purge(sk);
 
@@ -425,6 +425,10 @@ struct sock *tcp_create_openreq_child(struct sock *sk, struct request_sock *req,
 
 		tcp_prequeue_init(newtp);
 
+		/* the listener's autotune charge stays with the listener */
+		newtp->rcvbuf_over = 0;
+		newtp->sndbuf_over = 0;
+
 		tcp_init_wl(newtp, treq->rcv_isn);
 
 		newtp->srtt = 0;
@@ -98,6 +98,8 @@
 #include <linux/in.h>
 #include <linux/fs.h>
 #include <linux/slab.h>
+#include <linux/highmem.h>
+#include <linux/completion.h>
 #include <asm/uaccess.h>
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
@@ -504,6 +506,8 @@ static int unix_dgram_connect(struct socket *, struct sockaddr *,
 			      int, int);
 static int unix_seqpacket_sendmsg(struct kiocb *, struct socket *,
 				  struct msghdr *, size_t);
+static ssize_t unix_stream_sendpage(struct socket *, struct page *, int,
+				    size_t, int);
 
 static const struct proto_ops unix_stream_ops = {
 	.family =	PF_UNIX,
@@ -523,7 +527,7 @@ static const struct proto_ops unix_stream_ops = {
 	.sendmsg =	unix_stream_sendmsg,
 	.recvmsg =	unix_stream_recvmsg,
 	.mmap =		sock_no_mmap,
-	.sendpage =	sock_no_sendpage,
+	.sendpage =	unix_stream_sendpage,
 };
 
 static const struct proto_ops unix_dgram_ops = {
@@ -605,6 +609,7 @@ static struct sock *unix_create1(struct net *net, struct socket *sock)
 	u	  = unix_sk(sk);
 	u->dentry = NULL;
 	u->mnt	  = NULL;
+	u->post	  = NULL;
 	spin_lock_init(&u->lock);
 	atomic_long_set(&u->inflight, 0);
 	INIT_LIST_HEAD(&u->link);
@@ -1376,6 +1381,54 @@ static int unix_scm_to_skb(struct scm_cookie *scm, struct sk_buff *skb, bool sen
 	return err;
 }
 
+/*
+ * Queue a datagram on the receiving socket.  Returns 1 if the queue was
+ * empty before, so that poll and epoll waiters have not been told about
+ * queued data yet.
+ */
+static int unix_dgram_queue(struct sock *other, struct sk_buff *skb)
+{
+	int was_empty;
+
+	spin_lock(&other->sk_receive_queue.lock);
+	was_empty = skb_queue_empty(&other->sk_receive_queue);
+	__skb_queue_tail(&other->sk_receive_queue, skb);
+	spin_unlock(&other->sk_receive_queue.lock);
+
+	return was_empty;
+}
+
+/*
+ * Wake one reader blocked in recv() on @sk, but leave the poll and epoll
+ * entries on the wait queue alone.  Those were woken when the queue
+ * became non-empty and see it readable until it is drained, so event
+ * streams cost one ep_poll_callback() per batch instead of one per
+ * datagram.  Blocked readers are exclusive waiters, each of which has
+ * to be woken by a datagram of its own.
+ */
+static void unix_dgram_wake_reader(struct sock *sk)
+{
+	struct socket_wq *wq;
+	wait_queue_t *curr, *next;
+	unsigned long flags;
+
+	rcu_read_lock();
+	wq = rcu_dereference(sk->sk_wq);
+	if (wq_has_sleeper(wq)) {
+		spin_lock_irqsave(&wq->wait.lock, flags);
+		list_for_each_entry_safe(curr, next, &wq->wait.task_list,
+					 task_list) {
+			if (!(curr->flags & WQ_FLAG_EXCLUSIVE))
+				continue;
+			if (curr->func(curr, TASK_INTERRUPTIBLE, WF_SYNC,
+				       (void *)(POLLIN | POLLRDNORM | POLLRDBAND)))
+				break;
+		}
+		spin_unlock_irqrestore(&wq->wait.lock, flags);
+	}
+	rcu_read_unlock();
+}
+
 /*
  *	Send AF_UNIX data.
  */
@@ -1396,6 +1449,7 @@ static int unix_dgram_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	long timeo;
 	struct scm_cookie tmp_scm;
 	int max_level;
+	int was_empty;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1515,11 +1569,14 @@ restart:
 		goto restart;
 	}
 
-	skb_queue_tail(&other->sk_receive_queue, skb);
+	was_empty = unix_dgram_queue(other, skb);
 	if (max_level > unix_sk(other)->recursion_level)
 		unix_sk(other)->recursion_level = max_level;
 	unix_state_unlock(other);
-	other->sk_data_ready(other, len);
+	if (was_empty || !net->unx.sysctl_dgram_wake_coalesce)
+		other->sk_data_ready(other, len);
+	else
+		unix_dgram_wake_reader(other);
 	sock_put(other);
 	scm_destroy(siocb->scm);
 	return len;
@@ -1536,6 +1593,109 @@ out:
 }
 
 
+/*
+ * Large stream sends are built from order-0 pages hanging off a small
+ * linear part, rather than from one high order allocation.
+ */
+#define UNIX_SKB_FRAGS_SZ	(PAGE_SIZE << get_order(32768))
+
+/*
+ * A stream reader that blocks on an empty queue posts its buffer, pinned.
+ * A writer that finds it copies straight from its own iovec into those
+ * pages, so the data is copied once and never queued.  Smaller reads
+ * are cheaper to copy twice than to pin.
+ */
+#define UNIX_POST_MIN		1024
+#define UNIX_POST_PAGES		16
+
+struct unix_stream_post {
+	struct page		*pages[UNIX_POST_PAGES];
+	int			nr_pages;
+	unsigned int		offset;		/* into the first page */
+	size_t			len;
+	size_t			filled;
+	int			claimed;	/* a writer owns the buffer */
+	struct completion	done;		/* ... and has finished */
+	struct pid		*want_pid;	/* writer must match these, */
+	const struct cred	*want_cred;	/* if already set */
+	struct pid		*pid;		/* writer's credentials */
+	const struct cred	*cred;
+};
+
+/*
+ * Copy up to @len bytes at @sent of the message into the buffer posted
+ * by the reader of @other.  Returns the bytes copied, 0 if there is no
+ * posted buffer to use, or an error.
+ */
+static int unix_stream_post_fill(struct sock *other, struct msghdr *msg,
+				 int sent, int len, struct scm_cookie *scm)
+{
+	struct unix_sock *u = unix_sk(other);
+	struct unix_stream_post *post;
+	unsigned int pos, off;
+	int done = 0, n, err = 0;
+	void *kaddr;
+
+	unix_state_lock(other);
+	post = u->post;
+	if (!post || !skb_queue_empty(&other->sk_receive_queue) ||
+	    sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN) ||
+	    (post->want_pid && (post->want_pid != scm->pid ||
+				post->want_cred != scm->cred))) {
+		unix_state_unlock(other);
+		return 0;
+	}
+	u->post = NULL;
+	post->claimed = 1;
+	unix_state_unlock(other);
+
+	len = min_t(size_t, len, post->len);
+	while (done < len) {
+		pos = post->offset + done;
+		off = pos & ~PAGE_MASK;
+		n = min_t(int, len - done, PAGE_SIZE - off);
+		kaddr = kmap(post->pages[pos >> PAGE_SHIFT]);
+		err = memcpy_fromiovecend(kaddr + off, msg->msg_iov,
+					  sent + done, n);
+		kunmap(post->pages[pos >> PAGE_SHIFT]);
+		if (err)
+			break;
+		done += n;
+	}
+
+	post->filled = done;
+	post->pid = get_pid(scm->pid);
+	post->cred = get_cred(scm->cred);
+	/* the reader may return as soon as this is done, post goes with it */
+	complete(&post->done);
+	other->sk_data_ready(other, done);
+	return done ? : err;
+}
+
+/*
+ * After handing over a buffer, give the reader a moment to come back
+ * for more before queueing the rest, so that a large write keeps going
+ * to it directly even when the reader runs on the same cpu.
+ */
+static void unix_stream_wait_post(struct sock *other)
+{
+	struct unix_sock *u = unix_sk(other);
+	DEFINE_WAIT(wait);
+
+	prepare_to_wait(&u->peer_wait, &wait, TASK_INTERRUPTIBLE);
+	unix_state_lock(other);
+	if (!u->post && skb_queue_empty(&other->sk_receive_queue) &&
+	    !sock_flag(other, SOCK_DEAD) &&
+	    !(other->sk_shutdown & RCV_SHUTDOWN) &&
+	    !signal_pending(current)) {
+		unix_state_unlock(other);
+		schedule_timeout(1);
+	} else
+		unix_state_unlock(other);
+	finish_wait(&u->peer_wait, &wait);
+}
+
 static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			       struct msghdr *msg, size_t len)
 {
@@ -1549,6 +1709,7 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	struct scm_cookie tmp_scm;
 	bool fds_sent = false;
 	int max_level;
+	int data_len;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1576,6 +1737,22 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		goto pipe_err;
 
 	while (sent < len) {
+		/* fds can only travel in an skb */
+		if (fds_sent || !siocb->scm->fp) {
+			size = unix_stream_post_fill(other, msg, sent,
+						     len - sent, siocb->scm);
+			if (size < 0) {
+				err = size;
+				goto out_err;
+			}
+			if (size) {
+				sent += size;
+				if (sent < len && !(msg->msg_flags & MSG_DONTWAIT))
+					unix_stream_wait_post(other);
+				continue;
+			}
+		}
+
 		/*
 		 *	Optimisation for the fact that under 0.01% of X
 		 *	messages typically need breaking up.
@@ -1587,29 +1764,20 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		if (size > ((sk->sk_sndbuf >> 1) - 64))
 			size = (sk->sk_sndbuf >> 1) - 64;
 
-		if (size > SKB_MAX_ALLOC)
-			size = SKB_MAX_ALLOC;
+		if (size > SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ)
+			size = SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ;
+		data_len = max_t(int, 0, size - SKB_MAX_HEAD(0));
 
 		/*
 		 *	Grab a buffer
 		 */
 
-		skb = sock_alloc_send_skb(sk, size, msg->msg_flags&MSG_DONTWAIT,
-					  &err);
+		skb = sock_alloc_send_pskb(sk, size - data_len, data_len,
+					   msg->msg_flags & MSG_DONTWAIT, &err);
 
 		if (skb == NULL)
 			goto out_err;
 
-		/*
-		 *	If you pass two values to the sock_alloc_send_skb
-		 *	it tries to grab the large buffer with GFP_NOFS
-		 *	(which can fail easily), and if it fails grab the
-		 *	fallback size buffer which is under a page and will
-		 *	succeed. [Alan]
-		 */
-		size = min_t(int, size, skb_tailroom(skb));
-
-
 		/* Only send the fds in the first buffer */
 		err = unix_scm_to_skb(siocb->scm, skb, !fds_sent);
 		if (err < 0) {
@@ -1619,7 +1787,11 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		max_level = err + 1;
 		fds_sent = true;
 
-		err = memcpy_fromiovec(skb_put(skb, size), msg->msg_iov, size);
+		skb_put(skb, size - data_len);
+		skb->data_len = data_len;
+		skb->len = size;
+		err = skb_copy_datagram_from_iovec(skb, 0, msg->msg_iov,
+						   sent, size);
 		if (err) {
 			kfree_skb(skb);
 			goto out_err;
@@ -1657,6 +1829,75 @@ out_err:
 	return sent ? : err;
 }
 
+/*
+ * Queue a reference to @page rather than a copy of it, so that data
+ * spliced or vmspliced into a stream socket is copied only once, by the
+ * receiver.  Like for TCP, the page must not be modified until read.
+ */
+static ssize_t unix_stream_sendpage(struct socket *sock, struct page *page,
+				    int offset, size_t size, int flags)
+{
+	struct sock *sk = sock->sk;
+	struct sock *other;
+	struct msghdr msg;
+	struct scm_cookie scm;
+	struct sk_buff *skb;
+	int err;
+
+	if (flags & MSG_OOB)
+		return -EOPNOTSUPP;
+
+	other = unix_peer(sk);
+	if (!other || sk->sk_state != TCP_ESTABLISHED)
+		return -ENOTCONN;
+
+	if (sk->sk_shutdown & SEND_SHUTDOWN)
+		goto pipe_err;
+
+	skb = sock_alloc_send_skb(sk, 0, flags & MSG_DONTWAIT, &err);
+	if (!skb)
+		return err;
+
+	/* Only the credentials of the sender go with the page */
+	memset(&msg, 0, sizeof(msg));
+	err = scm_send(sock, &msg, &scm);
+	if (err < 0) {
+		kfree_skb(skb);
+		return err;
+	}
+	err = unix_scm_to_skb(&scm, skb, false);
+	scm_destroy(&scm);
+	if (err < 0) {
+		kfree_skb(skb);
+		return err;
+	}
+
+	get_page(page);
+	skb_fill_page_desc(skb, 0, page, offset, size);
+	skb->len += size;
+	skb->data_len += size;
+	skb->truesize += size;
+	atomic_add(size, &sk->sk_wmem_alloc);
+
+	unix_state_lock(other);
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		unix_state_unlock(other);
+		kfree_skb(skb);
+		goto pipe_err;
+	}
+	skb_queue_tail(&other->sk_receive_queue, skb);
+	unix_state_unlock(other);
+	other->sk_data_ready(other, size);
+
+	return size;
+
+pipe_err:
+	if (!(flags & MSG_NOSIGNAL))
+		send_sig(SIGPIPE, current, 0);
+	return -EPIPE;
+}
+
 static int unix_seqpacket_sendmsg(struct kiocb *kiocb, struct socket *sock,
 				  struct msghdr *msg, size_t len)
 {
@@ -1718,7 +1959,9 @@ static int unix_dgram_recvmsg(struct kiocb *iocb, struct socket *sock,
 		goto out_unlock;
 	}
 
-	wake_up_interruptible_sync(&u->peer_wait);
+	/* Writers only wait for room in a full queue */
+	if (!unix_recvq_full(sk))
+		wake_up_interruptible_sync(&u->peer_wait);
 
 	if (msg->msg_name)
 		unix_copy_addr(msg, skb->sk);
@@ -1774,16 +2017,24 @@ out:
  *	Sleep until data has arrive. But check for races..
  */
 
-static long unix_stream_data_wait(struct sock *sk, long timeo)
+static long unix_stream_data_wait(struct sock *sk, long timeo,
+				  struct unix_stream_post *post)
 {
+	struct unix_sock *u = unix_sk(sk);
 	DEFINE_WAIT(wait);
 
 	unix_state_lock(sk);
 
+	if (post && !u->post && skb_queue_empty(&sk->sk_receive_queue)) {
+		u->post = post;
+		wake_up_interruptible(&u->peer_wait);
+	}
+
 	for (;;) {
 		prepare_to_wait(sk_sleep(sk), &wait, TASK_INTERRUPTIBLE);
 
 		if (!skb_queue_empty(&sk->sk_receive_queue) ||
+		    (post && post->claimed) ||
 		    sk->sk_err ||
 		    (sk->sk_shutdown & RCV_SHUTDOWN) ||
 		    signal_pending(current) ||
@@ -1797,13 +2048,71 @@ static long unix_stream_data_wait(struct sock *sk, long timeo)
 		clear_bit(SOCK_ASYNC_WAITDATA, &sk->sk_socket->flags);
 	}
 
+	/* no writer took the buffer, take it back */
+	if (post && u->post == post)
+		u->post = NULL;
 	finish_wait(sk_sleep(sk), &wait);
 	unix_state_unlock(sk);
 	return timeo;
 }
 
+static int unix_stream_post_prepare(struct unix_stream_post *post,
+				    struct msghdr *msg, int size,
+				    struct scm_cookie *scm)
+{
+	unsigned long start;
+	size_t len;
+	int nr;
+
+	if (msg->msg_iovlen != 1 || msg->msg_name ||
+	    segment_eq(get_fs(), KERNEL_DS))
+		return 0;
+	len = min_t(size_t, size, msg->msg_iov->iov_len);
+	if (len < UNIX_POST_MIN)
+		return 0;
+
+	start = (unsigned long)msg->msg_iov->iov_base;
+	post->offset = start & ~PAGE_MASK;
+	len = min_t(size_t, len, UNIX_POST_PAGES * PAGE_SIZE - post->offset);
+	nr = get_user_pages_fast(start & PAGE_MASK,
+				 DIV_ROUND_UP(post->offset + len, PAGE_SIZE),
+				 1, post->pages);
+	if (nr <= 0)
+		return 0;
+
+	post->nr_pages = nr;
+	post->len = min_t(size_t, len, nr * PAGE_SIZE - post->offset);
+	post->filled = 0;
+	post->claimed = 0;
+	init_completion(&post->done);
+	post->want_pid = scm ? scm->pid : NULL;
+	post->want_cred = scm ? scm->cred : NULL;
+	post->pid = NULL;
+	post->cred = NULL;
+	return 1;
+}
+
+static void unix_stream_post_release(struct unix_stream_post *post)
+{
+	int i;
+
+	for (i = 0; i < post->nr_pages; i++) {
+		if (post->filled && i * PAGE_SIZE < post->offset + post->filled)
+			set_page_dirty_lock(post->pages[i]);
+		put_page(post->pages[i]);
+	}
+	put_pid(post->pid);
+	if (post->cred)
+		put_cred(post->cred);
+}
+
 
 
+static unsigned int unix_skb_len(const struct sk_buff *skb)
+{
+	return skb->len - UNIXCB(skb).consumed;
+}
+
 static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			       struct msghdr *msg, size_t size,
 			       int flags)
@@ -1813,8 +2122,10 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 	struct sock *sk = sock->sk;
 	struct unix_sock *u = unix_sk(sk);
 	struct sockaddr_un *sunaddr = msg->msg_name;
+	struct unix_stream_post post;
 	int copied = 0;
 	int check_creds = 0;
+	int posted;
 	int target;
 	int err = 0;
 	long timeo;
@@ -1868,9 +2179,33 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			err = -EAGAIN;
 			if (!timeo)
 				break;
+			posted = !(flags & MSG_PEEK) &&
+				 unix_stream_post_prepare(&post, msg, size,
+					check_creds ? siocb->scm : NULL);
 			mutex_unlock(&u->readlock);
 
-			timeo = unix_stream_data_wait(sk, timeo);
+			timeo = unix_stream_data_wait(sk, timeo,
+						      posted ? &post : NULL);
+
+			if (posted) {
+				if (post.claimed)
+					wait_for_completion(&post.done);
+				chunk = post.filled;
+				if (chunk && !check_creds) {
+					scm_set_cred(siocb->scm, post.pid,
+						     post.cred);
+					check_creds = 1;
+				}
+				msg->msg_iov->iov_base += chunk;
+				msg->msg_iov->iov_len -= chunk;
+				copied += chunk;
+				size -= chunk;
+				unix_stream_post_release(&post);
+				if (chunk) {
+					mutex_lock(&u->readlock);
+					continue;
+				}
+			}
 
 			if (signal_pending(current)) {
 				err = sock_intr_errno(timeo);
@@ -1903,8 +2238,9 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 			sunaddr = NULL;
 		}
 
-		chunk = min_t(unsigned int, skb->len, size);
-		if (memcpy_toiovec(msg->msg_iov, skb->data, chunk)) {
+		chunk = min_t(unsigned int, unix_skb_len(skb), size);
+		if (skb_copy_datagram_iovec(skb, UNIXCB(skb).consumed,
+					    msg->msg_iov, chunk)) {
 			skb_queue_head(&sk->sk_receive_queue, skb);
 			if (copied == 0)
 				copied = -EFAULT;
@@ -1915,13 +2251,13 @@ static int unix_stream_recvmsg(struct kiocb *iocb, struct socket *sock,
 
 		/* Mark read part of skb as used */
 		if (!(flags & MSG_PEEK)) {
-			skb_pull(skb, chunk);
+			UNIXCB(skb).consumed += chunk;
 
 			if (UNIXCB(skb).fp)
 				unix_detach_fds(siocb->scm, skb);
 
 			/* put the skb back if we didn't use it up.. */
-			if (skb->len) {
+			if (unix_skb_len(skb)) {
 				skb_queue_head(&sk->sk_receive_queue, skb);
 				break;
 			}
@@ -2012,7 +2348,7 @@ static int unix_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 			if (sk->sk_type == SOCK_STREAM ||
 			    sk->sk_type == SOCK_SEQPACKET) {
 				skb_queue_walk(&sk->sk_receive_queue, skb)
-					amount += skb->len;
+					amount += unix_skb_len(skb);
 			} else {
 				skb = skb_peek(&sk->sk_receive_queue);
 				if (skb)
@@ -2273,6 +2609,7 @@ static int __net_init unix_net_init(struct net *net)
 	int error = -ENOMEM;
 
 	net->unx.sysctl_max_dgram_qlen = 10;
+	net->unx.sysctl_dgram_wake_coalesce = 1;
 	if (unix_sysctl_register(net))
 		goto out;
 